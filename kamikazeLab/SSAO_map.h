@@ -23,5 +23,47 @@ struct SSAOMap
 	unsigned int height = 0;
 };
 
+/* depth and normals of the G-buffer at a lower resolution, as written by DepthNormalDownsampleMaterial:
+ * the depth (in a color texture) and the normals (packed) are stored as in the G-buffer */
+struct SSAODepthNormalMap
+{
+	void init(unsigned int width, unsigned int height);
+
+	void resize(unsigned int width, unsigned int height);
+
+	void bind()const;
+	void unbind()const;
+
+	void release();
+
+	unsigned int frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
+
+	GpuTexture depthTexture;
+	GpuTexture normalTexture;
+
+	unsigned int width = 0;
+	unsigned int height = 0;
+};
+
+/* the occlusion accumulated over the frames (see SSAOTemporalResolveMaterial), with the view depth
+ * it was accumulated at: next frame, what is reprojected here is kept only if it lies at the expected depth */
+struct SSAOHistoryMap
+{
+	void init(unsigned int width, unsigned int height);
+
+	void resize(unsigned int width, unsigned int height);
+
+	void bind()const;
+	void unbind()const;
+
+	void release();
+
+	unsigned int frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
+
+	GpuTexture historyTexture; //r: the occlusion (as in SSAOMap), g: the view depth
+
+	unsigned int width = 0;
+	unsigned int height = 0;
+};
 
 #endif
@@ -2,6 +2,7 @@
 #define _SSSAO_MATERIAL_H_
 
 #include <glm/glm.hpp>
+#include "uniform_ring.h"
 
 #define SSAO_SAMPLES_COUNT 14 //beware that the current implementation relies on this value.
 #define SSAO_OCCLUSION_RADIUS 0.5f
@@ -9,6 +10,12 @@
 #define SSAO_MIN_DISTANCE 0.05f
 #define SSAO_MAX_DISTANCE 1.4f
 
+//the occlusion is accumulated over the frames (see SSAOTemporalResolveMaterial): every frame takes only
+//SSAO_TEMPORAL_SAMPLES_COUNT of the SSAO_SAMPLES_COUNT directions of the kernel, and rotates them differently.
+//Comment the following line to take all of them, every frame.
+#define SSAO_TEMPORAL
+#define SSAO_TEMPORAL_SAMPLES_COUNT 4
+
 struct SSAOMaterial
 {
 	struct SceneVertexShaderUniformBlock
@@ -22,6 +29,9 @@ struct SSAOMaterial
 		float u_frustumNear;
 		float u_frustumFar;
 		glm::vec2 u_randomDirectionTiling;
+		glm::vec2 u_randomDirectionOffset; //moves the rotations of the kernel across the pixels, every frame
+		unsigned int u_firstSampleIndex; //the samples taken are u_sampleOffsets[first, first + SAMPLES_COUNT), wrapping
+		float u_padding;
 	};
 
 	struct ConstantFragmentShaderUniformBlock
@@ -40,15 +50,17 @@ struct SSAOMaterial
 	static SceneFragmentShaderUniformBlock sceneFragmentShaderUniformBlock;
 	static ConstantFragmentShaderUniformBlock constantFragmentShaderUniformBlock;
 
-	static unsigned int sceneVertexShaderUniformBufferId;
-	static unsigned int sceneFragmentShaderUniformBufferId;
+	static UniformRange sceneVertexShaderUniformRange;
+	static UniformRange sceneFragmentShaderUniformRange;
 	static unsigned int constantFragmentShaderUniformBufferId;
 		
 	static GpuTexture depthBuffer;
 	static GpuTexture normalBuffer;
 	static GpuTexture randomDirectionsTexture;
 
-	static constexpr unsigned int kRandomDirectionTextureSize = 1024;
+	static constexpr unsigned int RANDOM_DIRECTION_TEXTURE_SIZE = 1024;
+
+	static unsigned int frameIndex;
 };
 
 
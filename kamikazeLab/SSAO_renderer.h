@@ -5,21 +5,46 @@
 #include "SSAO_material.h"
 #include "mesh.h"
 #include "edge_preserving_blur_material.h"
+#include "SSAO_resampling_materials.h"
+#include "SSAO_temporal_material.h"
+
+//the occlusion is computed and blurred at half resolution, then upsampled (bilaterally) into ssaoMap:
+//about a quarter of the cost. Comment the following line to do everything at full resolution.
+#define SSAO_HALF_RESOLUTION
 
 struct SSAORenderer 
 {
 	SSAORenderer();
 	
-	void render()const;
+	void render();
 
-	SSAOMap ssaoMap;
+	SSAOMap ssaoMap; //always at full resolution: what the lighting reads
 
 private:
+	//SSAO of the given depth and normals into target (accumulated over the frames, with SSAO_TEMPORAL),
+	//then blurred (through intermediate)
+	void renderBlurredOcclusion(const GpuTexture& depth, const GpuTexture& normal, const SSAOMap& target, const SSAOMap& intermediate);
+
 	GpuMesh fullScreenQuad;
 	SSAOMaterial ssaoMaterial;
 	EdgePreservingBlurMaterial blurMaterial;
+
+#ifdef SSAO_HALF_RESOLUTION
+	DepthNormalDownsampleMaterial downsampleMaterial;
+	BilateralUpsampleMaterial upsampleMaterial;
+	SSAODepthNormalMap halfResolutionDepthNormalMap;
+	SSAOMap halfResolutionSsaoMap;
+	SSAOMap halfResolutionBlurIntermediateBuffer;
+#else
 	SSAOMap blurIntermediateBuffer;
+#endif
 
+#ifdef SSAO_TEMPORAL
+	SSAOTemporalResolveMaterial temporalResolveMaterial;
+	//at the resolution the occlusion is computed at: they swap every frame (one is written, the other one read)
+	SSAOHistoryMap historyMaps[2];
+	unsigned int currentHistoryIndex = 0;
+#endif
 };
 
 
@@ -0,0 +1,55 @@
+#ifndef _SSAO_RESAMPLING_MATERIALS_H_
+#define _SSAO_RESAMPLING_MATERIALS_H_
+
+/* what the half resolution SSAO (see SSAO_HALF_RESOLUTION in SSAO_renderer.h) needs besides the full resolution one:
+ *  - DepthNormalDownsampleMaterial: depth and normals of the G-buffer, at half resolution
+ *    (of each 2x2 texels, the nearest one)
+ *  - BilateralUpsampleMaterial: the blurred half resolution occlusion, back to full resolution,
+ *    weighting the 4 nearest texels by how close they are to the fragment, in depth and orientation
+ */
+
+#include <glm/glm.hpp>
+#include "uniform_ring.h"
+
+struct DepthNormalDownsampleMaterial
+{
+	DepthNormalDownsampleMaterial();
+
+	static void bind();
+	static GpuProgram gpuProgram;
+
+	static void updateSceneData();
+
+	static GpuTexture depthBuffer;
+	static GpuTexture normalBuffer;
+};
+
+struct BilateralUpsampleMaterial
+{
+	struct SceneFragmentShaderUniformBlock
+	{
+		glm::vec2 u_lowResolutionSize;
+		float u_frustumNear;
+		float u_frustumFar;
+	};
+
+	BilateralUpsampleMaterial();
+
+	static void bind();
+	static GpuProgram gpuProgram;
+
+	static void setLowResolutionSize(glm::vec2 lowResolutionSize);
+	static void updateSceneData();
+
+	static SceneFragmentShaderUniformBlock sceneFragmentShaderUniformBlock;
+
+	static UniformRange sceneFragmentShaderUniformRange;
+
+	static GpuTexture depthBuffer;
+	static GpuTexture normalBuffer;
+	static GpuTexture lowResolutionDepthBuffer;
+	static GpuTexture lowResolutionNormalBuffer;
+	static GpuTexture lowResolutionColorMap;
+};
+
+#endif
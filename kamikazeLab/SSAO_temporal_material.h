@@ -0,0 +1,50 @@
+#ifndef _SSAO_TEMPORAL_MATERIAL_H_
+#define _SSAO_TEMPORAL_MATERIAL_H_
+
+/* SSAOTemporalResolveMaterial (see SSAO_TEMPORAL in SSAO_material.h):
+ * blends the occlusion of this frame with the one accumulated so far, reprojected with the
+ * view-projection of the previous frame. The history is dropped where it was accumulated at another
+ * depth (disocclusions, or things which moved) and off screen.
+ */
+
+#include <glm/glm.hpp>
+#include "uniform_ring.h"
+
+#define SSAO_TEMPORAL_HISTORY_WEIGHT 0.9f //how much of the history is kept, when valid
+#define SSAO_TEMPORAL_DEPTH_TOLERANCE 0.05f //relative to the view depth
+
+struct SSAOTemporalResolveMaterial
+{
+	struct SceneVertexShaderUniformBlock
+	{
+		glm::mat4 u_invProjection;
+	};
+
+	struct SceneFragmentShaderUniformBlock
+	{
+		glm::mat4 u_reprojection; //view space of this frame -> clip space of the previous one
+		float u_frustumNear;
+		float u_frustumFar;
+		float u_historyWeight;
+		float u_depthTolerance;
+	};
+
+	SSAOTemporalResolveMaterial();
+
+	static void bind();
+	static GpuProgram gpuProgram;
+
+	static void updateSceneData();
+
+	static SceneVertexShaderUniformBlock sceneVertexShaderUniformBlock;
+	static SceneFragmentShaderUniformBlock sceneFragmentShaderUniformBlock;
+
+	static UniformRange sceneVertexShaderUniformRange;
+	static UniformRange sceneFragmentShaderUniformRange;
+
+	static GpuTexture depthBuffer;
+	static GpuTexture occlusionMap;
+	static GpuTexture historyMap;
+};
+
+#endif
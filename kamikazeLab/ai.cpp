@@ -6,26 +6,27 @@
 
 float randInZeroToOne(); // small helper function, defined somewhere
 
-// time at which the two objects a and b will be at their closest
-float minDistTime( const PhysObject& a, const PhysObject& b ){
-	float t = -dot( a.t.pos-b.t.pos , a.vel-b.vel ) /
-				dot( a.vel-b.vel, a.vel-b.vel );
+// time at which two points, moving of constant velocity, will be at their closest
+float minDistTime( vec3 posA, vec3 velA, vec3 posB, vec3 velB ){
+	float relSpeedSquared = dot( velA-velB, velA-velB );
+	if (relSpeedSquared==0) return 0; // never closer than now
+	float t = -dot( posA-posB , velA-velB ) / relSpeedSquared;
 	if (t<0) return 0; // the minimial distance time was it THE PAST!
 	else return t;
 }
 
-bool willItCollide( const PhysObject& a, const Bullet& b , float tolerance,
+bool willItCollide( const PhysObject& a, const BulletState& b , float tolerance,
 					bool &turnRight , bool &tooFar ){
-	float dt = minDistTime( a , b );
+	float dt = minDistTime( a.t.pos, a.vel, b.pos, b.vel );
 	vec3 aFuture = a.t.pos + a.vel * dt;
-	vec3 bFuture = b.t.pos + b.vel * dt;
+	vec3 bFuture = b.pos + b.vel * dt;
 
 	vec3 minDist = aFuture - bFuture;
 
 	vec3 rotAxis( 0,0,1 );
 	float tripleProduct = dot( cross( b.vel, rotAxis ) , minDist );
 
-	float sumOfRadii = a.coll.radius + b.coll.radius + tolerance;
+	float sumOfRadii = a.coll.radius + b.radius + tolerance;
 
 	turnRight = (tripleProduct > 0);
 	tooFar = (dt > b.timeToLive);
@@ -39,7 +40,7 @@ void AiMind::rethink(ShipController &output){
 
 	if (randInZeroToOne() > alertness) return;
 
-	Bullet hypoteticalBullet; // se sparassi ORA
+	BulletState hypoteticalBullet; // se sparassi ORA
 	me->fillBullet( hypoteticalBullet );
 
 	bool goR , goF;
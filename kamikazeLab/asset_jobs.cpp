@@ -0,0 +1,89 @@
+/* asset_jobs.cpp
+ * the workers which decode the assets, and the hand over of what they decoded to the GL thread
+ */
+
+#include <algorithm>
+#include "asset_jobs.h"
+
+AssetJobs::AssetJobs(unsigned int threadCount)
+{
+	threadCount = std::max(1u, threadCount);
+	workers.reserve(threadCount);
+	for (unsigned int t = 0; t < threadCount; ++t)
+	{
+		workers.emplace_back(&AssetJobs::work, this);
+	}
+}
+
+AssetJobs::~AssetJobs()
+{
+	finish();
+}
+
+void AssetJobs::add(std::function<void()> decode, std::function<void()> upload)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(Job{ std::move(decode), std::move(upload) });
+		++pendingCount;
+	}
+	jobQueued.notify_one();
+}
+
+void AssetJobs::finish()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobDecoded.wait(lock, [this] { return !decoded.empty() || pendingCount == 0; });
+			if (decoded.empty()) break; // (then nothing is pending)
+
+			job = std::move(decoded.front());
+			decoded.pop_front();
+		}
+
+		// out of the lock: the workers go on decoding meanwhile
+		job.upload();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		--pendingCount;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobQueued.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+}
+
+void AssetJobs::work()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobQueued.wait(lock, [this] { return !queued.empty() || stopping; });
+			if (queued.empty()) return; // stopping, with nothing left
+
+			job = std::move(queued.front());
+			queued.pop_front();
+		}
+
+		job.decode();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.push_back(std::move(job));
+		}
+		jobDecoded.notify_one();
+	}
+}
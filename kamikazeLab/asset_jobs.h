@@ -0,0 +1,58 @@
+#ifndef _ASSET_JOBS_H_
+#define _ASSET_JOBS_H_
+
+/* AssetJobs:
+ * a pool of threads which decode the assets (read, parse, expand: anything but GL),
+ * while the thread which owns the GL context uploads them, each as soon as it is decoded.
+ *
+ * A job is a pair of steps:
+ *  - decode: on any worker, in any order, concurrently with the other decodes
+ *  - upload: on the thread calling finish, in the order the decodes complete
+ * so loading takes about as long as the slowest decode (plus the uploads), not as the sum of all of them.
+ *
+ * Nothing here knows about the assets, or GL: the steps are whatever the caller gives.
+ */
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AssetJobs
+{
+	explicit AssetJobs(unsigned int threadCount);
+	~AssetJobs(); // finishes first, if not yet done
+
+	AssetJobs(const AssetJobs&) = delete;
+	AssetJobs& operator=(const AssetJobs&) = delete;
+
+	// the decode starts as soon as a worker is free
+	void add(std::function<void()> decode, std::function<void()> upload);
+
+	// on the GL thread: uploads the decoded jobs as they come, until all of them are uploaded.
+	// Then the workers stop: no more jobs can be added
+	void finish();
+
+private:
+	struct Job
+	{
+		std::function<void()> decode;
+		std::function<void()> upload;
+	};
+
+	void work();
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable jobQueued;
+	std::condition_variable jobDecoded;
+	std::deque<Job> queued; // to decode
+	std::deque<Job> decoded; // to upload, in the order they completed
+	size_t pendingCount = 0; // added and not uploaded yet
+	bool stopping = false;
+};
+
+#endif
@@ -9,6 +9,9 @@ template<typename CpuAssetType, typename GpuAssetType, typename IDType = std::st
 struct AssetLibrary
 {
 	void add(const IDType& id, const CpuAssetType& cpuAsset);
+	// from anything else which uploads to the same GPU asset (e.g. a view on a mapped, cooked one)
+	template<typename CpuSourceType>
+	void addFrom(const IDType& id, const CpuSourceType& cpuSource);
 	GpuAssetType get(const IDType& id)const;
 	GpuAssetType remove(const IDType& id);
 	void removeAndRelease(const IDType& id);
@@ -26,6 +29,15 @@ inline void AssetLibrary<CpuAssetType, GpuAssetType, IDType>::add(const IDType&
 	assets.insert(std::pair<IDType, GpuAssetType>(id, cpuAsset.uploadToGPU()));
 }
 
+template<typename CpuAssetType, typename GpuAssetType, typename IDType>
+template<typename CpuSourceType>
+inline void AssetLibrary<CpuAssetType, GpuAssetType, IDType>::addFrom(const IDType& id, const CpuSourceType& cpuSource)
+{
+	auto it = assets.find(id);
+	assert(it == assets.end());
+	assets.insert(std::pair<IDType, GpuAssetType>(id, cpuSource.uploadToGPU()));
+}
+
 template<typename CpuAssetType, typename GpuAssetType, typename IDType>
 inline GpuAssetType AssetLibrary<CpuAssetType, GpuAssetType, IDType>::get(const IDType& id)const
 {
@@ -3,11 +3,24 @@
  * Importing, procedural construction, maybe a bit of pre-processing
  */
 
+#include <chrono>
 #include <fstream>
+#include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
 
 #include"mesh.h"
+#include "mapped_file.h"
+#include "obj_parser.h"
+#include "cooked_mesh.h"
+#include "ppm_image.h"
+#include "asset_jobs.h"
 #include"custom_classes.h"
 #include"texture.h"
 #include "shader.h"
@@ -22,72 +35,71 @@ TextureLibrary g_textureLibrary{};
 ProgramLibrary g_programLibrary{};
 TextureCubeLibrary g_textureCubeLibrary{};
 
-void preloadAllAssets(){
-
-	const std::string darkFighterPath = g_assetsPath + "dark_fighter/";
+// a mesh from its .kmesh, when that is up to date (see cooked_mesh.h): else imported, and cooked for the next time
+struct MeshLoad{
+	CookedMesh cooked;
+	bool isCooked = false;
+	CpuMesh mesh;
+};
+
+static void addMeshJob(AssetJobs& jobs, const std::string& id, const std::string& filename){
+	auto load = std::make_shared<MeshLoad>();
+
+	jobs.add(
+		[load, filename]{
+			load->isCooked = load->cooked.open(filename);
+			if (load->isCooked) return;
+
+			FileStamp stamp;
+			const bool stamped = readFileStamp(filename, stamp);
+			// the job is already one of the workers: the parse takes no threads of its own
+			if (load->mesh.import(filename, nullptr, 1) && stamped) cookMesh(load->mesh, filename, stamp);
+		},
+		[load, id]{
+			if (load->isCooked) g_meshLibrary.addFrom(id, load->cooked.view());
+			else g_meshLibrary.add(id, load->mesh);
+		}
+	);
+}
 
-	CpuMesh shipMesh;
-	shipMesh.import(darkFighterPath + "dark_fighter_6.obj");
+static void addTextureJob(AssetJobs& jobs, const std::string& id, const std::string& filename, bool isLinear){
+	auto texture = std::make_shared<CpuTexture>();
+	texture->isLinear = isLinear;
 
-	CpuTexture shipDiffuseTexture;
-	shipDiffuseTexture.import(darkFighterPath + "dark_fighter_6_color.pbm");
-	
-	CpuTexture shipNormalTexture;
-	shipNormalTexture.import(darkFighterPath + "dark_fighter_6_normal.pbm");
-	shipNormalTexture.isLinear = true;
-	
-	CpuTexture shipSpecularTexture;
-	shipSpecularTexture.import(darkFighterPath + "dark_fighter_6_specular.pbm");
-	shipSpecularTexture.isLinear = true;
-
-	g_meshLibrary.add("ShipMesh", shipMesh);
-	g_textureLibrary.add("ShipDiffuseMap", shipDiffuseTexture);
-	g_textureLibrary.add("ShipNormalMap", shipNormalTexture);
-	g_textureLibrary.add("ShipSpecularMap", shipSpecularTexture);
-	
-	const std::string missilePath = g_assetsPath + "missile/";
+	jobs.add(
+		[texture, filename]{ texture->import(filename); },
+		[texture, id]{ g_textureLibrary.add(id, *texture); }
+	);
+}
 
-	CpuMesh bulletMesh;
-	bulletMesh.import(missilePath + "missile.obj");
+// every asset is decoded on its own job, concurrently: only the uploads are left to this (the GL) thread
+void preloadAllAssets(){
+	AssetJobs jobs(std::max(1u, std::thread::hardware_concurrency()));
 
-	CpuTexture bulletDiffuseTexture;
-	bulletDiffuseTexture.import(missilePath + "hellfire_diffuse.pbm");
+	const std::string darkFighterPath = g_assetsPath + "dark_fighter/";
 
-	CpuTexture bulletNormalTexture;
-	bulletNormalTexture.import(missilePath + "hellfire_NRM.pbm");
-	bulletNormalTexture.isLinear = true;
+	addMeshJob(jobs, "ShipMesh", darkFighterPath + "dark_fighter_6.obj");
+	addTextureJob(jobs, "ShipDiffuseMap", darkFighterPath + "dark_fighter_6_color.pbm", false);
+	addTextureJob(jobs, "ShipNormalMap", darkFighterPath + "dark_fighter_6_normal.pbm", true);
+	addTextureJob(jobs, "ShipSpecularMap", darkFighterPath + "dark_fighter_6_specular.pbm", true);
 
-	CpuTexture bulletSpecularTexture;
-	bulletSpecularTexture.import(missilePath + "hellfire_SPEC.pbm");
-	bulletSpecularTexture.isLinear = true;
-	
-	g_meshLibrary.add("BulletMesh", bulletMesh);
-	g_textureLibrary.add("BulletDiffuseMap", bulletDiffuseTexture);
-	g_textureLibrary.add("BulletNormalMap", bulletNormalTexture);
-	g_textureLibrary.add("BulletSpecularMap", bulletSpecularTexture);
+	const std::string missilePath = g_assetsPath + "missile/";
 
+	addMeshJob(jobs, "BulletMesh", missilePath + "missile.obj");
+	addTextureJob(jobs, "BulletDiffuseMap", missilePath + "hellfire_diffuse.pbm", false);
+	addTextureJob(jobs, "BulletNormalMap", missilePath + "hellfire_NRM.pbm", true);
+	addTextureJob(jobs, "BulletSpecularMap", missilePath + "hellfire_SPEC.pbm", true);
 
 	const std::string floorPath = g_assetsPath + "floor/";
-	
-	CpuMesh floorMesh;
-	floorMesh.buildGrid(1.0f, 1.0f, 10, 10);
-	
-	CpuTexture floorDiffuseTexture;
-	floorDiffuseTexture.import(floorPath + "Foothills_of_Ariloa.pbm");
-	
-	CpuTexture floorNormalTexture;
-	floorNormalTexture.import(floorPath + "Foothills_of_Ariloa_NRM.pbm");
-	floorNormalTexture.isLinear = true;
-
-	CpuTexture floorSpecularTexture;
-	floorSpecularTexture.import(floorPath + "Foothills_of_Ariloa_SPEC.pbm");
-	floorSpecularTexture.isLinear = true;
-
-	g_meshLibrary.add("FloorMesh", floorMesh);
-	g_textureLibrary.add("FloorDiffuseMap", floorDiffuseTexture);
-	g_textureLibrary.add("FloorNormalMap", floorNormalTexture);
-	g_textureLibrary.add("FloorSpecularMap", floorSpecularTexture);
-	
+
+	auto floorMesh = std::make_shared<CpuMesh>();
+	jobs.add(
+		[floorMesh]{ floorMesh->buildGrid(1.0f, 1.0f, 10, 10); },
+		[floorMesh]{ g_meshLibrary.add("FloorMesh", *floorMesh); }
+	);
+	addTextureJob(jobs, "FloorDiffuseMap", floorPath + "Foothills_of_Ariloa.pbm", false);
+	addTextureJob(jobs, "FloorNormalMap", floorPath + "Foothills_of_Ariloa_NRM.pbm", true);
+	addTextureJob(jobs, "FloorSpecularMap", floorPath + "Foothills_of_Ariloa_SPEC.pbm", true);
 
 	std::vector<std::string> cubeMapFaces{ "posx.pbm", "negx.pbm", "posy.pbm", "negy.pbm", "posz.pbm", "negz.pbm" };
 	for (int i = 0; i < 6; ++i)
@@ -95,10 +107,149 @@ void preloadAllAssets(){
 		cubeMapFaces[i] = g_assetsPath + "envmap_interstellar/" + cubeMapFaces[i];
 	}
 
-	CpuTextureCube textureCube;
-	textureCube.import(cubeMapFaces);
+	auto textureCube = std::make_shared<CpuTextureCube>();
+	jobs.add(
+		[textureCube, cubeMapFaces]{ textureCube->import(cubeMapFaces); },
+		[textureCube]{ g_textureCubeLibrary.add("SkyBox", *textureCube); }
+	);
 
-	g_textureCubeLibrary.add("SkyBox", textureCube);
+	jobs.finish();
+}
+
+// times each importer (meshes and textures) against the one it replaced, on the assets of the game (kamikaze --bench-import)
+int benchAssetImport(){
+	const int reps = 50;
+
+	auto timePerFile = [&]( auto importer, const std::string& filename, CpuMesh& mesh ) {
+		auto start = std::chrono::steady_clock::now();
+		for (int k = 0; k < reps; k++) {
+			mesh = CpuMesh{};
+			if (!importer( mesh, filename )) return -1.0;
+		}
+		return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() / reps;
+	};
+
+	const std::string meshes[] = {
+		g_assetsPath + "dark_fighter/dark_fighter_6.obj",
+		g_assetsPath + "missile/missile.obj"
+	};
+
+	int result = 0;
+	for (const std::string& filename : meshes) {
+		MappedFile file;
+		if (!file.open( filename )) {
+			std::cout << filename << ": not found\n";
+			return 1;
+		}
+		const double megabytes = file.size() / (1024.0 * 1024.0);
+
+		CpuMesh streamsMesh, mappedMesh;
+		MeshImportStats stats;
+		const double tStreams = timePerFile( []( CpuMesh& m, const std::string& f ) { return m.importWithStreams( f ); }, filename, streamsMesh );
+		const double tMapped = timePerFile( [&]( CpuMesh& m, const std::string& f ) { return m.import( f, &stats, std::max( 1u, std::thread::hardware_concurrency() ) ); }, filename, mappedMesh );
+		if (tStreams < 0.0 || tMapped < 0.0) {
+			std::cout << filename << ": import failed\n";
+			return 1;
+		}
+
+		std::cout << filename << " (" << file.size() / 1024 << " KB)\n";
+		std::cout << "  streams: " << megabytes / tStreams << " MB/s\n";
+		std::cout << "  mapped:  " << megabytes / tMapped << " MB/s (" << tStreams / tMapped << "x)\n";
+
+		std::cout << "  welded:  " << stats.cornerCount << " corners in " << stats.vertexCount << " vertices ("
+			<< stats.dedupRatio() << "x), the streams importer made " << streamsMesh.verts.size() << "\n";
+
+		// the vertices differ (welded, or not): the corners of the triangles must not
+		bool same = streamsMesh.tris.size() == mappedMesh.tris.size();
+		for (size_t t = 0; same && t < mappedMesh.tris.size(); t++) {
+			const Tri& a = streamsMesh.tris[t];
+			const Tri& b = mappedMesh.tris[t];
+			same = streamsMesh.verts[a.i].pos == mappedMesh.verts[b.i].pos && streamsMesh.verts[a.i].uv == mappedMesh.verts[b.i].uv
+				&& streamsMesh.verts[a.j].pos == mappedMesh.verts[b.j].pos && streamsMesh.verts[a.j].uv == mappedMesh.verts[b.j].uv
+				&& streamsMesh.verts[a.k].pos == mappedMesh.verts[b.k].pos && streamsMesh.verts[a.k].uv == mappedMesh.verts[b.k].uv;
+		}
+		if (!same) {
+			std::cout << "  MISMATCH with the streams importer\n";
+			result = 1;
+		}
+
+		// the .kmesh: mapped, and every byte of it read once (as the upload would)
+		FileStamp stamp;
+		if (!readFileStamp( filename, stamp ) || !cookMesh( mappedMesh, filename, stamp )) {
+			std::cout << "  could not cook " << cookedMeshFilename( filename ) << "\n";
+			return 1;
+		}
+
+		CookedMesh cooked;
+		volatile unsigned char touched = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int k = 0; k < reps; k++) {
+			if (!cooked.open( filename )) break;
+			const CpuMeshView view = cooked.view();
+			const unsigned char* bytes = reinterpret_cast<const unsigned char*>(view.verts);
+			for (size_t i = 0; i < view.vertexCount * sizeof(Vertex); i += 64) touched = bytes[i];
+		}
+		const double tCooked = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() / reps;
+
+		const CpuMeshView view = cooked.view();
+		same = view.vertexCount == mappedMesh.verts.size() && view.triCount == mappedMesh.tris.size()
+			&& std::memcmp( view.verts, mappedMesh.verts.data(), sizeof(Vertex) * view.vertexCount ) == 0
+			&& std::memcmp( view.tris, mappedMesh.tris.data(), sizeof(Tri) * view.triCount ) == 0;
+		if (!same) {
+			std::cout << "  MISMATCH with the cooked mesh\n";
+			result = 1;
+			continue;
+		}
+		std::cout << "  cooked:  " << tCooked * 1e6 << " us per load (" << tMapped / tCooked << "x the mapped import)\n";
+	}
+
+	const std::string textures[] = {
+		g_assetsPath + "dark_fighter/dark_fighter_6_color.pbm",
+		g_assetsPath + "envmap_interstellar/negx.pbm"
+	};
+
+	for (const std::string& filename : textures) {
+		MappedFile file;
+		if (!file.open( filename )) {
+			std::cout << filename << ": not found\n";
+			return 1;
+		}
+		const double megabytes = file.size() / (1024.0 * 1024.0);
+
+		auto timeTexture = [&]( auto importer, CpuTexture& texture ) {
+			auto start = std::chrono::steady_clock::now();
+			for (int k = 0; k < reps; k++) {
+				texture = CpuTexture{};
+				if (!importer( texture, filename )) return -1.0;
+			}
+			return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() / reps;
+		};
+
+		CpuTexture streamsTexture, mappedTexture;
+		const double tStreams = timeTexture( []( CpuTexture& t, const std::string& f ) { return t.importWithStreams( f ); }, streamsTexture );
+		const double tMapped = timeTexture( []( CpuTexture& t, const std::string& f ) { return t.import( f ); }, mappedTexture );
+		if (tStreams < 0.0 || tMapped < 0.0) {
+			std::cout << filename << ": import failed\n";
+			return 1;
+		}
+
+		std::cout << filename << " (" << mappedTexture.sizeX << "x" << mappedTexture.sizeY << ")\n";
+		std::cout << "  streams: " << megabytes / tStreams << " MB/s\n";
+		std::cout << "  mapped:  " << megabytes / tMapped << " MB/s (" << tStreams / tMapped << "x)\n";
+
+		// (the streams importer never set the alpha)
+		bool same = streamsTexture.data.size() == mappedTexture.data.size();
+		for (size_t i = 0; same && i < mappedTexture.data.size(); i++) {
+			const Texel& a = streamsTexture.data[i];
+			const Texel& b = mappedTexture.data[i];
+			same = a.r == b.r && a.g == b.g && a.b == b.b && b.a == 255;
+		}
+		if (!same) {
+			std::cout << "  MISMATCH with the streams importer\n";
+			result = 1;
+		}
+	}
+	return result;
 }
 
 void CpuMesh::addQuad(int i, int j, int k, int h){
@@ -336,7 +487,139 @@ void CpuMesh::buildFullScreenQuad()
 	tris[1] = Tri{ 0, 2, 3 };	
 }
 
-bool CpuMesh::import(const std::string& filename){
+CpuMeshView CpuMesh::view()const{
+	CpuMeshView v;
+	v.verts = verts.data();
+	v.vertexCount = verts.size();
+	v.tris = tris.data();
+	v.triCount = tris.size();
+	v.boundingSphere = boundingSphere();
+	return v;
+}
+
+vec4 CpuMesh::boundingSphere()const{
+	if (verts.empty()) return vec4(0.0f);
+
+	vec3 minPos = verts[0].pos;
+	vec3 maxPos = verts[0].pos;
+	for (const Vertex& v : verts) {
+		minPos = glm::min( minPos, v.pos );
+		maxPos = glm::max( maxPos, v.pos );
+	}
+
+	vec3 center = (minPos + maxPos) * 0.5f;
+	float radius2 = 0;
+	for (const Vertex& v : verts) {
+		vec3 d = v.pos - center;
+		radius2 = std::max( radius2, dot( d, d ) );
+	}
+
+	return vec4( center, std::sqrt( radius2 ) );
+}
+
+// a slot of VertexWelder with no vertex
+static constexpr int EMPTY_SLOT = -1;
+
+// the corners of the imported triangles, welded: one vertex per distinct (position, normal, uv).
+// An open addressing table (linear probing, at most half full) of indices in the vertices
+struct VertexWelder{
+	VertexWelder(std::vector< Vertex >& verts, size_t cornerCount):verts(verts){
+		size_t slotCount = 16;
+		while (slotCount < cornerCount * 2) slotCount *= 2;
+		slots.assign(slotCount, EMPTY_SLOT);
+		mask = slotCount - 1;
+		verts.reserve(cornerCount);
+	}
+
+	// the index of the vertex equal to v: a new one, the first time
+	int weld(const Vertex& v){
+		for (size_t slot = hash(v) & mask; ; slot = (slot + 1) & mask) {
+			const int index = slots[slot];
+			if (index == EMPTY_SLOT) {
+				slots[slot] = static_cast<int>(verts.size());
+				verts.push_back(v);
+				return slots[slot];
+			}
+			const Vertex& w = verts[index];
+			if (w.pos == v.pos && w.norm == v.norm && w.uv == v.uv) return index;
+		}
+	}
+
+private:
+	static uint32_t bits(float f){
+		if (f == 0.0f) return 0; // -0 and +0 are equal: they must hash the same
+		uint32_t b;
+		std::memcpy(&b, &f, sizeof(b));
+		return b;
+	}
+
+	static uint64_t hash(const Vertex& v){
+		const float keys[8] = { v.pos.x, v.pos.y, v.pos.z, v.norm.x, v.norm.y, v.norm.z, v.uv.x, v.uv.y };
+		uint64_t h = 0x9E3779B97F4A7C15ull;
+		for (float key : keys) {
+			h = (h ^ bits(key)) * 0xFF51AFD7ED558CCDull;
+			h ^= h >> 32;
+		}
+		return h;
+	}
+
+	std::vector< Vertex >& verts;
+	std::vector< int > slots;
+	size_t mask;
+};
+
+bool CpuMesh::import(const std::string& filename, MeshImportStats* stats, unsigned int threadCount){
+	MappedFile file;
+	if (!file.open(filename)) return false;
+
+	ObjData obj;
+	if (!parseObj(file.data(), file.size(), obj, threadCount)) return false;
+
+	// without normals in the file, the corners weld on position and uv only: the normals are computed after
+	const bool hasNormals = obj.hasNormals();
+
+	verts.clear();
+	tris.clear();
+	tris.reserve(obj.corners.size() / 3);
+	VertexWelder welder(verts, obj.corners.size());
+
+	for (size_t c = 0; c < obj.corners.size(); c += 3) {
+		int v[3];
+		for (int k = 0; k < 3; ++k) {
+			const ObjCorner& corner = obj.corners[c + k];
+			const vec3& p = obj.positions[corner.position];
+
+			Vertex vertex;
+			vertex.pos = vec3(p.x, p.z, p.y);
+			vertex.norm = vec3(0.0f);
+			if (hasNormals) {
+				const vec3& n = obj.normals[corner.normal];
+				vertex.norm = vec3(n.x, n.z, n.y);
+			}
+			vertex.uv = vec2(0.0f);
+			if (corner.uv >= 0) {
+				const vec2& uv = obj.uvs[corner.uv];
+				vertex.uv = vec2(uv.x, 1.0f - uv.y); // NB: flipping the y, different conventions about UV space
+			}
+			vertex.tang = vec4(0.0f);
+
+			v[k] = welder.weld(vertex);
+		}
+		tris.push_back(Tri(v[0], v[1], v[2]));
+	}
+
+	if (!hasNormals) updateNormals();
+
+	computeTangents();
+
+	if (stats) {
+		stats->cornerCount = obj.corners.size();
+		stats->vertexCount = verts.size();
+	}
+	return true;
+}
+
+bool CpuMesh::importWithStreams(const std::string& filename){
 	std::ifstream infile(filename);
 	if (!infile.is_open()) return false;
 	std::string line;
@@ -398,6 +681,24 @@ bool CpuMesh::import(const std::string& filename){
 	return true;
 }
 
+void CpuMesh::updateNormals(){
+	std::vector< vec3 > sums(verts.size(), vec3(0.0f));
+
+	for (const Tri& t : tris) {
+		// as long as twice the area of the triangle: the weight comes for free.
+		// (i, k, j): the swap of y and z in import mirrors the triangles, which were counterclockwise in the file
+		const vec3 n = cross(verts[t.k].pos - verts[t.i].pos, verts[t.j].pos - verts[t.i].pos);
+		sums[t.i] += n;
+		sums[t.j] += n;
+		sums[t.k] += n;
+	}
+
+	for (size_t i = 0; i < verts.size(); ++i) {
+		const float l = length(sums[i]);
+		verts[i].norm = l > 0.0f ? sums[i] / l : vec3(0.0f, 1.0f, 0.0f);
+	}
+}
+
 void CpuMesh::computeTangents()
 {
 	assert((verts.size() > 0 && tris.size() > 0) || (verts.size() == 0 && tris.size() == 0));
@@ -519,6 +820,31 @@ void CpuMesh::computeTangents()
 
 
 bool CpuTexture::import(std::string filename){
+	MappedFile file;
+	if (!file.open(filename)) return false;
+
+	PpmHeader header;
+	if (!parsePpmHeader(file.data(), file.size(), header)) return false;
+
+	sizeX = header.width;
+	sizeY = header.height;
+	data.resize(size_t(sizeX) * sizeY);
+
+	const unsigned char* rgb = reinterpret_cast<const unsigned char*>(file.data() + header.payloadOffset);
+	expandRgbToRgba(rgb, reinterpret_cast<unsigned char*>(data.data()), data.size());
+
+	if (header.maxValue != 255) {
+		for (Texel& t : data) {
+			t.r = byte(t.r * 255 / header.maxValue);
+			t.g = byte(t.g * 255 / header.maxValue);
+			t.b = byte(t.b * 255 / header.maxValue);
+		}
+	}
+
+	return true;
+}
+
+bool CpuTexture::importWithStreams(std::string filename){
 	std::ifstream infile(filename,std::ios::binary);
 	if (!infile.is_open()) return false;
 
@@ -0,0 +1,56 @@
+in vec2 v_textCoord;
+
+layout(binding=0) uniform sampler2D u_depthBuffer;
+layout(binding=1) uniform sampler2D u_normalBuffer;
+layout(binding=2) uniform sampler2D u_lowResolutionDepthBuffer;
+layout(binding=3) uniform sampler2D u_lowResolutionNormalBuffer;
+layout(binding=4) uniform sampler2D u_lowResolutionColorMap;
+
+layout (binding=0, std140) uniform SceneFragmentShaderUniformBlock
+{
+	vec2 u_lowResolutionSize;
+	float u_frustumNear;
+	float u_frustumFar;
+};
+
+out float upsampledFragment;
+
+void main()
+{
+	float depth = texture(u_depthBuffer, v_textCoord).r;
+	vec3 normal = unpackGBufferNormal(texture(u_normalBuffer, v_textCoord));
+	float viewSpaceDepth = computeViewDepthFromNDCDepth(2.0f*depth - 1.0f, u_frustumNear, u_frustumFar);
+
+	//the 4 low resolution texels around this fragment, and where the fragment lies among them
+	vec2 lowResolutionPosition = v_textCoord * u_lowResolutionSize - 0.5f;
+	ivec2 baseCoord = ivec2(floor(lowResolutionPosition));
+	vec2 f = lowResolutionPosition - vec2(baseCoord);
+	ivec2 maxCoord = ivec2(u_lowResolutionSize) - 1;
+
+	float bilinearWeights[4] = float[4]((1.0f - f.x) * (1.0f - f.y), f.x * (1.0f - f.y), (1.0f - f.x) * f.y, f.x * f.y);
+	ivec2 offsets[4] = ivec2[4](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(1, 1));
+
+	float result = 0.0f;
+	float totalWeight = 0.0f;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		ivec2 sampleCoord = clamp(baseCoord + offsets[i], ivec2(0, 0), maxCoord);
+
+		float sampleDepth = texelFetch(u_lowResolutionDepthBuffer, sampleCoord, 0).r;
+		vec3 sampleNormal = unpackGBufferNormal(texelFetch(u_lowResolutionNormalBuffer, sampleCoord, 0));
+		float sampleViewSpaceDepth = computeViewDepthFromNDCDepth(2.0f*sampleDepth - 1.0f, u_frustumNear, u_frustumFar);
+
+		//the texels of other surfaces (across a depth edge or a crease) hardly count
+		float depthWeight = 1.0f / (0.001f + abs(sampleViewSpaceDepth - viewSpaceDepth));
+		float normalWeight = pow(max(dot(sampleNormal, normal), 0.0f), 8.0f);
+
+		float weight = bilinearWeights[i] * depthWeight * normalWeight;
+
+		result += weight * texelFetch(u_lowResolutionColorMap, sampleCoord, 0).r;
+		totalWeight += weight;
+	}
+
+	//none of them is on this surface: better the plain lookup than nothing
+	upsampledFragment = totalWeight > 1e-4f ? result / totalWeight : texture(u_lowResolutionColorMap, v_textCoord).r;
+}
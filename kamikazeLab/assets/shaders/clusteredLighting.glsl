@@ -0,0 +1,48 @@
+//the point lights, binned into clusters on the CPU (see light_clusters.h and clustered_lighting.h)
+
+layout (binding=4, std140) uniform ClusterUniformBlock
+{
+	uvec4 u_clusterGridSize; //tiles x, tiles y, slices
+	vec4 u_clusterTileSizeAndDepthMapping; //tile size in pixels; slice = log(view depth) * z + w
+};
+
+layout (binding=0, std430) readonly buffer ClusterLightBuffer
+{
+	PointLight u_clusterLights[];
+};
+
+layout (binding=1, std430) readonly buffer ClusterRangeBuffer
+{
+	uvec2 u_clusterRanges[]; //offset and count, in u_clusterLightIndices
+};
+
+layout (binding=2, std430) readonly buffer ClusterLightIndexBuffer
+{
+	uint u_clusterLightIndices[];
+};
+
+//viewDepth: the distance of the fragment from the eye, along the view direction
+uint findCluster(vec2 fragCoord, float viewDepth)
+{
+	uvec2 tile = min(uvec2(fragCoord / u_clusterTileSizeAndDepthMapping.xy), u_clusterGridSize.xy - 1u);
+	float slice = log(viewDepth) * u_clusterTileSizeAndDepthMapping.z + u_clusterTileSizeAndDepthMapping.w;
+	uint z = uint(clamp(slice, 0.0f, float(u_clusterGridSize.z - 1u)));
+
+	return tile.x + u_clusterGridSize.x * (tile.y + u_clusterGridSize.y * z);
+}
+
+vec3 computeClusteredPointLightsReflectedRadiance(vec2 fragCoord, float viewDepth, vec3 position, vec3 normal, vec3 toEye, vec3 diffuseColor, vec3 specularColor, float specularExponent)
+{
+	uvec2 range = u_clusterRanges[findCluster(fragCoord, viewDepth)];
+
+	vec3 reflectedRadiance = vec3(0.0f, 0.0f, 0.0f);
+
+	for (uint i = 0u; i < range.y; i++)
+	{
+		PointLight pointLight = u_clusterLights[u_clusterLightIndices[range.x + i]];
+		reflectedRadiance +=
+			computePointLightReflectedRadiance(pointLight, position, normal, toEye, diffuseColor, specularColor, specularExponent);
+	}
+
+	return reflectedRadiance;
+}
@@ -0,0 +1,36 @@
+in vec2 v_textCoord;
+
+layout(binding=0) uniform sampler2D u_depthBuffer;
+layout(binding=1) uniform sampler2D u_normalBuffer;
+
+layout(location = 0) out float downsampledDepth;
+layout(location = 1) out vec4 downsampledNormal;
+
+void main()
+{
+	//the 2x2 full resolution texels under this one: the nearest of them is kept (depth and normal together),
+	//averaging would make up surfaces which are not there
+	ivec2 fullResolutionCoord = 2 * ivec2(gl_FragCoord.xy);
+	ivec2 fullResolutionMax = textureSize(u_depthBuffer, 0) - 1;
+
+	ivec2 nearestCoord = fullResolutionCoord;
+	float nearestDepth = 1.0f;
+
+	for(int y = 0; y < 2; ++y)
+	{
+		for(int x = 0; x < 2; ++x)
+		{
+			ivec2 sampleCoord = min(fullResolutionCoord + ivec2(x, y), fullResolutionMax);
+			float sampleDepth = texelFetch(u_depthBuffer, sampleCoord, 0).r;
+
+			if(sampleDepth < nearestDepth)
+			{
+				nearestDepth = sampleDepth;
+				nearestCoord = sampleCoord;
+			}
+		}
+	}
+
+	downsampledDepth = nearestDepth;
+	downsampledNormal = texelFetch(u_normalBuffer, nearestCoord, 0); //still packed, as in the G-buffer
+}
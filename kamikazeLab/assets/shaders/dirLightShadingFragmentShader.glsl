@@ -4,13 +4,14 @@ in vec3 v_viewRay;
 layout (binding=1, std140) uniform SceneFragmentShaderUniformBlock
 {
 	vec3 u_ambientLight;
-	float scenePad; 
+	uint u_clusteredPointLights; //0 when the point lights are drawn as volumes
 	float u_frustumNear;
 	float u_frustumFar;
 	vec2 scenePad1;	
 	DirectionalLight u_directionalLights[DIR_LIGHT_COUNT];
 	vec4 u_dirShadowMapSizeAndBias[DIR_LIGHT_COUNT];
-	mat4 u_dirShadowTransforms[DIR_LIGHT_COUNT]; //view space (main camera space) -> light ndc space
+	vec4 u_shadowCascadeFarDepths;
+	mat4 u_dirShadowTransforms[DIR_LIGHT_COUNT * SHADOW_CASCADE_COUNT]; //view space (main camera space) -> light ndc space, per cascade
 };
 
 layout(binding= 4) uniform sampler2D u_dirShadowMaps[DIR_LIGHT_COUNT];
@@ -27,9 +28,9 @@ out vec3 fragmentRadiance;
 void main()
 {			
 	float depth = texture(u_depthBuffer, v_textCoord).r;
-	vec3 normal = normalize(texture(u_normalBuffer, v_textCoord).rgb);
+	vec3 normal = unpackGBufferNormal(texture(u_normalBuffer, v_textCoord));
 	vec3 diffuse = texture(u_diffuseBuffer, v_textCoord).rgb;
-	vec4 specularAndExponent = texture(u_specularAndExponentBuffer, v_textCoord);
+	vec4 specularAndExponent = unpackGBufferSpecularAndExponent(texture(u_specularAndExponentBuffer, v_textCoord));
 
 	vec3 specular = specularAndExponent.xyz;
 	float specularExponent = specularAndExponent.w;
@@ -42,23 +43,28 @@ void main()
 	vec3 toEye = reconstructedToEye;
 
 	vec3 reflectedRadiance = vec3(0.0f, 0.0f, 0.0f);
+
+	int cascade = findShadowCascade(-position.z, u_shadowCascadeFarDepths);
 	
 	for (int i = 0; i < DIR_LIGHT_COUNT; i++)
 	{
 		vec3 dirLightReflectedRadiance = computeDirLightReflectedRadiance(u_directionalLights[i], normal, toEye, diffuse, specular, specularExponent);
-		vec4 shadowPos = u_dirShadowTransforms[i] * vec4(position, 1.0f); //no need to divide by w as the projection transform is orthographic
+		vec4 shadowPos = u_dirShadowTransforms[i * SHADOW_CASCADE_COUNT + cascade] * vec4(position, 1.0f); //no need to divide by w as the projection transform is orthographic
 		shadowPos.xyz *= 0.5f;
 		shadowPos.xyz += 0.5f;
-		float depth = shadowPos.z;
-		vec2 shadowMapCoord = shadowPos.xy;				
 		vec3 shadowMapParams = u_dirShadowMapSizeAndBias[i].xyz;
-		float shadowFactor = calcShadowFactor(u_dirShadowMaps[i], depth + shadowMapParams.z, shadowMapCoord, shadowMapParams.xy);
-		bvec4 inside = bvec4(shadowMapCoord.x >= 0.0, shadowMapCoord.x <= 1.0, shadowMapCoord.y >= 0.0, shadowMapCoord.y <= 1.0);
-		bool infrustum = all(inside);
-		infrustum = all(bvec2(infrustum, depth <= 1.0));
-		float occlusion = float(infrustum)*shadowFactor;
+		float occlusion = calcCascadedShadowFactor(u_dirShadowMaps[i], shadowPos.xyz, cascade, shadowMapParams.xy, shadowMapParams.z);
 		reflectedRadiance += dirLightReflectedRadiance * occlusion;		
 	}
+
+#ifdef CLUSTERED_POINT_LIGHTS
+	//and, in the same pass, the point lights of the cluster of the fragment
+	if (u_clusteredPointLights != 0u)
+	{
+		reflectedRadiance +=
+			computeClusteredPointLightsReflectedRadiance(gl_FragCoord.xy, -position.z, position, normal, toEye, diffuse, specular, specularExponent);
+	}
+#endif
 	
 	vec3 ambientTerm = u_ambientLight*diffuse;
 	float accessibility = texture(u_ssaoMap, v_textCoord).r;
@@ -14,7 +14,7 @@ layout (binding=0, std140) uniform SceneFragmentShaderUniformBlock
 vec3 processSample(vec2 sampleTextCoord, float weight, inout float weightAccumulator, vec3 referenceNormal, float referenceViewSpaceDepth)
 {
 	float sampleDepth = texture(u_depthBuffer, sampleTextCoord).r;
-	vec3 sampleNormal = normalize(texture(u_normalBuffer, sampleTextCoord).rgb);
+	vec3 sampleNormal = unpackGBufferNormal(texture(u_normalBuffer, sampleTextCoord));
 	float sampleViewSpaceDepth = computeViewDepthFromNDCDepth(2.0f*sampleDepth - 1.0f, u_frustumNear, u_frustumFar);	
 
 	if(dot(sampleNormal, referenceNormal) >= 0.8f && abs(sampleViewSpaceDepth - referenceViewSpaceDepth) <= 0.2f)
@@ -31,7 +31,7 @@ out float blurredFragment;
 void main()
 {
 	float depth = texture(u_depthBuffer, v_textCoord).r;
-	vec3 normal = normalize(texture(u_normalBuffer, v_textCoord).rgb);
+	vec3 normal = unpackGBufferNormal(texture(u_normalBuffer, v_textCoord));
 	float viewSpaceDepth = computeViewDepthFromNDCDepth(2.0f*depth - 1.0f, u_frustumNear, u_frustumFar);	
 		
 	#ifdef HORIZONTAL
@@ -3,8 +3,6 @@ in vec3 v_normal;
 in vec2 v_textCoord;
 in vec4 v_tangentWithHandedness;
 
-in vec4 v_dirShadowPosition[DIR_LIGHT_COUNT];
-
 layout (binding = 3, std140) uniform ObjectFragmentShaderUniformBlock
 {
 	vec4 u_matSpecularAndExponent;
@@ -22,8 +20,9 @@ layout (binding=2, std140) uniform SceneFragmentShaderUniformBlock
 	vec3 u_eyePosition;
 	float scenePad1;
 	DirectionalLight u_directionalLights[DIR_LIGHT_COUNT];
-	PointLight u_pointLights[POINT_LIGHT_COUNT];
 	vec4 u_dirShadowMapSizeAndBias[DIR_LIGHT_COUNT];
+	vec4 u_shadowCascadeFarDepths;
+	mat4 u_dirShadowTransforms[DIR_LIGHT_COUNT * SHADOW_CASCADE_COUNT]; //world space -> light ndc space, per cascade
 };
 
 layout(binding= 4)uniform sampler2D u_dirShadowMaps[DIR_LIGHT_COUNT];
@@ -48,26 +47,24 @@ void main()
 		
 	vec3 reflectedRadiance = vec3(0.0f, 0.0f, 0.0f);
 
+	//perspective projection: w_clip is the view depth
+	float viewDepth = 1.0f / gl_FragCoord.w;
+	int cascade = findShadowCascade(viewDepth, u_shadowCascadeFarDepths);
+
 	for (int i = 0; i < DIR_LIGHT_COUNT; i++)
 	{
 		vec3 dirLightReflectedRadiance = computeDirLightReflectedRadiance(u_directionalLights[i], normal, toEye, diffuseColor, specularColor, specularExponent);
-		vec4 shadowPos = v_dirShadowPosition[i];
-		float depth = shadowPos.z;
-		vec2 shadowMapCoord = shadowPos.xy;
+		vec4 shadowPos = u_dirShadowTransforms[i * SHADOW_CASCADE_COUNT + cascade] * vec4(v_position, 1.0f);
+		shadowPos.xyz *= 0.5f;
+		shadowPos.xyz += 0.5f;
 		vec3 shadowMapParams = u_dirShadowMapSizeAndBias[i].xyz;
-		float shadowFactor = calcShadowFactor(u_dirShadowMaps[i], depth + shadowMapParams.z, shadowMapCoord, shadowMapParams.xy);
-		bvec4 inside = bvec4(shadowMapCoord.x >= 0.0, shadowMapCoord.x <= 1.0, shadowMapCoord.y >= 0.0, shadowMapCoord.y <= 1.0);
-		bool infrustum = all(inside);
-		infrustum = all(bvec2(infrustum, depth <= 1.0));
-		float occlusion = float(infrustum)*(shadowFactor);
+		float occlusion = calcCascadedShadowFactor(u_dirShadowMaps[i], shadowPos.xyz, cascade, shadowMapParams.xy, shadowMapParams.z);
 		reflectedRadiance += occlusion * dirLightReflectedRadiance;
 	}
 	
-	for (int i = 0 ; i < POINT_LIGHT_COUNT;i++)
-	{
-		reflectedRadiance += 
-			computePointLightReflectedRadiance(u_pointLights[i], v_position, normal, toEye, diffuseColor, specularColor, specularExponent);		
-	}
+	//only the point lights of the cluster of the fragment
+	reflectedRadiance += 
+		computeClusteredPointLightsReflectedRadiance(gl_FragCoord.xy, viewDepth, v_position, normal, toEye, diffuseColor, specularColor, specularExponent);
 
 	vec3 ambientTerm = u_ambientLight*diffuseColor;
 	fragmentRadiance = ambientTerm + reflectedRadiance;
@@ -13,9 +13,9 @@ layout(binding=1) uniform sampler2D u_normalMap;
 layout(binding=2) uniform sampler2D u_specMap;
 
 
-layout(location=0) out vec3 normal;
-layout(location=1) out vec3 diffuse;
-layout(location=2) out vec4 specularAndExponent;
+layout(location=0) out vec4 packedNormal;
+layout(location=1) out vec3 diffuse; //sRGB encoded on write, if the target is sRGB
+layout(location=2) out vec4 packedSpecularAndExponent;
 
 void main()
 {
@@ -24,10 +24,13 @@ void main()
 	diffuse = texture(u_diffuseMap,textCoord).rgb;
 	
 	//normal mapping	
-	normal = normalSampleToViewSpace(texture(u_normalMap,textCoord).rgb, normalize(v_normal), v_tangentWithHandedness);
+	vec3 normal = normalSampleToViewSpace(texture(u_normalMap,textCoord).rgb, normalize(v_normal), v_tangentWithHandedness);
+	packedNormal = packGBufferNormal(normalize(normal));
 		
-	specularAndExponent = u_matSpecularAndExponent;
+	vec4 specularAndExponent = u_matSpecularAndExponent;
 
 	//specular mapping
 	specularAndExponent.xyz *= texture(u_specMap, textCoord).rgb;
+
+	packedSpecularAndExponent = packGBufferSpecularAndExponent(specularAndExponent);
 }
\ No newline at end of file
@@ -71,15 +71,6 @@ vec3 computeSpotLightReflectedRadiance(SpotLight l, vec3 position, vec3 normal,
 	return computeReflectedRadiance(lightRadiance, normal, toLight, toEye, diffuseColor, specularColor, specularExponent);
 }
 
-struct PointLight
-{
-	vec4 positionAndRadius;
-	vec3 color;
-	float pad;
-	vec3 attenuation;
-	float pad1;
-};
-
 vec3 computePointLightReflectedRadiance(PointLight l, vec3 position, vec3 normal, vec3 toEye, vec3 diffuseColor, vec3 specularColor, float specularExponent)
 {
 	vec3 toLight = l.positionAndRadius.xyz - position;
@@ -151,3 +142,28 @@ float calcShadowFactor(sampler2D shadowMap, float depth, vec2 shadowMapCoord, ve
 #endif
 }
 
+
+//cascaded shadow maps (see ShadowMapRenderer): cascadeFarDepths holds the view depth where each cascade ends
+int findShadowCascade(float viewDepth, vec4 cascadeFarDepths)
+{
+	int cascade = 0;
+	for (int c = 0; c < SHADOW_CASCADE_COUNT - 1; c++)
+	{
+		cascade += int(viewDepth > cascadeFarDepths[c]);
+	}
+	return cascade;
+}
+
+//shadowPos: in the [0,1] space of the cascade (xy on its map, z the depth); shadowMapSize: the size of the whole map,
+//where the cascades lie side by side. Out of the cascade, nothing casts a shadow
+float calcCascadedShadowFactor(sampler2D shadowMap, vec3 shadowPos, int cascade, vec2 shadowMapSize, float bias)
+{
+	bool inside = all(greaterThanEqual(shadowPos, vec3(0.0f))) && all(lessThanEqual(shadowPos, vec3(1.0f)));
+
+	//the filters read the texels around: never those of the next cascade
+	vec2 cascadeTexelSize = vec2(float(SHADOW_CASCADE_COUNT), 1.0f) / shadowMapSize;
+	vec2 cascadeCoord = clamp(shadowPos.xy, cascadeTexelSize, 1.0f - 2.0f*cascadeTexelSize);
+	vec2 shadowMapCoord = vec2((float(cascade) + cascadeCoord.x) / float(SHADOW_CASCADE_COUNT), cascadeCoord.y);
+
+	return inside ? calcShadowFactor(shadowMap, shadowPos.z + bias, shadowMapCoord, shadowMapSize) : 1.0f;
+}
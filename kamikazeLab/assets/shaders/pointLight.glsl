@@ -0,0 +1,9 @@
+//PointLight of lights.h: std140 and std430 alike (48 bytes)
+struct PointLight
+{
+	vec4 positionAndRadius;
+	vec3 color;
+	float pad;
+	vec3 attenuation;
+	float pad1;
+};
@@ -1,12 +1,12 @@
 in vec4 v_clipPos;
 in vec3 v_viewRay;
+flat in int v_pointLightIndex;
 
 layout (binding=1, std140) uniform SceneFragmentShaderUniformBlock
 {
 	float u_frustumNear;
 	float u_frustumFar;
 	vec2 scenePad1;
-	PointLight u_pointLight;
 };
 
 layout(binding=0) uniform sampler2D u_depthBuffer; //float
@@ -24,9 +24,9 @@ void main()
 	vec2 textCoord = (ndcPos.xy + 1.0f)*0.5f;
 
 	float depth = texture(u_depthBuffer, textCoord).r;
-	vec3 normal = normalize(texture(u_normalBuffer, textCoord).rgb);
+	vec3 normal = unpackGBufferNormal(texture(u_normalBuffer, textCoord));
 	vec3 diffuse = texture(u_diffuseBuffer, textCoord).rgb;
-	vec4 specularAndExponent = texture(u_specularAndExponentBuffer, textCoord);
+	vec4 specularAndExponent = unpackGBufferSpecularAndExponent(texture(u_specularAndExponentBuffer, textCoord));
 
 	vec3 specular = specularAndExponent.xyz;
 	float specularExponent = specularAndExponent.w;
@@ -43,7 +43,7 @@ void main()
 	vec3 toEye = reconstructedToEye;
 			
 	vec3 reflectedRadiance = 
-		computePointLightReflectedRadiance(u_pointLight, position, normal, toEye, diffuse, specular, specularExponent);
+		computePointLightReflectedRadiance(u_pointLights[v_pointLightIndex], position, normal, toEye, diffuse, specular, specularExponent);
 	
 	fragmentRadiance = vec4(reflectedRadiance, 1.0f);
 }
\ No newline at end of file
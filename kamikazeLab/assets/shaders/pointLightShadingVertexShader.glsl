@@ -2,20 +2,23 @@ layout(location = 0) in vec3 a_position;
 
 layout(binding=0, std140) uniform SceneVertexShaderUniformBlock
 {
-	mat4 u_viewWorld;
 	mat4 u_projection;
 };
 
 out vec4 v_clipPos;
 out vec3 v_viewRay;
+flat out int v_pointLightIndex;
 
 void main()
 {
-	vec4 viewPos = u_viewWorld * vec4(a_position, 1.0f);
+	vec4 positionAndRadius = u_pointLights[gl_InstanceID].positionAndRadius;
+
+	vec4 viewPos = vec4(positionAndRadius.xyz + a_position * positionAndRadius.w, 1.0f);
 	vec4 clipPos = u_projection * viewPos;			
 
 	gl_Position = clipPos;
 
 	v_clipPos = clipPos;
 	v_viewRay = viewPos.xyz;
-}
\ No newline at end of file
+	v_pointLightIndex = gl_InstanceID;
+}
@@ -0,0 +1,6 @@
+//the visible point lights, in view space: instance i is the volume of light i.
+//Declared once for both stages of the program, which must agree on the block
+layout (binding=0, std430) readonly buffer PointLightBuffer
+{
+	PointLight u_pointLights[];
+};
@@ -27,3 +27,75 @@ vec3 computeViewSpacePositionFromDepth(float depth, vec3 viewRay)
 	//float t = depth / viewRay.z;
 	//return vec3(viewRay.xy*t, depth);	
 }
+
+
+//the G-buffer layout: packed if COMPACT_GBUFFER is defined (see gbuffer_encoding.h, which mirrors this on the CPU)
+
+vec2 encodeOctahedralNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+
+	//the lower half folds over the diagonals
+	vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	vec2 octahedral = n.z >= 0.0f ? n.xy : (1.0f - abs(n.yx)) * signs;
+
+	return octahedral * 0.5f + 0.5f;
+}
+
+vec3 decodeOctahedralNormal(vec2 encoded)
+{
+	vec2 f = encoded * 2.0f - 1.0f;
+	vec3 n = vec3(f, 1.0f - abs(f.x) - abs(f.y));
+
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	return normalize(n);
+}
+
+float encodeSpecularExponent(float specularExponent)
+{
+	return log2(max(specularExponent, 1.0f)) / log2(GBUFFER_MAX_SPECULAR_EXPONENT);
+}
+
+float decodeSpecularExponent(float encoded)
+{
+	return exp2(encoded * log2(GBUFFER_MAX_SPECULAR_EXPONENT));
+}
+
+vec4 packGBufferNormal(vec3 normal)
+{
+#ifdef COMPACT_GBUFFER
+	return vec4(encodeOctahedralNormal(normal), 0.0f, 0.0f);
+#else
+	return vec4(normal, 0.0f);
+#endif
+}
+
+vec3 unpackGBufferNormal(vec4 normalSample)
+{
+#ifdef COMPACT_GBUFFER
+	return decodeOctahedralNormal(normalSample.xy);
+#else
+	return normalize(normalSample.xyz);
+#endif
+}
+
+vec4 packGBufferSpecularAndExponent(vec4 specularAndExponent)
+{
+#ifdef COMPACT_GBUFFER
+	return vec4(specularAndExponent.xyz, encodeSpecularExponent(specularAndExponent.w));
+#else
+	return specularAndExponent;
+#endif
+}
+
+vec4 unpackGBufferSpecularAndExponent(vec4 specularAndExponentSample)
+{
+#ifdef COMPACT_GBUFFER
+	return vec4(specularAndExponentSample.xyz, decodeSpecularExponent(specularAndExponentSample.w));
+#else
+	return specularAndExponentSample;
+#endif
+}
@@ -7,11 +7,14 @@ layout (binding=1, std140) uniform SceneFragmentShaderUniformBlock
 	float u_frustumNear;
 	float u_frustumFar;
 	vec2 u_randomDirectionTiling;
+	vec2 u_randomDirectionOffset;
+	uint u_firstSampleIndex;
+	float u_padding;
 };
 
 layout (binding=2, std140) uniform ConstantFragmentShaderUniformBlock
 {
-	vec4 u_sampleOffsets[SAMPLES_COUNT];
+	vec4 u_sampleOffsets[KERNEL_SIZE];
 };
 
 
@@ -24,20 +27,21 @@ out float accessibility;
 void main()
 {
 	float depth = texture(u_depthBuffer, v_textCoord).r;
-	vec3 normal = normalize(texture(u_normalBuffer, v_textCoord).rgb);
+	vec3 normal = unpackGBufferNormal(texture(u_normalBuffer, v_textCoord));
 	
 	float viewSpaceDepth = computeViewDepthFromNDCDepth(2.0f*depth - 1.0f, u_frustumNear, u_frustumFar);
 	vec3 viewPosition = computeViewSpacePositionFromDepth(viewSpaceDepth, v_viewRay);          
 	                                           
     //get random offset
-    vec3 randomOffset = 2.0f * texture(u_randomDirections, v_textCoord * u_randomDirectionTiling).xyz - 1.0f;
+    vec3 randomOffset = 2.0f * texture(u_randomDirections, v_textCoord * u_randomDirectionTiling + u_randomDirectionOffset).xyz - 1.0f;
 		
     float occlusionSum = 0.0f;
                                                                                 
     for(int i = 0; i < SAMPLES_COUNT; i++)
 	{
         //get random direction, flip it if behind the plane defined by the surface point and the normal
-        vec3 dir = reflect(u_sampleOffsets[i].xyz, randomOffset);
+        //(SAMPLES_COUNT of the KERNEL_SIZE directions: a different run of them every frame, if accumulated over the frames)
+        vec3 dir = reflect(u_sampleOffsets[(u_firstSampleIndex + uint(i)) % uint(KERNEL_SIZE)].xyz, randomOffset);
         float flip = sign(dot(dir, normal));
         //get random point on the hemisphere
         vec3 q = viewPosition + flip*dir*OCCLUSION_RADIUS;
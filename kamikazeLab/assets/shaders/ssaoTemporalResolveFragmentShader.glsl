@@ -0,0 +1,41 @@
+in vec3 v_viewRay;
+in vec2 v_textCoord;
+
+layout (binding=1, std140) uniform SceneFragmentShaderUniformBlock
+{
+	mat4 u_reprojection;
+	float u_frustumNear;
+	float u_frustumFar;
+	float u_historyWeight;
+	float u_depthTolerance;
+};
+
+layout(binding = 0) uniform sampler2D u_depthBuffer;
+layout(binding = 1) uniform sampler2D u_occlusionMap;
+layout(binding = 2) uniform sampler2D u_historyMap;
+
+out vec2 resolvedFragment; //the accumulated occlusion, and the view depth (along -z) it belongs to
+
+void main()
+{
+	float depth = texture(u_depthBuffer, v_textCoord).r;
+	float viewSpaceDepth = computeViewDepthFromNDCDepth(2.0f*depth - 1.0f, u_frustumNear, u_frustumFar);
+	vec3 viewPosition = computeViewSpacePositionFromDepth(viewSpaceDepth, v_viewRay);
+
+	float occlusion = texture(u_occlusionMap, v_textCoord).r;
+
+	//where this point was on screen in the previous frame, and how far from the eye
+	vec4 previousClipPosition = u_reprojection * vec4(viewPosition, 1.0f);
+	vec2 previousTextCoord = (previousClipPosition.xy / previousClipPosition.w + 1.0f) * 0.5f;
+	float previousViewDepth = previousClipPosition.w;
+
+	vec2 history = texture(u_historyMap, previousTextCoord).rg;
+
+	bool onScreen = all(greaterThanEqual(previousTextCoord, vec2(0.0f))) && all(lessThanEqual(previousTextCoord, vec2(1.0f)));
+	//a history cleared (or written for another surface) has another depth: it is dropped
+	bool sameSurface = abs(history.g - previousViewDepth) <= u_depthTolerance * previousViewDepth;
+
+	float historyWeight = onScreen && sameSurface ? u_historyWeight : 0.0f;
+
+	resolvedFragment = vec2(mix(occlusion, history.r, historyWeight), -viewPosition.z);
+}
@@ -0,0 +1,74 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+/* BroadphaseGrid:
+ *  a uniform grid laid over the (square, flat) arena, which finds out
+ *  which ships and bullets are close enough to be worth a narrowphase test.
+ *
+ *  It is rebuilt from scratch at every physics step (with two counting sorts,
+ *  no allocations once warmed up):
+ *   - a bullet goes in the one cell of its center: the bullets are then packed,
+ *     cell after cell, in sorted arrays (each cell is a contiguous run of them)
+ *   - a ship goes in all the cells touched by the box of its whole step, enlarged
+ *     by the largest bullet radius and the longest bullet step, so no bullet
+ *     hitting it at any time during the step can be missed
+ *
+ *  Anything out of the arena is clamped into the border cells: slower, still correct.
+ */
+
+#include <vector>
+#include <glm/vec3.hpp>
+#include "phys_object.h"
+
+using namespace glm;
+
+struct BulletPool;
+
+struct BroadphaseGrid{
+
+	// the grid covers [-arenaRadius, +arenaRadius]^2 with square cells (of about cellSize)
+	void init( float arenaRadius, float cellSize );
+
+	// ship i went from shipFrom[i] to shipTo[i] during the last step
+	void build( const std::vector< vec3 >& shipFrom,
+				const std::vector< vec3 >& shipTo,
+				const std::vector< float >& shipRadius,
+				const BulletPool& bullets, float dt );
+
+	// the cells touched by ship i: [x0,x1] x [y0,y1]
+	struct CellRect{ int x0, y0, x1, y1; };
+	const CellRect& cellsOfShip( int i ) const { return shipCells[i]; }
+
+	int cellIndex( int x, int y ) const { return y*side + x; }
+
+	// the bullets in a cell are sorted[ bulletStart[c] ... bulletStart[c+1]-1 ]
+	std::vector< int > bulletStart;
+	std::vector< int > sortedBullet; // index in the BulletPool
+	std::vector< float > sortedX, sortedY, sortedZ; // where they were at the start of the step
+	std::vector< float > sortedMoveX, sortedMoveY, sortedMoveZ; // how far they went during the step
+	std::vector< float > sortedRadius;
+	SweptSpheres sortedSpheres( int k ) const; // from the k-th on: ready for collidesBatch
+
+	// pairs of ships (i<j) sharing some cell: each pair is reported once
+	struct ShipPair{ int a, b; };
+	std::vector< ShipPair > shipPairs;
+
+private:
+	int cellOf( float coord ) const; // same for x and y: the grid is square
+	void sortBullets( const BulletPool& bullets, float dt );
+	void findShipPairs();
+
+	int side = 0; // number of cells per side
+	float cellSize = 1;
+	float minCoord = 0;
+
+	std::vector< CellRect > shipCells;
+
+	std::vector< int > shipStart; // same as bullets: ships in cell c are in shipsInCell[ shipStart[c]... ]
+	std::vector< int > shipsInCell;
+
+	std::vector< int > bulletCell; // scratch: cell of each bullet in the pool
+	std::vector< int > fill;       // scratch: for the counting sorts
+};
+
+#endif // BROADPHASE_H
@@ -0,0 +1,49 @@
+#ifndef BULLET_POOL_H
+#define BULLET_POOL_H
+
+/* BulletPool:
+ *  all the bullets flying in the arena (of all ships), as a structure of arrays:
+ *  just what physics needs (position, velocity, radius, time to live, owner).
+ *
+ *  Alive bullets are kept packed at the front of the arrays, in [0, count):
+ *   - spawn writes at the end of the alive range, O(1)
+ *   - despawn moves the last alive bullet in the freed slot, O(1)
+ *  so every loop over the bullets only touches the alive ones.
+ *  (note: the index of a bullet changes when another one despawns)
+ */
+
+#include <vector>
+#include <glm/vec3.hpp>
+
+using namespace glm;
+
+/* the kinematic state of a bullet: all it takes to predict its flight.
+ * Cheap to make: the AI makes one every time it thinks */
+struct BulletState{
+	vec3 pos;
+	vec3 vel;
+	float radius;
+	float timeToLive;
+};
+
+struct BulletPool{
+
+	void init( int capacity );
+	int capacity() const { return (int)pos.size(); }
+
+	bool spawn( const BulletState& b, int owner ); // false if the pool is full
+	void despawn( int i );
+	void despawnAllOf( int owner );
+
+	void doPhysStep(); // moves them, and despawns the expired ones
+
+	int count = 0; // how many are alive
+
+	std::vector< vec3 > pos;
+	std::vector< vec3 > vel;
+	std::vector< float > radius;
+	std::vector< float > timeToLive;
+	std::vector< int > owner; // index of the ship which fired it
+};
+
+#endif // BULLET_POOL_H
@@ -0,0 +1,50 @@
+#ifndef _CLUSTERED_LIGHTING_H_
+#define _CLUSTERED_LIGHTING_H_
+
+/* ClusteredLighting:
+ * the point lights of a frame, binned into the clusters of the camera (see light_clusters.h),
+ * and uploaded for the shaders which include clusteredLighting.glsl:
+ *  - uniform block 4: the grid (how a fragment finds its cluster)
+ *  - storage blocks 0, 1, 2: the lights, the range of each cluster, the light indices
+ */
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "light_clusters.h"
+#include "lights.h"
+#include "uniform_ring.h"
+
+struct Camera;
+
+struct ClusteredLighting
+{
+	struct UniformBlock
+	{
+		glm::uvec4 u_clusterGridSize; // tiles x, tiles y, slices
+		glm::vec4 u_clusterTileSizeAndDepthMapping; // tile size in pixels; slice = log(view depth) * z + w
+	};
+
+	// where the shaders light: the forward path in world space, the deferred one in view space
+	enum LightSpace
+	{
+		WORLD_SPACE,
+		VIEW_SPACE
+	};
+
+	// bins the lights for the camera, and uploads them (in the given space) for this frame
+	void update(const Camera& camera, const std::vector<PointLight>& pointLights, LightSpace lightSpace);
+	void bind()const;
+
+	LightClusters clusters;
+
+	UniformRange uniformRange;
+	UniformRange lightsRange;
+	UniformRange clusterRangesRange;
+	UniformRange lightIndicesRange;
+
+private:
+	std::vector<glm::vec4> viewSpaceSpheres;
+	std::vector<PointLight> viewSpaceLights;
+};
+
+#endif
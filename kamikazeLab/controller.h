@@ -33,6 +33,16 @@ struct ShipController{
 		}
 	}
 
+	// the status in one word: e.g. to hand it to another thread
+	unsigned int packStatus() const {
+		unsigned int res = 0;
+		for (int i=0; i<N_STATUS; i++) if (status[i]) res |= 1u << i;
+		return res;
+	}
+	void unpackStatus( unsigned int packed ){
+		for (int i=0; i<N_STATUS; i++) status[i] = (packed >> i & 1) != 0;
+	}
+
 	void useWASD();
 	void useArrows();
 };
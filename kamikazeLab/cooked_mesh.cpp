@@ -0,0 +1,88 @@
+/* cooked_mesh.cpp
+ * writing and mapping .kmesh files
+ */
+
+#include <cstring>
+#include <fstream>
+#include "cooked_mesh.h"
+
+static const char KMESH_MAGIC[4] = { 'K', 'M', 'S', 'H' };
+
+std::string cookedMeshFilename(const std::string& sourceFilename)
+{
+	return sourceFilename + ".kmesh";
+}
+
+bool cookMesh(const CpuMesh& mesh, const std::string& sourceFilename, const FileStamp& sourceStamp)
+{
+	KMeshHeader header{};
+	std::memcpy(header.magic, KMESH_MAGIC, sizeof(KMESH_MAGIC));
+	header.version = KMESH_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.triSize = sizeof(Tri);
+	header.sourceSize = sourceStamp.size;
+	header.sourceModificationTime = sourceStamp.modificationTime;
+	header.vertexCount = static_cast<uint32_t>(mesh.verts.size());
+	header.triCount = static_cast<uint32_t>(mesh.tris.size());
+	header.boundingSphere = mesh.boundingSphere();
+
+	std::ofstream file(cookedMeshFilename(sourceFilename), std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	// (a file cut short by a failure here is refused by open: its size does not add up)
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(mesh.verts.data()), sizeof(Vertex) * mesh.verts.size());
+	file.write(reinterpret_cast<const char*>(mesh.tris.data()), sizeof(Tri) * mesh.tris.size());
+	return file.good();
+}
+
+bool CookedMesh::open(const std::string& sourceFilename)
+{
+	close();
+
+	FileStamp sourceStamp;
+	if (!readFileStamp(sourceFilename, sourceStamp)) return false;
+	if (!file.open(cookedMeshFilename(sourceFilename)) || file.size() < sizeof(KMeshHeader)) {
+		close();
+		return false;
+	}
+
+	const KMeshHeader* h = reinterpret_cast<const KMeshHeader*>(file.data());
+	const bool upToDate =
+		std::memcmp(h->magic, KMESH_MAGIC, sizeof(KMESH_MAGIC)) == 0 &&
+		h->version == KMESH_VERSION &&
+		h->vertexSize == sizeof(Vertex) &&
+		h->triSize == sizeof(Tri) &&
+		h->sourceSize == sourceStamp.size &&
+		h->sourceModificationTime == sourceStamp.modificationTime &&
+		file.size() == sizeof(KMeshHeader) + sizeof(Vertex) * uint64_t(h->vertexCount) + sizeof(Tri) * uint64_t(h->triCount);
+
+	if (!upToDate) {
+		close();
+		return false;
+	}
+
+	header = h;
+	return true;
+}
+
+void CookedMesh::close()
+{
+	file.close();
+	header = nullptr;
+}
+
+CpuMeshView CookedMesh::view()const
+{
+	CpuMeshView v;
+	if (header == nullptr) return v;
+
+	// the mapping starts on a page: the vertices (after 64 bytes) and the triangles are aligned
+	const char* data = file.data() + sizeof(KMeshHeader);
+	v.verts = reinterpret_cast<const Vertex*>(data);
+	v.vertexCount = header->vertexCount;
+	v.tris = reinterpret_cast<const Tri*>(data + sizeof(Vertex) * header->vertexCount);
+	v.triCount = header->triCount;
+	v.boundingSphere = header->boundingSphere;
+	return v;
+}
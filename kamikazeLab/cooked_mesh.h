@@ -0,0 +1,56 @@
+#ifndef _COOKED_MESH_H_
+#define _COOKED_MESH_H_
+
+/* CookedMesh:
+ * a mesh as CpuMesh::import leaves it (welded vertices with their tangents, triangles, bounding sphere),
+ * in a binary file next to its source: "<source>.kmesh". Loading it is mapping it: the view points
+ * into the mapping, and goes to the GPU as it is (no parsing, no copy on the CPU).
+ *
+ * A .kmesh is only used for the source it was cooked from, by a build which agrees on the layout:
+ * its header holds the stamp of the source (see FileStamp), the version of the format
+ * and the sizes of Vertex and Tri. If any of them differs, the source is imported (and cooked) again.
+ */
+
+#include <cstdint>
+#include <string>
+#include "mapped_file.h"
+#include "mesh.h"
+
+static constexpr uint32_t KMESH_VERSION = 1;
+
+struct KMeshHeader
+{
+	char magic[4]; // "KMSH"
+	uint32_t version;
+	uint32_t vertexSize; // sizeof(Vertex)
+	uint32_t triSize; // sizeof(Tri)
+	uint64_t sourceSize;
+	int64_t sourceModificationTime;
+	uint32_t vertexCount;
+	uint32_t triCount;
+	uint32_t padding[2];
+	glm::vec4 boundingSphere;
+	// then the vertices, then the triangles
+};
+static_assert(sizeof(KMeshHeader) == 64, "KMeshHeader: the layout of the file");
+
+std::string cookedMeshFilename(const std::string& sourceFilename);
+
+// sourceStamp: read before the import, so that a source changed meanwhile is not taken for cooked.
+// False if the file could not be written (then the source is just imported again, the next time)
+bool cookMesh(const CpuMesh& mesh, const std::string& sourceFilename, const FileStamp& sourceStamp);
+
+struct CookedMesh
+{
+	// maps the .kmesh of the source: false if there is none, or it is out of date
+	bool open(const std::string& sourceFilename);
+	void close();
+
+	CpuMeshView view()const; // valid while open
+
+private:
+	MappedFile file;
+	const KMeshHeader* header = nullptr;
+};
+
+#endif
@@ -6,19 +6,24 @@
  * these are ad-hoc structures used by this specific game:
  *  - Stats, (of a ship)
  *  - Ship,
- *  - Bullet,
- *  - Scene (all data of a game, also the arena)
+ *  - Scene (all data of a game, also the arena, and the bullets: see bullet_pool.h)
  *
  * (in class, this file was called "scene.h")
  *
  * Often, they inhert from general "PhysObjects" and add fields and/or
  * add / redefine funcionalies. They use methods of their base class.
  *
+ * Nothing here knows about rendering (see scene_rendering.h for that):
+ * the whole simulation can run without a GPU (e.g. see server_main.cpp).
+ *
  */
 #include <vector>
 #include "phys_object.h"
 #include "controller.h"
-#include <memory>
+#include "bullet_pool.h"
+#include "broadphase.h"
+
+struct SceneSnapshot;
 
 struct Stats{
 	float accRate;
@@ -28,21 +33,8 @@ struct Stats{
 	float fireSpeed;
 };
 
-struct Bullet : public PhysObject {
-
-	Bullet();
-
-	float timeToLive;
-	bool alive;
-	void doPhysStep();
-	void reset(){ alive = false; }
-};
-
-
 struct Ship: public PhysObject{
 
-	Ship();
-
 	Stats stats;
 
 	ShipController controller;
@@ -50,12 +42,11 @@ struct Ship: public PhysObject{
 	void doPhysStep();
 
 	void setMaxVelAndAcc( float maxVel, float acc );
-	std::vector< Bullet > bullets;
+	int id; // its index in the scene, the owner of its bullets
 	float timeBeforeFiringAgain;
 	void spawnNewBullet();
 
-	Bullet& findUnusedBullet();
-	void fillBullet(Bullet& b) const;
+	void fillBullet(BulletState& b) const; // the bullet it would fire now
 
 	void reset();
 	void die();
@@ -64,69 +55,34 @@ struct Ship: public PhysObject{
 	void setStatsAsFighter(); //
 	void setStatsAsTank();
 	bool alive;
-	double timeDead;	
-};
-
-struct Floor : PhysObject
-{
-	Floor();
-};
+	double timeDead;
 
-struct Camera
-{
-	mat4 viewTransform;
-	mat4 projectionTransform;
-	mat4 projectionViewTransform;
-	mat4 invViewTransform;
-	mat4 invProjectionTransform;
-	Transform transform;
-	float nearPlane;
-	float farPlane;
-	float fovY;
-	float aspectRatio;
-
-	void computeViewFromTransform();
-	void computeInvView();
-	void computeInvProj();
-	void computeProjectionView();
-	void setProjectionParams(float fovY, float aspectRatio, float near, float far);
+	float rollAngle; // for the looks only: the roll the ship does when turning
 };
 
-struct SceneLighting;
-struct DeferredRenderer;
-struct ForwardRenderer;
-struct ShadowMapRenderer;
-struct SkyBoxRenderer;
-
 struct Scene{
 
 	float arenaRadius;
 	std::vector< Ship > ships;
+	BulletPool bullets;
 
 	vec3 randomPosInArena() const;
-	void initAsNewGame();
-	void render();
+	void initAsNewGame( int nShips = 2 );
 
 	void doPhysStep();
+	void setStepRate( float stepsPerSecond ); // how much time a step simulates (default: 30 per second)
+	float stepDuration() const; // in secs
+
+	void takeSnapshot( SceneSnapshot& s ) const; // what the renderer needs (see scene_snapshot.h)
 
 	bool isInside( vec3 p ) const;
 	vec3 pacmanWarp( vec3 p) const;
-		
-	Camera camera;
-
-	std::unique_ptr<SceneLighting> lighting;
-	std::unique_ptr<Floor> floor;
-	
-	std::unique_ptr<DeferredRenderer> deferredRenderer;
-	std::unique_ptr<ForwardRenderer> forwardRenderer;
-	std::unique_ptr<ShadowMapRenderer> shadowMapRenderer;
-	std::unique_ptr<SkyBoxRenderer> skyBoxRenderer;
 
 private:
 	void checkAllCollisions();
-	glm::mat4 cameraOnTwoObjects(const PhysObject& a, const PhysObject& b);
-	void findVisiblePhysObjects();
-	std::vector<PhysObject*> physObjects;
+	BroadphaseGrid grid;
+	std::vector< vec3 > shipFrom, shipTo; // what the grid is built from
+	std::vector< float > shipRadius;
 };
 
 extern Scene scene; // a poor man's singleton (there is one, and everyone can use it)
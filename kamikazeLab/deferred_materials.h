@@ -1,22 +1,20 @@
 #ifndef _DEFERRED_MATERIAL_H_
 #define  _DEFERRED_MATERIAL_H_
 
+#include <vector>
 #include <glm/glm.hpp>
 #include "shader.h"
 #include "texture.h"
 #include "lights.h"
 #include "graphics_resource.h"
+#include "uniform_ring.h"
 
 struct DeferredMaterial
 {
 	struct SceneVertexShaderUniformBlock
 	{
 		glm::mat4 u_projection;
-	};
-
-	struct ObjectVertexShaderUniformBlock
-	{
-		glm::mat4 u_viewWorld;
+		glm::mat4 u_view;
 	};
 
 	struct ObjectFragmentShaderUniformBlock
@@ -30,26 +28,26 @@ struct DeferredMaterial
 	static void bind();
 	static GpuProgram gpuProgram;
 
-	void setWorldTransform(const glm::mat4& world);
 	void setSpecularColor(const glm::vec3& specularColor);
 	void setSpecularExponent(float specularExponent);
 	void setTextCoordScale(const glm::vec2& textCoordScale);
 	void setTextCoordTranslate(const glm::vec2& textCoordTranslate);
 
-	void bindInstance()const;
+	//the textures are bound by the RenderQueue (units 0, 1, 2: diffuse, normal, specular), only when they change
+	void bindObjectUniforms()const;
+	//same textures and parameters: the objects of both can be drawn with one instanced call
+	bool looksLike(const DeferredMaterial& other)const;
 
 	void updateUniforms();
 	static void updateSceneData();
 
 	static SceneVertexShaderUniformBlock sceneVertexShaderUniformBlock;
 
-	ObjectVertexShaderUniformBlock objectVertexShaderUniformBlock;
 	ObjectFragmentShaderUniformBlock objectFragmentShaderUniformBlock;
 
-	static unsigned int sceneVertexShaderUniformBufferId;
+	static UniformRange sceneVertexShaderUniformRange;
 
-	unsigned int objectVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
-	unsigned int objectFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+	UniformRange objectFragmentShaderUniformRange;
 
 	GpuTexture diffuseMap;
 	GpuTexture normalMap;
@@ -66,13 +64,14 @@ struct DirLightDeferredShadingMaterial
 	struct SceneFragmentShaderUniformBlock
 	{
 		glm::vec3 u_ambientLight;
-		float scenePad; 
+		unsigned int u_clusteredPointLights; //0 when the point lights are drawn as volumes
 		float u_frustumNear;
 		float u_frustumFar;
 		glm::vec2 scenePad1;
 		DirectionalLight u_directionalLights[DIR_LIGHT_COUNT];
 		glm::vec4 u_dirShadowMapSizeAndBias[DIR_LIGHT_COUNT];
-		glm::mat4 u_dirShadowTransforms[DIR_LIGHT_COUNT];
+		glm::vec4 u_shadowCascadeFarDepths;
+		glm::mat4 u_dirShadowTransforms[DIR_LIGHT_COUNT * SHADOW_CASCADE_COUNT];
 	};
 	
 	DirLightDeferredShadingMaterial();
@@ -85,8 +84,8 @@ struct DirLightDeferredShadingMaterial
 	static SceneVertexShaderUniformBlock sceneVertexShaderUniformBlock;
 	static SceneFragmentShaderUniformBlock sceneFragmentShaderUniformBlock;
 
-	static unsigned int sceneVertexShaderUniformBufferId;
-	static unsigned int sceneFragmentShaderUniformBufferId;
+	static UniformRange sceneVertexShaderUniformRange;
+	static UniformRange sceneFragmentShaderUniformRange;
 
 	static GpuTexture dirShadowMaps[DIR_LIGHT_COUNT];
 
@@ -98,11 +97,14 @@ struct DirLightDeferredShadingMaterial
 	static GpuTexture specularAndExponentBuffer;
 };
 
+/* the point lights drawn as volumes (see DeferredPointLights in render_path.h):
+ * a sphere per light, all of them with one instanced draw.
+ * Instance i is the light i of a storage block holding all the visible lights (in view space)
+ */
 struct PointLightDeferredShadingMaterial
 {
 	struct SceneVertexShaderUniformBlock
 	{
-		glm::mat4 u_viewWorld;
 		glm::mat4 u_projection;
 	};
 
@@ -111,7 +113,6 @@ struct PointLightDeferredShadingMaterial
 		float u_frustumNear;
 		float u_frustumFar;
 		glm::vec2 scenePad1;
-		PointLight u_pointLight;
 	};
 
 	PointLightDeferredShadingMaterial();
@@ -119,19 +120,28 @@ struct PointLightDeferredShadingMaterial
 	static void bind();
 	static GpuProgram gpuProgram;
 
-	static void updateLightData(unsigned int pointLightIndex);
+	//culls the point lights against the view frustum and uploads the others:
+	//returns how many are left (the instances to draw)
+	static unsigned int updateLightData();
 	static void updateSceneData();
 
 	static SceneVertexShaderUniformBlock sceneVertexShaderUniformBlock;
 	static SceneFragmentShaderUniformBlock sceneFragmentShaderUniformBlock;
 
-	static unsigned int sceneVertexShaderUniformBufferId;
-	static unsigned int sceneFragmentShaderUniformBufferId;
+	static UniformRange sceneVertexShaderUniformRange;
+	static UniformRange sceneFragmentShaderUniformRange;
+	static UniformRange pointLightsRange; // PointLight[], storage block 0
 
 	static GpuTexture depthBuffer;
 	static GpuTexture normalBuffer;
 	static GpuTexture diffuseBuffer;
 	static GpuTexture specularAndExponentBuffer;
+
+private:
+	// the bounding spheres of the lights, in world space (as cullSpheres wants them)
+	static std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	static std::vector<unsigned char> visible;
+	static std::vector<PointLight> visibleLights;
 };
 
 #endif
\ No newline at end of file
@@ -1,11 +1,13 @@
 #ifndef _DEFERRED_RENDERER_H_
 #define _DEFERRED_RENDERER_H_
 
+#include <memory>
 #include "gbuffer.h"
 #include "mesh.h"
 #include "deferred_materials.h"
+#include "render_path.h"
 
-class PhysObject;
+struct RenderQueue;
 struct SSAORenderer;
 
 struct DeferredRenderer
@@ -15,17 +17,16 @@ struct DeferredRenderer
 
 	GBuffer gbuffer;
 		
-	void render(PhysObject** physObjects, unsigned int count)const;
+	void render(RenderQueue& renderQueue)const;
 
 	std::unique_ptr<SSAORenderer> ssaoRenderer;
 
 private:
-	void renderPhysObject(PhysObject& physObject)const;
-
 	GpuMesh fullScreenQuad;
-	GpuMesh sphere;
 
 	DirLightDeferredShadingMaterial dirLightDeferredMaterial;
+
+	GpuMesh sphere;
 	PointLightDeferredShadingMaterial pointLightDeferredMaterial;	
 };
 #endif
\ No newline at end of file
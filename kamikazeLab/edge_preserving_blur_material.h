@@ -1,6 +1,8 @@
 #ifndef _EDGE_PRESERVING_BLUR_MATERIAL_H_
 #define _EDGE_PRESERVING_BLUR_MATERIAL_H_
 
+#include "uniform_ring.h"
+
 #define BLUR_KERNEL_RADIUS 5
 
 struct EdgePreservingBlurMaterial
@@ -31,7 +33,7 @@ struct EdgePreservingBlurMaterial
 	static SceneFragmentShaderUniformBlock sceneFragmentShaderUniformBlock;
 	static ConstantFragmentShaderUniformBlock constantFragmentShaderUniformBlock;
 
-	static unsigned int sceneFragmentShaderUniformBufferId;
+	static UniformRange sceneFragmentShaderUniformRange;
 	static unsigned int constantFragmentShaderUniformBufferId;
 
 	static GpuTexture depthBuffer;
@@ -6,18 +6,13 @@
 #include "texture.h"
 #include "lights.h"
 #include "graphics_resource.h"
+#include "uniform_ring.h"
 
 struct ForwardMaterial
 {
-	struct ObjectVertexShaderUniformBlock
-	{
-		glm::mat4 u_world;
-	};
-
 	struct SceneVertexShaderUniformBlock
 	{
 		glm::mat4 u_projView;
-		glm::mat4 u_dirShadowTransforms[DIR_LIGHT_COUNT];
 	};
 	
 	struct ObjectFragmentShaderUniformBlock
@@ -33,8 +28,9 @@ struct ForwardMaterial
 		glm::vec3 u_eyePosition;
 		float scenePad1;
 		DirectionalLight u_directionalLights[DIR_LIGHT_COUNT];
-		PointLight u_pointLights[POINT_LIGHT_COUNT];
 		glm::vec4 u_dirShadowMapSizeAndBias[DIR_LIGHT_COUNT];
+		glm::vec4 u_shadowCascadeFarDepths;
+		glm::mat4 u_dirShadowTransforms[DIR_LIGHT_COUNT * SHADOW_CASCADE_COUNT];
 	};
 
 	ForwardMaterial();
@@ -42,13 +38,15 @@ struct ForwardMaterial
 	static void bind();
 	static GpuProgram gpuProgram;
 	
-	void setWorldTransform(const glm::mat4& world);
 	void setSpecularColor(const glm::vec3& specularColor);
 	void setSpecularExponent(float specularExponent);
 	void setTextCoordScale(const glm::vec2& textCoordScale);
 	void setTextCoordTranslate(const glm::vec2& textCoordTranslate);
 	
-	void bindInstance()const;
+	//the textures are bound by the RenderQueue (units 0, 1, 2: diffuse, normal, specular), only when they change
+	void bindObjectUniforms()const;
+	//same textures and parameters: the objects of both can be drawn with one instanced call
+	bool looksLike(const ForwardMaterial& other)const;
 
 	void updateUniforms();
 	static void updateSceneData();
@@ -56,14 +54,12 @@ struct ForwardMaterial
 	static SceneVertexShaderUniformBlock sceneVertexShaderUniformBlock;		
 	static SceneFragmentShaderUniformBlock sceneFragmentShaderUniformBlock;
 
-	ObjectVertexShaderUniformBlock objectVertexShaderUniformBlock;
 	ObjectFragmentShaderUniformBlock objectFragmentShaderUniformBlock;
 
-	static unsigned int sceneVertexShaderUniformBufferId;
-	static unsigned int sceneFragmentShaderUniformBufferId;
+	static UniformRange sceneVertexShaderUniformRange;
+	static UniformRange sceneFragmentShaderUniformRange;
 
-	unsigned int objectVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
-	unsigned int objectFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+	UniformRange objectFragmentShaderUniformRange;
 
 	GpuTexture diffuseMap;
 	GpuTexture normalMap;
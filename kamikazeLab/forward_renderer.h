@@ -1,13 +1,11 @@
 #ifndef _FORWARD_RENDERER_H_
 #define _FORWARD_RENDERER_H_
 
-class PhysObject;
+struct RenderQueue;
 
 struct ForwardRenderer
 {
-	void render(PhysObject** physObjects, unsigned int count)const;
-private:
-	void renderPhysObject(PhysObject& physObject)const;
+	void render(RenderQueue& renderQueue)const;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,92 @@
+/* frustum.cpp
+ * frustum planes, and the culling of bounding spheres against them
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+#include "frustum.h"
+
+Frustum Frustum::fromProjectionView(const glm::mat4& projectionView)
+{
+	// a point p is inside the clip volume if -w <= x,y,z <= w, with (x,y,z,w) = M p:
+	// each of the six inequalities is a plane, made of two rows of M (Gribb & Hartmann)
+	const glm::mat4 rows = glm::transpose(projectionView);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0]; // left
+	frustum.planes[1] = rows[3] - rows[0]; // right
+	frustum.planes[2] = rows[3] + rows[1]; // bottom
+	frustum.planes[3] = rows[3] - rows[1]; // top
+	frustum.planes[4] = rows[3] + rows[2]; // near
+	frustum.planes[5] = rows[3] - rows[2]; // far
+
+	// normalized, so that the distance of a center from a plane can be compared with a radius
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+static bool sphereTouches(const Frustum& frustum, float x, float y, float z, float radius)
+{
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void cullSpheres(const Frustum& frustum,
+				 const float* x, const float* y, const float* z, const float* radius,
+				 unsigned int count, unsigned char* visible)
+{
+	unsigned int i = 0;
+
+#ifdef FRUSTUM_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 cx = _mm_loadu_ps(x + i);
+		const __m128 cy = _mm_loadu_ps(y + i);
+		const __m128 cz = _mm_loadu_ps(z + i);
+		const __m128 minusRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+		// all ones where the sphere is not (completely) behind any plane so far
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			const __m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, minusRadius));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		visible[i + 0] = (mask >> 0) & 1;
+		visible[i + 1] = (mask >> 1) & 1;
+		visible[i + 2] = (mask >> 2) & 1;
+		visible[i + 3] = (mask >> 3) & 1;
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		visible[i] = sphereTouches(frustum, x[i], y[i], z[i], radius[i]) ? 1 : 0;
+	}
+}
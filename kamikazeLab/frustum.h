@@ -0,0 +1,25 @@
+#ifndef _FRUSTUM_H_
+#define _FRUSTUM_H_
+
+/* Frustum:
+ * the 6 planes of what a projection * view transform sees (a perspective frustum,
+ * or the box of an orthographic projection), to cull bounding spheres against.
+ */
+
+#include <glm/glm.hpp>
+
+struct Frustum
+{
+	// xyz: normal, pointing inside; w: offset. p is inside the plane if dot(xyz, p) + w >= 0
+	glm::vec4 planes[6];
+
+	static Frustum fromProjectionView(const glm::mat4& projectionView);
+};
+
+// visible[i] = 1 if the sphere i (center x,y,z[i], radius[i]) touches the frustum, 0 otherwise
+// (four spheres at a time, with SSE)
+void cullSpheres(const Frustum& frustum,
+				 const float* x, const float* y, const float* z, const float* radius,
+				 unsigned int count, unsigned char* visible);
+
+#endif
@@ -4,13 +4,8 @@
  */
 
 #include "custom_classes.h"
+#include "scene_snapshot.h"
 #include <glm/gtx/transform.hpp>
-#include "window.h"
-#include "deferred_renderer.h"
-#include "forward_renderer.h"
-#include "shadow_map_renderer.h"
-#include "skybox_renderer.h"
-#include "render_path.h"
 
 Scene scene;
 
@@ -50,11 +45,13 @@ vec3 randomUnitVec(){
 void Ship::reset(){
 	timeBeforeFiringAgain = 0.0; // ready!
 	PhysObject::reset();
-	for (Bullet &b : bullets) b.reset();
+	scene.bullets.despawnAllOf( id );
 
 	t.pos = scene.randomPosInArena();
 	angDrag =0.2f/(1.0f/30);
 	alive = true;
+	rollAngle = 0;
+	prevT = t; // it did not fly here: nothing to interpolate
 }
 
 void Ship::respawn(){
@@ -75,29 +72,19 @@ vec3 Scene::randomPosInArena() const{
 }
 
 
-Bullet& Ship::findUnusedBullet(){
-	for (Bullet &b : bullets) {
-		if (!b.alive) return b;
-	}
-	return bullets[0]; // this should never happen
-}
-
 void Ship::spawnNewBullet(){
-	Bullet &b = findUnusedBullet();
+	BulletState b;
 	fillBullet( b );
+	scene.bullets.spawn( b, id ); // if the pool is full, the shot is lost
 }
 
-void Ship::fillBullet(Bullet &b) const {
-	b.alive = true;
-	b.t.pos = t.pos; // TODO: put where the gun hole is (in Space shape)
-	b.t.ori = t.ori;
+void Ship::fillBullet(BulletState &b) const {
+	b.pos = t.pos; // TODO: put where the gun hole is (in Space shape)
 
 	b.timeToLive = stats.fireRange / stats.fireSpeed;
 	b.vel = t.forward() * stats.fireSpeed + 0.3f*vel;
-	b.angVel = quat(1,0,0,0);
 
-	b.mass = 0.1f;
-	b.coll.radius = 0.03f;
+	b.radius = 0.03f;
 	// TODO: maybe randomize a bit pos and vel	
 
 }
@@ -116,86 +103,43 @@ vec3 Scene::pacmanWarp( vec3 p) const{
 	return res;
 }
 
-void Scene::initAsNewGame(){
+void Scene::takeSnapshot( SceneSnapshot& s ) const{
+	s.stepTime = std::chrono::steady_clock::now();
+	s.stepDuration = stepDuration();
+
+	s.ships.resize( ships.size() );
+	for (size_t i = 0; i < ships.size(); i++) {
+		s.ships[i].prevT = ships[i].prevT;
+		s.ships[i].t = ships[i].t;
+		s.ships[i].rollAngle = ships[i].rollAngle;
+		s.ships[i].alive = ships[i].alive;
+	}
+
+	s.bulletPos.assign( bullets.pos.begin(), bullets.pos.begin() + bullets.count );
+	s.bulletVel.assign( bullets.vel.begin(), bullets.vel.begin() + bullets.count );
+}
+
+void Scene::initAsNewGame( int nShips ){
 
 	arenaRadius = 60;
+	grid.init( arenaRadius, 4.0f ); // a few ships per cell, at most
 
-	physObjects.clear();
-	physObjects.reserve(2 + 2 * 100 + 1);
+	ships.resize( nShips );
 
-	ships.resize(2);
-		
-	for (Ship &s: ships) {
-		s.bullets.resize( 100 ); // move in init
+	bullets.init( 100 * (int)ships.size() );
 
-		for (Bullet& b : s.bullets)
-		{
-			// let set a tranform manually to adapt the bullet asset to our needs
-			b.meshComponent.t.scale = 0.5f;
-		}
+	for (size_t i = 0; i < ships.size(); i++) {
+		Ship &s = ships[i];
+		s.id = (int)i;
 
 		s.reset();
 
 		s.coll.radius = 0.8f;
 		s.mass = 10.0; // KG!
-						
-		// let set a tranform manually to adapt the ship asset to our needs
-		s.meshComponent.t.setIde();
-		s.meshComponent.t.scale = 0.05f;
-		s.meshComponent.t.ori = quat(-sqrt(2.0f) / 2.0f, 0, 0, sqrt(2.0f) / 2.0f);
-	}
-	ships[0].setStatsAsFighter();
-	ships[1].setStatsAsTank();
-	
-	floor.reset(new Floor());	
-	floor->meshComponent.t.ori = glm::angleAxis(glm::pi<float>()*0.5f, glm::vec3{ 1.0f, 0.0f, 0.0f });
-	floor->meshComponent.t.scale = 2.0f*arenaRadius;
-
-	floor->t.pos = glm::vec3{ 0.0f, 0.0f, -1.2f };
-
-	camera.setProjectionParams(glm::pi<float>() * 0.45f, static_cast<float>(windowWidth) / windowHeight, 1.0f, 100.0f);
-	camera.computeInvProj();
-	camera.viewTransform = glm::mat4();
-
-	lighting.reset(new SceneLighting{});
-	lighting->ambientLight = glm::vec3(0.1f, 0.1f, 0.1f);
-		
-	lighting->directionalLights[0].color = glm::vec3{ 0.5f, 0.5f, 0.5f };
-	lighting->directionalLights[0].direction = glm::normalize(glm::vec3{ -0.5f, 0.0f, -1.0f });
-	
-	constexpr float arenaLightsRadius = 4.0f;
-	lighting->pointLights[2].positionAndRadius = glm::vec4{ -arenaRadius, arenaRadius, 0.0f, arenaLightsRadius};
-	lighting->pointLights[3].positionAndRadius = glm::vec4{ 0.0f, arenaRadius, 0.0f, arenaLightsRadius };
-	lighting->pointLights[4].positionAndRadius = glm::vec4{ arenaRadius, arenaRadius, 0.0f, arenaLightsRadius };
-	lighting->pointLights[5].positionAndRadius = glm::vec4{ -arenaRadius, 0.0f, 0.0f, arenaLightsRadius };
-	lighting->pointLights[6].positionAndRadius = glm::vec4{ arenaRadius, 0.0f, 0.0f, arenaLightsRadius };
-	lighting->pointLights[7].positionAndRadius = glm::vec4{ -arenaRadius, -arenaRadius, 0.0f, arenaLightsRadius };
-	lighting->pointLights[8].positionAndRadius = glm::vec4{ 0.0f, -arenaRadius, 0.0f, arenaLightsRadius };
-	lighting->pointLights[9].positionAndRadius = glm::vec4{ arenaRadius, -arenaRadius, 0.0f, arenaLightsRadius };
-
-	//ships' lights
-	for (int i = 0; i < 2; ++i)
-	{
-		lighting->pointLights[i].color = glm::vec3{ 1.0f, 0.0f, 0.0f };
-		lighting->pointLights[i].attenuation = glm::vec3{ 0.0f, 1.0f, 0.0f }; //linear attenuation
-	}
 
-	//arena's lights
-	for (int i = 2; i < POINT_LIGHT_COUNT; ++i)
-	{
-		lighting->pointLights[i].color = glm::vec3{ 1.0f, 1.0f, 0.0f };
-		lighting->pointLights[i].attenuation = glm::vec3{0.0f, 1.0f, 0.0f}; //linear attenuation
+		if (i % 2 == 0) s.setStatsAsFighter();
+		else s.setStatsAsTank();
 	}
-	
-#ifdef FORWARD_RENDER
-	forwardRenderer.reset(new ForwardRenderer{});
-#else
-	deferredRenderer.reset(new DeferredRenderer{});
-#endif
-
-	shadowMapRenderer.reset(new ShadowMapRenderer{});
-	skyBoxRenderer.reset(new SkyBoxRenderer{});
-	skyBoxRenderer->skyBoxMaterial.skyBox = g_textureCubeLibrary.get("SkyBox");	
 }
 
 /* method to define stats */
@@ -221,52 +165,3 @@ void Ship::setStatsAsTank(){
 	stats.fireRange = 52.0f; // m
 	stats.fireSpeed = 22.0f; // m/s
 }
-
-static void getMaterialAssets(MeshComponent& meshComponent, const std::string& meshName,
-							   const std::string& diffuseMapName,
-							   const std::string& normalMapName,
-							   const std::string& specularMapName)
-{
-	if (g_meshLibrary.exists(meshName))
-	{
-		meshComponent.mesh = g_meshLibrary.get(meshName);
-	}
-	if (g_textureLibrary.exists(diffuseMapName))
-	{
-		meshComponent.material.diffuseMap = g_textureLibrary.get(diffuseMapName);
-	}
-	if (g_textureLibrary.exists(normalMapName))
-	{
-		meshComponent.material.normalMap = g_textureLibrary.get(normalMapName);
-	}
-	if (g_textureLibrary.exists(specularMapName))
-	{
-		meshComponent.material.specularMap = g_textureLibrary.get(specularMapName);
-	}
-}
-
-
-Ship::Ship()
-{
-	getMaterialAssets(meshComponent, "ShipMesh", "ShipDiffuseMap", "ShipNormalMap", "ShipSpecularMap");
-	
-	meshComponent.material.setSpecularExponent(80.0f);
-	meshComponent.material.setSpecularColor(glm::vec3{ 1.0f, 1.0f, 1.0f });
-}
-
-Bullet::Bullet()
-{
-	getMaterialAssets(meshComponent, "BulletMesh", "BulletDiffuseMap", "BulletNormalMap", "BulletSpecularMap");
-
-	meshComponent.material.setSpecularExponent(40.0f);
-	meshComponent.material.setSpecularColor(glm::vec3{ 0.2f, 0.2f, 0.2f });
-}
-
-Floor::Floor()
-{
-	getMaterialAssets(meshComponent, "FloorMesh", "FloorDiffuseMap", "FloorNormalMap", "FloorSpecularMap");
-
-	meshComponent.material.setTextCoordScale(glm::vec2{ 4.0f, 4.0f });
-	meshComponent.material.setSpecularExponent(28.0f);
-	meshComponent.material.setSpecularColor(glm::vec3{ 0.2f, 0.2f, 0.2f });
-}
@@ -0,0 +1,66 @@
+#ifndef _GBUFFER_ENCODING_H_
+#define _GBUFFER_ENCODING_H_
+
+/* the packing of the compact G-buffer (COMPACT_GBUFFER, see render_path.h), on the CPU:
+ *  - normals: octahedral, two 16 bit unorm channels (RG16)
+ *  - specular exponent: log2, in an 8 bit unorm channel, up to GBUFFER_MAX_SPECULAR_EXPONENT
+ * The same maths as positionReconstruction.glsl, so that the precision can be checked without a GPU;
+ * the constants are handed to the shaders from here.
+ * kamikaze --check-gbuffer-encoding (rendering_checks.cpp) holds the round trip to its error bounds.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// (std::min)/(std::max): rendering_engine.cpp includes this after Windows.h, and its min/max macros
+
+static constexpr float GBUFFER_MAX_SPECULAR_EXPONENT = 8192.0f;
+
+// what an unorm channel of the given bits stores for v in [0,1]
+inline float quantizeUnorm(float v, int bits)
+{
+	const float maxValue = static_cast<float>((1 << bits) - 1);
+	return std::round((std::min)((std::max)(v, 0.0f), 1.0f) * maxValue) / maxValue;
+}
+
+// n: unit length. Returns a point in [0,1]^2
+inline glm::vec2 encodeOctahedralNormal(glm::vec3 n)
+{
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+
+	glm::vec2 octahedral{ n.x, n.y };
+	if (n.z < 0.0f)
+	{
+		// the lower half folds over the diagonals
+		octahedral.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		octahedral.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	return glm::vec2{ octahedral.x * 0.5f + 0.5f, octahedral.y * 0.5f + 0.5f };
+}
+
+inline glm::vec3 decodeOctahedralNormal(glm::vec2 encoded)
+{
+	const float x = encoded.x * 2.0f - 1.0f;
+	const float y = encoded.y * 2.0f - 1.0f;
+	glm::vec3 n{ x, y, 1.0f - std::abs(x) - std::abs(y) };
+
+	const float t = (std::max)(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	return glm::normalize(n);
+}
+
+inline float encodeSpecularExponent(float specularExponent)
+{
+	return std::log2((std::max)(specularExponent, 1.0f)) / std::log2(GBUFFER_MAX_SPECULAR_EXPONENT);
+}
+
+inline float decodeSpecularExponent(float encoded)
+{
+	return std::exp2(encoded * std::log2(GBUFFER_MAX_SPECULAR_EXPONENT));
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _GL_DIAGNOSTICS_H_
+#define _GL_DIAGNOSTICS_H_
+
+/* how the rendering engine looks for OpenGL errors, chosen at startup
+ * (command line: --gl-diagnostics off|callback|check):
+ *  - OFF: it does not
+ *  - DEBUG_CALLBACK: the driver reports errors and warnings by itself (KHR_debug, glDebugMessageCallback),
+ *    asynchronously: nothing is paid per call. Works best with a debug context (see main.cpp)
+ *  - CHECK_EVERY_CALL: glGetError before and after every call (OPENGL_CALL): tells exactly which call
+ *    failed, but the CPU waits for the driver twice per call
+ *
+ * Checking every call is compiled in only in debug builds, or if GL_CALL_CHECKS is defined:
+ * otherwise OPENGL_CALL is just the call, and CHECK_EVERY_CALL falls back to DEBUG_CALLBACK.
+ */
+
+#include <atomic>
+
+enum class GlDiagnostics
+{
+	OFF,
+	DEBUG_CALLBACK,
+	CHECK_EVERY_CALL
+};
+
+extern GlDiagnostics g_glDiagnostics; // set it before creating the context and calling initRendering
+
+bool parseGlDiagnostics(const char* name, GlDiagnostics& diagnostics); // false if the name is unknown
+
+// what the checks cost, since the start of the frame
+struct GlDiagnosticsCounters
+{
+	unsigned int checkedCalls = 0;
+	double checkSeconds = 0; // spent in glGetError
+	std::atomic<unsigned int> debugMessages{ 0 }; // the callback may be called by a thread of the driver
+
+	void reset();
+};
+
+extern GlDiagnosticsCounters g_glDiagnosticsCounters;
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef _GL_STATE_CACHE_H_
+#define _GL_STATE_CACHE_H_
+
+/* GlStateCache:
+ * a shadow copy of the bits of OpenGL state which are set over and over while drawing
+ * (program, vertex array, uniform and storage buffer ranges, textures, blend and depth state, frame buffer).
+ * Binding what is already bound costs nothing: the call is not issued.
+ *
+ * All the code setting these bits must go through g_glState, or the copy goes stale.
+ * It is invalidated at the start of every frame (and when a resource is released),
+ * so at worst a bind is issued for nothing.
+ */
+
+#include "graphics_resource.h"
+
+struct GlStateCache
+{
+	GlStateCache() { invalidate(); }
+
+	//forgets everything: the next calls are all issued
+	void invalidate();
+
+	void useProgram(unsigned int programId);
+	void bindVertexArray(unsigned int vertexArrayId);
+	void bindUniformBufferRange(unsigned int bindingIndex, unsigned int bufferId, unsigned int offset, unsigned int size);
+	void bindShaderStorageBufferRange(unsigned int bindingIndex, unsigned int bufferId, unsigned int offset, unsigned int size);
+
+	//on the active texture unit
+	void activeTexture(unsigned int unit);
+	void bindTexture(unsigned int target, unsigned int textureId);
+	//on the given one
+	void bindTextureUnit(unsigned int unit, unsigned int target, unsigned int textureId);
+
+	void bindFramebuffer(unsigned int frameBufferObjectId);
+
+	//GL_BLEND and GL_DEPTH_TEST are cached, anything else is just passed along
+	void enable(unsigned int capability);
+	void disable(unsigned int capability);
+	void depthFunc(unsigned int func);
+	void blendEquation(unsigned int mode);
+	void blendFuncSeparate(unsigned int srcRgb, unsigned int dstRgb, unsigned int srcAlpha, unsigned int dstAlpha);
+
+	//GL calls which went to the driver, and which were dropped because they would have changed nothing
+	struct Counters
+	{
+		unsigned int issued = 0;
+		unsigned int elided = 0;
+	};
+	Counters counters; //since the start of the frame
+
+private:
+	static constexpr unsigned int UNKNOWN = 0xFFFFFFFF;
+	static constexpr unsigned int TEXTURE_UNIT_COUNT = 16;
+	static constexpr unsigned int UNIFORM_BINDING_COUNT = 16;
+	static constexpr unsigned int STORAGE_BINDING_COUNT = 8;
+
+	//true if the value was already there (and the call can be dropped); otherwise, it is stored
+	bool same(unsigned int& cached, unsigned int value);
+	void setCapability(unsigned int capability, bool enabled);
+
+	struct BufferRange
+	{
+		unsigned int bufferId;
+		unsigned int offset;
+		unsigned int size;
+	};
+
+	void bindBufferRange(unsigned int target, BufferRange* cachedRanges, unsigned int cachedCount,
+						 unsigned int bindingIndex, unsigned int bufferId, unsigned int offset, unsigned int size);
+
+	unsigned int programId = UNKNOWN;
+	unsigned int vertexArrayId = UNKNOWN;
+	BufferRange uniformBufferRanges[UNIFORM_BINDING_COUNT];
+	BufferRange storageBufferRanges[STORAGE_BINDING_COUNT];
+	unsigned int activeTextureUnit = UNKNOWN;
+	unsigned int textures2D[TEXTURE_UNIT_COUNT];
+	unsigned int texturesCubeMap[TEXTURE_UNIT_COUNT];
+	unsigned int frameBufferObjectId = UNKNOWN;
+	unsigned int blendEnabled = UNKNOWN;
+	unsigned int depthTestEnabled = UNKNOWN;
+	unsigned int depthFunction = UNKNOWN;
+	unsigned int blendMode = UNKNOWN;
+	unsigned int blendFactors[4] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+};
+
+extern GlStateCache g_glState;
+
+#endif
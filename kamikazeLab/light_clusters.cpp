@@ -0,0 +1,292 @@
+/* light_clusters.cpp
+ * the froxel grid, and the binning of the point lights into it
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define LIGHT_CLUSTERS_SSE
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <thread>
+#include "light_clusters.h"
+
+// below this many lights per thread, a thread costs more than it saves
+static constexpr unsigned int MIN_LIGHTS_PER_THREAD = 64;
+
+// (used by reference, in std::min)
+constexpr unsigned int LightClusters::SLICES;
+
+// padding: a light so far away it touches no cluster
+static constexpr float NOWHERE = 1e30f;
+
+void LightClusters::setProjection(float fovY, float aspectRatio, float nearPlane, float farPlane)
+{
+	if (fovY == this->fovY && aspectRatio == this->aspectRatio && nearPlane == this->nearPlane && farPlane == this->farPlane)
+	{
+		return;
+	}
+
+	this->fovY = fovY;
+	this->aspectRatio = aspectRatio;
+	this->nearPlane = nearPlane;
+	this->farPlane = farPlane;
+
+	// slice s starts at nearPlane * (farPlane/nearPlane)^(s/SLICES)
+	const float logDepthRange = std::log(farPlane / nearPlane);
+	depthScale = static_cast<float>(SLICES) / logDepthRange;
+	depthBias = -static_cast<float>(SLICES) * std::log(nearPlane) / logDepthRange; // (-SLICES alone would wrap around: it is unsigned)
+
+	sliceDepths.resize(SLICES + 1);
+	for (unsigned int s = 0; s <= SLICES; ++s)
+	{
+		sliceDepths[s] = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(s) / SLICES);
+	}
+	sliceDepths[SLICES] = farPlane;
+
+	// a point at depth d with ndc (x, y) is at (x * d * tanHalfFovX, y * d * tanHalfFovY, -d)
+	const float tanHalfFovY = std::tan(fovY * 0.5f);
+	const float tanHalfFovX = tanHalfFovY * aspectRatio;
+
+	boundsMinX.resize(CLUSTER_COUNT);
+	boundsMinY.resize(CLUSTER_COUNT);
+	boundsMinZ.resize(CLUSTER_COUNT);
+	boundsMaxX.resize(CLUSTER_COUNT);
+	boundsMaxY.resize(CLUSTER_COUNT);
+	boundsMaxZ.resize(CLUSTER_COUNT);
+
+	for (unsigned int s = 0; s < SLICES; ++s)
+	{
+		const float depthNear = sliceDepths[s];
+		const float depthFar = sliceDepths[s + 1];
+
+		for (unsigned int y = 0; y < TILES_Y; ++y)
+		{
+			const float ndcY0 = -1.0f + 2.0f * y / TILES_Y;
+			const float ndcY1 = -1.0f + 2.0f * (y + 1) / TILES_Y;
+
+			for (unsigned int x = 0; x < TILES_X; ++x)
+			{
+				const float ndcX0 = -1.0f + 2.0f * x / TILES_X;
+				const float ndcX1 = -1.0f + 2.0f * (x + 1) / TILES_X;
+
+				// the froxel widens with the depth: its box is the one of its near and far faces
+				const unsigned int c = x + TILES_X * (y + TILES_Y * s);
+				boundsMinX[c] = std::min(ndcX0 * depthNear, ndcX0 * depthFar) * tanHalfFovX;
+				boundsMaxX[c] = std::max(ndcX1 * depthNear, ndcX1 * depthFar) * tanHalfFovX;
+				boundsMinY[c] = std::min(ndcY0 * depthNear, ndcY0 * depthFar) * tanHalfFovY;
+				boundsMaxY[c] = std::max(ndcY1 * depthNear, ndcY1 * depthFar) * tanHalfFovY;
+				boundsMinZ[c] = -depthFar;
+				boundsMaxZ[c] = -depthNear;
+			}
+		}
+	}
+
+	ranges.assign(CLUSTER_COUNT, ClusterRange{ 0, 0 });
+	sliceLightIndices.resize(SLICES);
+}
+
+unsigned int LightClusters::clusterOf(float ndcX, float ndcY, float viewDepth)const
+{
+	const unsigned int x = std::min(static_cast<unsigned int>(std::max((ndcX + 1.0f) * 0.5f * TILES_X, 0.0f)), TILES_X - 1);
+	const unsigned int y = std::min(static_cast<unsigned int>(std::max((ndcY + 1.0f) * 0.5f * TILES_Y, 0.0f)), TILES_Y - 1);
+	const float slice = std::log(viewDepth) * depthScale + depthBias;
+	const unsigned int s = static_cast<unsigned int>(std::min(std::max(slice, 0.0f), static_cast<float>(SLICES - 1)));
+
+	return x + TILES_X * (y + TILES_Y * s);
+}
+
+void LightClusters::bin(const glm::vec4* viewSpaceLights, unsigned int lightCount, unsigned int threadCount)
+{
+	assert(!sliceDepths.empty()); // setProjection first
+
+	lights = viewSpaceLights;
+	this->lightCount = lightCount;
+
+	threadCount = std::max(1u, std::min(threadCount, lightCount / MIN_LIGHTS_PER_THREAD));
+	threadCount = std::min(threadCount, SLICES);
+	if (threadSliceLights.size() < threadCount) threadSliceLights.resize(threadCount);
+
+	// every thread takes a run of slices: each slice writes its own ranges and its own index list
+	if (threadCount > 1)
+	{
+		while (workers.size() < threadCount - 1)
+		{
+			workers.emplace_back(&LightClusters::work, this, static_cast<unsigned int>(workers.size()) + 1, round);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			roundThreadCount = threadCount;
+			pendingWorkers = threadCount - 1;
+			++round;
+		}
+		roundStarted.notify_all();
+	}
+
+	binSlices(0, SLICES / threadCount, threadSliceLights[0]);
+
+	if (threadCount > 1)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		roundFinished.wait(lock, [this] { return pendingWorkers == 0; });
+	}
+
+	// join the lists of the slices: the offsets were relative to their slice
+	lightIndices.clear();
+	for (unsigned int s = 0; s < SLICES; ++s)
+	{
+		const uint32_t sliceOffset = static_cast<uint32_t>(lightIndices.size());
+		for (unsigned int c = s * TILES_X * TILES_Y; c < (s + 1) * TILES_X * TILES_Y; ++c)
+		{
+			ranges[c].offset += sliceOffset;
+		}
+
+		lightIndices.insert(lightIndices.end(), sliceLightIndices[s].begin(), sliceLightIndices[s].end());
+	}
+
+	lights = nullptr;
+}
+
+LightClusters::~LightClusters()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	roundStarted.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void LightClusters::work(unsigned int threadIndex, unsigned int lastRound)
+{
+	for (;;)
+	{
+		unsigned int firstSlice, endSlice;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			roundStarted.wait(lock, [&] { return stopping || round != lastRound; });
+			if (stopping) return;
+
+			lastRound = round;
+			if (threadIndex >= roundThreadCount) continue;
+
+			firstSlice = SLICES * threadIndex / roundThreadCount;
+			endSlice = SLICES * (threadIndex + 1) / roundThreadCount;
+		}
+
+		binSlices(firstSlice, endSlice, threadSliceLights[threadIndex]);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--pendingWorkers == 0) roundFinished.notify_one();
+	}
+}
+
+static bool sphereTouchesBox(float x, float y, float z, float radius,
+							 float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+{
+	// the squared distance of the center from the box
+	const float dx = std::max(std::max(minX - x, x - maxX), 0.0f);
+	const float dy = std::max(std::max(minY - y, y - maxY), 0.0f);
+	const float dz = std::max(std::max(minZ - z, z - maxZ), 0.0f);
+
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+void LightClusters::binSlices(unsigned int firstSlice, unsigned int endSlice, SliceLights& sliceLights)
+{
+	for (unsigned int s = firstSlice; s < endSlice; ++s)
+	{
+		const float depthNear = sliceDepths[s];
+		const float depthFar = sliceDepths[s + 1];
+
+		// first, only the lights which reach the depths of the slice
+		sliceLights.x.clear();
+		sliceLights.y.clear();
+		sliceLights.z.clear();
+		sliceLights.radius.clear();
+		sliceLights.index.clear();
+
+		for (unsigned int i = 0; i < lightCount; ++i)
+		{
+			const glm::vec4& light = lights[i];
+			const float depth = -light.z;
+			if (depth + light.w >= depthNear && depth - light.w <= depthFar)
+			{
+				sliceLights.x.push_back(light.x);
+				sliceLights.y.push_back(light.y);
+				sliceLights.z.push_back(light.z);
+				sliceLights.radius.push_back(light.w);
+				sliceLights.index.push_back(i);
+			}
+		}
+
+		const unsigned int candidateCount = static_cast<unsigned int>(sliceLights.index.size());
+		while (sliceLights.x.size() % 4 != 0)
+		{
+			sliceLights.x.push_back(NOWHERE);
+			sliceLights.y.push_back(NOWHERE);
+			sliceLights.z.push_back(NOWHERE);
+			sliceLights.radius.push_back(0.0f);
+		}
+
+		// then, each of them against each froxel of the slice
+		std::vector<uint32_t>& indices = sliceLightIndices[s];
+		indices.clear();
+
+		for (unsigned int c = s * TILES_X * TILES_Y; c < (s + 1) * TILES_X * TILES_Y; ++c)
+		{
+			ranges[c].offset = static_cast<uint32_t>(indices.size());
+
+			unsigned int i = 0;
+
+#ifdef LIGHT_CLUSTERS_SSE
+			const __m128 minX = _mm_set1_ps(boundsMinX[c]);
+			const __m128 minY = _mm_set1_ps(boundsMinY[c]);
+			const __m128 minZ = _mm_set1_ps(boundsMinZ[c]);
+			const __m128 maxX = _mm_set1_ps(boundsMaxX[c]);
+			const __m128 maxY = _mm_set1_ps(boundsMaxY[c]);
+			const __m128 maxZ = _mm_set1_ps(boundsMaxZ[c]);
+			const __m128 zero = _mm_setzero_ps();
+
+			for (; i < candidateCount; i += 4)
+			{
+				const __m128 x = _mm_loadu_ps(sliceLights.x.data() + i);
+				const __m128 y = _mm_loadu_ps(sliceLights.y.data() + i);
+				const __m128 z = _mm_loadu_ps(sliceLights.z.data() + i);
+				const __m128 radius = _mm_loadu_ps(sliceLights.radius.data() + i);
+
+				const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+				const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+				const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+				const __m128 squaredDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+				int mask = _mm_movemask_ps(_mm_cmple_ps(squaredDistance, _mm_mul_ps(radius, radius)));
+				while (mask != 0)
+				{
+					const unsigned int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+					indices.push_back(sliceLights.index[i + lane]); // never a padding: those touch nothing
+					mask &= mask - 1;
+				}
+			}
+#endif
+
+			for (; i < candidateCount; ++i)
+			{
+				if (sphereTouchesBox(sliceLights.x[i], sliceLights.y[i], sliceLights.z[i], sliceLights.radius[i],
+					boundsMinX[c], boundsMinY[c], boundsMinZ[c], boundsMaxX[c], boundsMaxY[c], boundsMaxZ[c]))
+				{
+					indices.push_back(sliceLights.index[i]);
+				}
+			}
+
+			ranges[c].count = static_cast<uint32_t>(indices.size()) - ranges[c].offset;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef _LIGHT_CLUSTERS_H_
+#define _LIGHT_CLUSTERS_H_
+
+/* LightClusters:
+ * clustered shading. The view frustum is split in a grid of froxels (clusters):
+ * TILES_X * TILES_Y tiles of the screen, times SLICES slices of depth, thicker and thicker
+ * with the distance (exponentially, so that the froxels stay about as deep as they are wide).
+ *
+ * Every frame, the point lights are binned on the CPU: each cluster gets the list of the lights
+ * whose sphere touches it, and a fragment is lit only by the lights of its cluster
+ * (see clusteredLighting.glsl, and ClusteredLighting in clustered_lighting.h for the upload).
+ * The threads which help with the binning are started once, and wait for the next frame in between.
+ *
+ * Nothing here knows about OpenGL: it is checked on its own by kamikaze --check-clusters (rendering_checks.cpp).
+ */
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+// the lights of a cluster are lightIndices[offset, offset + count)
+struct ClusterRange
+{
+	uint32_t offset;
+	uint32_t count;
+};
+
+struct LightClusters
+{
+	static constexpr unsigned int TILES_X = 16;
+	static constexpr unsigned int TILES_Y = 9;
+	static constexpr unsigned int SLICES = 24;
+	static constexpr unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+
+	LightClusters() = default;
+	~LightClusters(); // stops the binning threads
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// the froxels of a symmetric perspective projection (as Camera::setProjectionParams makes)
+	void setProjection(float fovY, float aspectRatio, float nearPlane, float farPlane);
+
+	// viewSpaceLights[i]: xyz the center of light i, in view space (looking down -z); w its radius.
+	// The slices are split among threadCount threads (the calling one included, the others kept for the next calls)
+	void bin(const glm::vec4* viewSpaceLights, unsigned int lightCount, unsigned int threadCount = 1);
+
+	// the cluster of a point, the way the shaders find it:
+	// ndc in [-1,1], viewDepth the distance from the eye along -z
+	unsigned int clusterOf(float ndcX, float ndcY, float viewDepth)const;
+
+	// slice = log(viewDepth) * depthScale + depthBias (then clamped to [0, SLICES-1])
+	float depthScale = 0.0f;
+	float depthBias = 0.0f;
+
+	std::vector<ClusterRange> ranges; // one per cluster, index = x + TILES_X * (y + TILES_Y * slice)
+	std::vector<uint32_t> lightIndices;
+
+private:
+	// what a thread needs while binning: the lights which may touch the slice at hand,
+	// padded to a multiple of 4 (with lights touching nothing)
+	struct SliceLights
+	{
+		std::vector<float> x, y, z, radius;
+		std::vector<uint32_t> index;
+	};
+
+	void binSlices(unsigned int firstSlice, unsigned int endSlice, SliceLights& sliceLights);
+	void work(unsigned int threadIndex, unsigned int lastRound); // on the binning thread threadIndex (from 1)
+
+	float fovY = 0.0f, aspectRatio = 0.0f, nearPlane = 0.0f, farPlane = 0.0f;
+
+	// the view space bounds of the froxels (boxes around them), one per cluster
+	std::vector<float> boundsMinX, boundsMinY, boundsMinZ, boundsMaxX, boundsMaxY, boundsMaxZ;
+	// the depth (along -z) where each slice starts; SLICES + 1 of them
+	std::vector<float> sliceDepths;
+
+	const glm::vec4* lights = nullptr;
+	unsigned int lightCount = 0;
+
+	std::vector<SliceLights> threadSliceLights; // one per thread
+
+	std::vector<std::thread> workers; // the binning threads 1, 2...: never more than needed so far
+
+	std::mutex mutex;
+	std::condition_variable roundStarted;
+	std::condition_variable roundFinished;
+	unsigned int round = 0; // how many binnings the workers were woken for
+	unsigned int roundThreadCount = 1; // the threads binning in this round (workers past it sit it out)
+	unsigned int pendingWorkers = 0; // binning in this round, and not done yet
+	bool stopping = false;
+	std::vector<std::vector<uint32_t>> sliceLightIndices; // one per slice, before being joined
+};
+
+#endif
@@ -1,25 +1,31 @@
 #ifndef _LIGHTS_H_
 #define _LIGHTS_H_
 
+#include <vector>
 #include <glm\glm.hpp>
 
+//the point lights are not counted: there can be any number of them (see light_clusters.h)
 #define DIR_LIGHT_COUNT 1
-#define POINT_LIGHT_COUNT 10
 
 //shadow filtering techniques, undefine both to use the trivial way
 #define SHADOW_LERP
 //#define SHADOW_PCF
 
+//cascaded shadow maps: the depths of the camera are split among SHADOW_CASCADE_COUNT cascades, nearer ones
+//covering less of the scene with the same SHADOW_CASCADE_RESOLUTION^2 texels (see ShadowMapRenderer).
+//More or larger cascades: sharper shadows, for more fill-rate
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_CASCADE_RESOLUTION 1024
+//how the splits go from evenly spaced (0) to logarithmic (1)
+#define SHADOW_CASCADE_SPLIT_LAMBDA 0.75f
+
 #ifndef DIR_LIGHT_COUNT 
 #define DIR_LIGHT_COUNT 0
 #endif
 
-#ifndef POINT_LIGHT_COUNT 
-#define POINT_LIGHT_COUNT 0
-#endif
-
 static_assert(DIR_LIGHT_COUNT > 0, "Invalid directional lights count!");
-static_assert(POINT_LIGHT_COUNT > 0, "Invalid point lights count!");
+static_assert(SHADOW_CASCADE_COUNT > 0 && SHADOW_CASCADE_COUNT <= 4, "the cascade splits are handed to the shaders in a vec4");
+static_assert(SHADOW_CASCADE_COUNT * SHADOW_CASCADE_RESOLUTION <= 16384, "the cascades of a light share one texture, side by side");
 
 struct DirectionalLight
 {
@@ -38,11 +44,13 @@ struct PointLight
 	float pad1;
 };
 
+static_assert(sizeof(PointLight) == 48, "PointLight must match its std430 layout in the shaders");
+
 
 struct SceneLighting
 {
 	DirectionalLight directionalLights[DIR_LIGHT_COUNT];
-	PointLight pointLights[POINT_LIGHT_COUNT];	
+	std::vector<PointLight> pointLights; //the ones of the scenery
 	glm::vec3 ambientLight;	
 };
 
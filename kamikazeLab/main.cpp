@@ -7,6 +7,10 @@
  */
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 /* we use SDL but note the rest of the code is SDL free!!!
  * E.g. it should be easy to change this with, e.g. freeGlut, glfw, etc
@@ -14,35 +18,52 @@
 
 #include <SDL.h>
 #include "custom_classes.h"
+#include "scene_rendering.h"
 #include "aimind.h"
 #include "window.h"
+#include "scene_snapshot.h"
+#include "triple_buffer.h"
+#include "gl_state_cache.h"
+#include "gl_diagnostics.h"
+#include "render_path.h"
 
 using namespace std;
-const int FPS = 30;
+
+/* simulation and rendering go at their own pace, each on its own thread:
+ * the simulation thread makes fixed steps (as many as the time passed asks for),
+ * and publishes a snapshot after each one (snapshots, below);
+ * the main thread handles events, and draws the latest snapshot as often as it can,
+ * interpolating between its two steps */
+const int SIM_RATE = 30; // physics steps per second
+const int MAX_RENDER_FPS = 0; // frames per second, at most (0: as many as the display takes, see vsync)
+const double MAX_LAG = 0.25; // secs: if the simulation is further behind, the game slows down instead of catching up
+const bool PRINT_RENDER_COUNTERS = false; // once a second, on the console: draws, binds, GL state calls, checks and lights of the last frame
 
 SDL_Window *win = NULL;
 SDL_GLContext glcontext;
 
 int N_PLAYERS = 2; // 0, 1 or 2
 
-bool quitGame = false;
+std::atomic<bool> quitGame( false );
+
+/* main thread -> simulation thread */
+std::atomic<bool> newGameRequested( false );
+ShipController playerControllers[2]; // soak the keys: only the main thread touches them
+std::atomic<unsigned int> playerInput[2]; // their status, packed (see ShipController::packStatus)
+
+/* simulation thread -> main thread */
+TripleBuffer< SceneSnapshot > snapshots;
 
+/* the scene and the AIs are only touched by the simulation thread (once it started) */
 AiMind aiP0;
 AiMind aiP1;
 
-void rendering();
+void rendering(const SceneSnapshot& snapshot, float alpha);
 void initRendering();
 void preloadAllAssets();
-
-#define SDL_TIMEREVENT SDL_USEREVENT
-
-
-unsigned int pushTimerEvent(unsigned int /*time*/ , void* /*data*/ ){
-	SDL_Event e;
-	e.type = SDL_TIMEREVENT;
-	SDL_PushEvent(&e);
-	return 1000/FPS;
-}
+int benchAssetImport();
+int checkLightClusters();
+int checkGBufferEncoding();
 
 void callbackKeyboard(SDL_Event &e , bool isDown ){
 	int key = e.key.keysym.sym;
@@ -51,27 +72,84 @@ void callbackKeyboard(SDL_Event &e , bool isDown ){
 		quitGame = true;
 		break;
 	case SDLK_r:
-		if (!isDown) scene.initAsNewGame();
+		if (!isDown) newGameRequested = true;
+		break;
+	case SDLK_l:
+		if (!isDown) g_deferredPointLights = (g_deferredPointLights == DeferredPointLights::CLUSTERED) ? DeferredPointLights::VOLUMES : DeferredPointLights::CLUSTERED;
 		break;
 	}
-	scene.ships[0].controller.soakKey( key, isDown );
-	scene.ships[1].controller.soakKey( key, isDown );
+	for (int i = 0; i < N_PLAYERS; i++) {
+		playerControllers[i].soakKey( key, isDown );
+		playerInput[i] = playerControllers[i].packStatus();
+	}
 }
 
-// questo viene invocato FPS volte al secondo:
-void callbackTimer(SDL_Event& ){
+// questo viene invocato SIM_RATE volte al secondo:
+void doSimStep(){
+	if (newGameRequested.exchange( false )) scene.initAsNewGame();
 
-	SDL_GL_MakeCurrent( win, glcontext );
+	for (int i = 0; i < N_PLAYERS; i++) scene.ships[i].controller.unpackStatus( playerInput[i] );
 
-	aiP0.rethink( scene.ships[0].controller );
-	aiP1.rethink( scene.ships[1].controller );
+	if (N_PLAYERS<1) aiP0.rethink( scene.ships[0].controller );
+	if (N_PLAYERS<2) aiP1.rethink( scene.ships[1].controller );
 
 	scene.doPhysStep();
 
-	rendering();
+	scene.takeSnapshot( snapshots.writeBuffer() );
+	snapshots.publish();
+}
+
+void simulationThread(){
+	using namespace std::chrono;
+	const auto stepTime = duration_cast< steady_clock::duration >( duration<double>( scene.stepDuration() ) );
+	const auto maxLag = duration_cast< steady_clock::duration >( duration<double>( MAX_LAG ) );
+
+	auto nextStep = steady_clock::now() + stepTime;
+	while (!quitGame) {
+		std::this_thread::sleep_until( nextStep );
+		doSimStep();
+		nextStep += stepTime;
+		if (steady_clock::now() - nextStep > maxLag) nextStep = steady_clock::now(); // give up catching up
+	}
+}
+
+void printRenderCounters(){
+	static auto lastPrint = std::chrono::steady_clock::now();
+	if (std::chrono::steady_clock::now() - lastPrint < std::chrono::seconds( 1 )) return;
+	lastPrint = std::chrono::steady_clock::now();
+
+	const RenderQueue::Counters &c = sceneRendering.renderQueue.counters;
+	std::cout << c.items << " items (" << c.culled << " culled), " << c.draws << " draws, "
+			  << c.binds() << " binds (" << c.unsortedBinds << " unsorted): "
+			  << c.programBinds << " programs, " << c.vertexArrayBinds << " vertex arrays, "
+			  << c.textureBinds << " textures, " << c.uniformBlockBinds << " uniform blocks\n";
+	std::cout << "GL state calls: " << g_glState.counters.issued << " issued, "
+			  << g_glState.counters.elided << " elided\n";
+	std::cout << "GL checks: " << g_glDiagnosticsCounters.checkedCalls << " calls checked, "
+			  << g_glDiagnosticsCounters.checkSeconds * 1000 << " ms in glGetError, "
+			  << g_glDiagnosticsCounters.debugMessages << " debug messages\n";
+	std::cout << "Point lights: " << sceneRendering.lighting->pointLights.size() << ", "
+			  << sceneRendering.clusteredLighting.clusters.lightIndices.size() << " light indices in "
+			  << LightClusters::CLUSTER_COUNT << " clusters\n";
+}
+
+void renderFrame(){
+
+	snapshots.update();
+	const SceneSnapshot& snapshot = snapshots.readBuffer();
+
+	// how far we are since its step
+	std::chrono::duration<double> sinceStep = std::chrono::steady_clock::now() - snapshot.stepTime;
+	float alpha = std::min( std::max( float( sinceStep.count() / snapshot.stepDuration ), 0.0f ), 1.0f );
+
+	SDL_GL_MakeCurrent( win, glcontext );
+
+	rendering( snapshot, alpha );
 
 	SDL_GL_SwapWindow( win );
 
+	if (PRINT_RENDER_COUNTERS) printRenderCounters();
+
 	/* // count frames:
 	static int nframe = 0;
 	std::cout << "Frame "<< (nframe++) <<"\n";
@@ -84,8 +162,6 @@ void processEvent( SDL_Event &e) {
 
 	case SDL_KEYDOWN: callbackKeyboard( e , true ); break;
 	case SDL_KEYUP  : callbackKeyboard( e , false); break;
-
-	case SDL_TIMEREVENT: callbackTimer( e ); break;
 	}
 }
 
@@ -103,16 +179,39 @@ void ShipController::useWASD(){
 	key[ FIRE ] = SDLK_LSHIFT;
 }
 
-int main(int , char **)
+int main(int argc, char **argv)
 {
+	if (argc > 1 && string( argv[1] ) == "--bench-import") {
+		return benchAssetImport(); // no window: only the importers, timed
+	}
+	if (argc > 1 && string( argv[1] ) == "--check-clusters") {
+		return checkLightClusters(); // no window either (see rendering_checks.cpp)
+	}
+	if (argc > 1 && string( argv[1] ) == "--check-gbuffer-encoding") {
+		return checkGBufferEncoding();
+	}
+
+	for (int i = 1; i + 1 < argc; i++) {
+		if (string( argv[i] ) == "--gl-diagnostics" && !parseGlDiagnostics( argv[i + 1], g_glDiagnostics )) {
+			std::cout << "usage: kamikaze [--gl-diagnostics off|callback|check]" << std::endl;
+			return 1;
+		}
+		if (string( argv[i] ) == "--point-lights" && !parseDeferredPointLights( argv[i + 1], g_deferredPointLights )) {
+			std::cout << "usage: kamikaze [--point-lights clustered|volumes]" << std::endl;
+			return 1;
+		}
+	}
 
-	if (SDL_Init( SDL_INIT_VIDEO | SDL_INIT_TIMER ) != 0){
+	if (SDL_Init( SDL_INIT_VIDEO ) != 0){
 		std::cout << "SDL_Init Error: " << SDL_GetError() << std::endl;
 		return 1;
 	}
 
 	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 16);
 	SDL_GL_SetAttribute(SDL_GL_FRAMEBUFFER_SRGB_CAPABLE, 1);
+	if (g_glDiagnostics != GlDiagnostics::OFF) {
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG); // the driver reports more
+	}
 
 	win = SDL_CreateWindow(
 		"Kamikaze!!!",
@@ -127,21 +226,22 @@ int main(int , char **)
 	}
 
 	glcontext = SDL_GL_CreateContext(win);
+	SDL_GL_SetSwapInterval(1); // vsync: one frame per refresh of the display
 	initRendering();
 
 	preloadAllAssets();
+	scene.setStepRate( SIM_RATE );
 	scene.initAsNewGame();
+	sceneRendering.initAsNewGame();
 
-	SDL_AddTimer( 1000/FPS, pushTimerEvent, NULL );
-
-	if (N_PLAYERS>0) scene.ships[0].controller.useArrows();
+	if (N_PLAYERS>0) playerControllers[0].useArrows();
 	else {
 		aiP0.me = &(scene.ships[0]);
 		aiP0.target = &(scene.ships[1]);
 		aiP0.setHumanLike();
 	}
 
-	if (N_PLAYERS>1) scene.ships[1].controller.useWASD();
+	if (N_PLAYERS>1) playerControllers[1].useWASD();
 	else {
 		aiP1.me = &(scene.ships[1]);
 		aiP1.target = &(scene.ships[0]);
@@ -149,12 +249,33 @@ int main(int , char **)
 		//aiP1.setHumanLike();
 	}
 
+	for (int i = 0; i < 2; i++) playerInput[i] = 0;
+
+	// something to draw, before the first step
+	scene.takeSnapshot( snapshots.writeBuffer() );
+	snapshots.publish();
+
+	std::thread simulation( simulationThread );
+
+	const double freq = double( SDL_GetPerformanceFrequency() );
+
 	/* ciclo degli eventi */
 	while (!quitGame) {
+		Uint64 frameStart = SDL_GetPerformanceCounter();
+
 		SDL_Event e;
-		SDL_WaitEvent(&e);
-		processEvent(e);
+		while (SDL_PollEvent(&e)) processEvent(e);
+
+		renderFrame();
+
+		if (MAX_RENDER_FPS > 0) {
+			double spent = (SDL_GetPerformanceCounter() - frameStart) / freq;
+			double frameTime = 1.0 / double( MAX_RENDER_FPS );
+			if (spent < frameTime) SDL_Delay( Uint32( (frameTime - spent) * 1000 ) );
+		}
 	}
+
+	simulation.join();
 	SDL_Quit();
 
 	return 0;
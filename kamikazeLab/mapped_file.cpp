@@ -0,0 +1,131 @@
+/* mapped_file.cpp
+ * memory mapping of files, and their stamps: Win32 or POSIX
+ */
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	if (fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		isEmpty = true;
+		return true;
+	}
+
+	// the view keeps the mapping (and the file) alive: both handles can go
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr) return false;
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == nullptr) return false;
+
+	byteCount = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+bool readFileStamp(const std::string& filename, FileStamp& stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes)) return false;
+
+	stamp.size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	stamp.modificationTime = static_cast<int64_t>((static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (view != nullptr) UnmapViewOfFile(view);
+	view = nullptr;
+	byteCount = 0;
+	isEmpty = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename)
+{
+	close();
+
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0) return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0) {
+		::close(file);
+		return false;
+	}
+
+	if (status.st_size == 0) {
+		::close(file);
+		isEmpty = true;
+		return true;
+	}
+
+	// the mapping keeps the file alive: the descriptor can go
+	void* mapped = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (mapped == MAP_FAILED) return false;
+
+	madvise(mapped, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+
+	view = mapped;
+	byteCount = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+bool readFileStamp(const std::string& filename, FileStamp& stamp)
+{
+	struct stat status;
+	if (stat(filename.c_str(), &status) != 0) return false;
+
+	stamp.size = static_cast<uint64_t>(status.st_size);
+	// in nanoseconds: st_mtime alone has whole seconds, and misses an edit within the second of the previous one
+#ifdef __APPLE__
+	const struct timespec& modified = status.st_mtimespec;
+#else
+	const struct timespec& modified = status.st_mtim;
+#endif
+	stamp.modificationTime = static_cast<int64_t>(modified.tv_sec) * 1000000000 + static_cast<int64_t>(modified.tv_nsec);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (view != nullptr) munmap(const_cast<void*>(view), byteCount);
+	view = nullptr;
+	byteCount = 0;
+	isEmpty = false;
+}
+
+#endif
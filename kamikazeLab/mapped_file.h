@@ -0,0 +1,46 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+/* MappedFile:
+ * a whole file, mapped (read only) in memory: the importers read it in place,
+ * with no stream and no copy. Unmapped when closed, or destroyed.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// what tells a version of a file from the others, without reading it
+struct FileStamp
+{
+	uint64_t size = 0;
+	int64_t modificationTime = 0; // in the units of the system: only compared, never converted
+
+	bool operator==(const FileStamp& other)const { return size == other.size && modificationTime == other.modificationTime; }
+	bool operator!=(const FileStamp& other)const { return !(*this == other); }
+};
+
+bool readFileStamp(const std::string& filename, FileStamp& stamp);
+
+struct MappedFile
+{
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& filename);
+	void close();
+
+	const char* data()const { return static_cast<const char*>(view); }
+	size_t size()const { return byteCount; }
+	bool isOpen()const { return view != nullptr || isEmpty; }
+
+private:
+	const void* view = nullptr;
+	size_t byteCount = 0;
+	bool isEmpty = false; // an empty file cannot be mapped, yet it is open
+};
+
+#endif
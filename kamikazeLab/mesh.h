@@ -32,6 +32,7 @@ using namespace glm;
 #endif
 
 #include "graphics_resource.h"
+#include "uniform_ring.h"
 
 
 struct Vertex{	
@@ -47,31 +48,60 @@ struct Tri{
 	Tri(int _i, int _j, int _k):i(_i),j(_j),k(_k){}
 };
 
+// what CpuMesh::import made of a file: the corners of its triangles, welded in fewer vertices
+struct MeshImportStats{
+	size_t cornerCount = 0;
+	size_t vertexCount = 0;
+	float dedupRatio()const { return vertexCount > 0 ? float(cornerCount) / vertexCount : 0.0f; }
+};
+
 /* (ids of) a mesh structure in GPU ram */
 struct GpuMesh{
 	void bind()const;
 	void render() const;
+
+	// instanced drawing: the world matrix of each instance is a vertex attribute (at 4..7),
+	// read from an array of glm::mat4 (one per instance)
+	void bindInstances(const UniformRange& worlds)const; // after bind
+	void renderInstanced(unsigned int firstInstance, unsigned int instanceCount)const;
+
 	uint geomBufferId = INVALID_GRAPHICS_RESOURCE_ID; // "name" of GPU buffer for vertices
 	uint connBufferId = INVALID_GRAPHICS_RESOURCE_ID; // "name" of GPU buffer for triangles
 	uint vertexArrayId = INVALID_GRAPHICS_RESOURCE_ID;
 	int nElements = 0;
+	vec4 boundingSphere = vec4(0.0f); // center (xyz) and radius (w), in mesh space: for culling
 
 	void release();
 };
 
+/* a mesh in CPU ram, ready for the GPU, which someone else owns
+ * (a CpuMesh, or the mapping of a cooked one: see cooked_mesh.h) */
+struct CpuMeshView{
+	const Vertex* verts = nullptr;
+	size_t vertexCount = 0;
+	const Tri* tris = nullptr;
+	size_t triCount = 0;
+	vec4 boundingSphere = vec4(0.0f);
+
+	GpuMesh uploadToGPU()const;
+};
+
 /* a mesh structure in CPU ram */
 struct CpuMesh{
 	std::vector< Vertex > verts;
 	std::vector< Tri > tris;
 
-	bool import(const std::string& filename);
+	// Wavefront OBJ: mapped, parsed on threadCount threads (see obj_parser.h), one vertex per distinct (pos, norm, uv)
+	bool import(const std::string& filename, MeshImportStats* stats = nullptr, unsigned int threadCount = 1);
+	bool importWithStreams(const std::string& filename); // the former OBJ importer: only the baseline of --bench-import
 	void renderDeprecated(); // uses immediate mode
 
 	// todo: a bit of geometry processing...
-	void updateNormals();
+	void updateNormals(); // smooth: the area weighted average of the normals of the triangles around each vertex
 	void resize( float scale );
 	void flipYZ();
 	void apply(Transform t);
+	vec4 boundingSphere()const; // center (xyz) and radius (w): around the center of the bounding box
 
 	// procedural constructions..
 	void buildTorus(int ni, int nj, float innerRadius, float outerRadius);
@@ -79,6 +109,7 @@ struct CpuMesh{
 	void buildSphere(float radius, int sliceCount, int stackCount);
 	void buildFullScreenQuad(); //built in ndc space
 
+	CpuMeshView view()const;
 	GpuMesh uploadToGPU()const;
 
 private:
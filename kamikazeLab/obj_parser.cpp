@@ -0,0 +1,354 @@
+/* obj_parser.cpp
+ * a hand written OBJ scanner, run on line aligned chunks of the text in parallel
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include "obj_parser.h"
+
+// below this many bytes per thread, a thread costs more than it saves
+static constexpr size_t MIN_BYTES_PER_THREAD = 64 * 1024;
+
+// the bits of ChunkData::relative
+static constexpr unsigned char RELATIVE_POSITION = 1;
+static constexpr unsigned char RELATIVE_UV = 2;
+static constexpr unsigned char RELATIVE_NORMAL = 4;
+
+// what a chunk of the text yields. The negative indices can only be resolved against the counts
+// of the chunk itself (it does not know how many elements the chunks before it hold):
+// they are marked, and shifted when the chunks are joined
+struct ChunkData
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners;
+	std::vector<unsigned char> relative; // one per corner
+	bool valid = true;
+};
+
+static const double POWERS_OF_10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c)
+{
+	return static_cast<unsigned char>(c - '0') < 10;
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+	while (p < end && isBlank(*p)) ++p;
+	return p;
+}
+
+// past the end of the line (its '\n' included)
+static inline const char* skipLine(const char* p, const char* end)
+{
+	while (p < end && *p != '\n') ++p;
+	return p < end ? p + 1 : end;
+}
+
+static inline bool atTokenEnd(const char* p, const char* end)
+{
+	return p >= end || isBlank(*p) || *p == '\n' || *p == '#';
+}
+
+static bool scanFloat(const char*& p, const char* end, float& value)
+{
+	p = skipBlanks(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	// up to 19 significant digits in an integer, the rest only moves the decimal point
+	uint64_t mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+
+	for (; p < end && isDigit(*p); ++p) {
+		anyDigit = true;
+		if (significantDigits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) ++significantDigits;
+		}
+		else ++exponent;
+	}
+
+	if (p < end && *p == '.') {
+		for (++p; p < end && isDigit(*p); ++p) {
+			anyDigit = true;
+			if (significantDigits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) ++significantDigits;
+				--exponent;
+			}
+		}
+	}
+
+	if (!anyDigit) return false;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = *p == '-';
+			++p;
+		}
+		if (p >= end || !isDigit(*p)) return false;
+
+		int writtenExponent = 0;
+		for (; p < end && isDigit(*p); ++p) {
+			if (writtenExponent < 10000) writtenExponent = writtenExponent * 10 + (*p - '0');
+		}
+		exponent += negativeExponent ? -writtenExponent : writtenExponent;
+	}
+
+	double v = static_cast<double>(mantissa);
+	if (exponent < 0) v /= exponent >= -22 ? POWERS_OF_10[-exponent] : std::pow(10.0, -exponent);
+	else if (exponent > 0) v *= exponent <= 22 ? POWERS_OF_10[exponent] : std::pow(10.0, exponent);
+
+	value = static_cast<float>(negative ? -v : v);
+	return atTokenEnd(p, end);
+}
+
+static bool scanInt(const char*& p, const char* end, int& value)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+	if (p >= end || !isDigit(*p)) return false;
+
+	long long v = 0;
+	for (; p < end && isDigit(*p); ++p) {
+		v = v * 10 + (*p - '0');
+		if (v > 0x7FFFFFFF) return false;
+	}
+
+	value = static_cast<int>(negative ? -v : v);
+	return true;
+}
+
+// an index as written (1-based, or negative: from the end of the list so far) to a 0-based one
+static bool resolveIndex(int written, size_t countSoFar, int& index, unsigned char& relative, unsigned char relativeBit)
+{
+	if (written > 0) {
+		index = written - 1;
+		return true;
+	}
+	if (written < 0) {
+		index = static_cast<int>(countSoFar) + written; // may be negative: an element of an earlier chunk
+		relative |= relativeBit;
+		return true;
+	}
+	return false; // there is no index 0
+}
+
+static bool scanCorner(const char*& p, const char* end, const ChunkData& chunk, ObjCorner& corner, unsigned char& relative)
+{
+	corner = ObjCorner{ -1, -1, -1 };
+	relative = 0;
+
+	int written;
+	if (!scanInt(p, end, written) || !resolveIndex(written, chunk.positions.size(), corner.position, relative, RELATIVE_POSITION)) return false;
+
+	if (p < end && *p == '/') {
+		++p;
+		if (p < end && *p != '/') {
+			if (!scanInt(p, end, written) || !resolveIndex(written, chunk.uvs.size(), corner.uv, relative, RELATIVE_UV)) return false;
+		}
+		if (p < end && *p == '/') {
+			++p;
+			if (!scanInt(p, end, written) || !resolveIndex(written, chunk.normals.size(), corner.normal, relative, RELATIVE_NORMAL)) return false;
+		}
+	}
+
+	return atTokenEnd(p, end);
+}
+
+// p: past the "f"; the polygon is split in the fan (0, i, i+1)
+static bool scanFace(const char*& p, const char* end, ChunkData& chunk)
+{
+	ObjCorner first, previous;
+	unsigned char firstRelative = 0, previousRelative = 0;
+	int cornerCount = 0;
+
+	for (;;) {
+		p = skipBlanks(p, end);
+		if (p >= end || *p == '\n' || *p == '#') break;
+
+		ObjCorner corner;
+		unsigned char relative;
+		if (!scanCorner(p, end, chunk, corner, relative)) return false;
+
+		if (cornerCount >= 2) {
+			chunk.corners.push_back(first);
+			chunk.corners.push_back(previous);
+			chunk.corners.push_back(corner);
+			chunk.relative.push_back(firstRelative);
+			chunk.relative.push_back(previousRelative);
+			chunk.relative.push_back(relative);
+		}
+		else if (cornerCount == 0) {
+			first = corner;
+			firstRelative = relative;
+		}
+
+		previous = corner;
+		previousRelative = relative;
+		++cornerCount;
+	}
+
+	return cornerCount >= 3;
+}
+
+static void parseChunk(const char* begin, const char* end, ChunkData& chunk)
+{
+	// a guess, from the usual line lengths: most of the growth without reallocations
+	const size_t lineGuess = static_cast<size_t>(end - begin) / 32;
+	chunk.positions.reserve(lineGuess / 4);
+	chunk.corners.reserve(lineGuess);
+	chunk.relative.reserve(lineGuess);
+
+	const char* p = begin;
+	while (p < end) {
+		p = skipBlanks(p, end);
+		if (p >= end) break;
+
+		bool ok = true;
+		if (p[0] == 'v' && p + 1 < end && isBlank(p[1])) {
+			glm::vec3 v;
+			p += 1;
+			ok = scanFloat(p, end, v.x) && scanFloat(p, end, v.y) && scanFloat(p, end, v.z);
+			chunk.positions.push_back(v); // (an optional w is skipped with the rest of the line)
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 'n' && isBlank(p[2])) {
+			glm::vec3 n;
+			p += 2;
+			ok = scanFloat(p, end, n.x) && scanFloat(p, end, n.y) && scanFloat(p, end, n.z);
+			chunk.normals.push_back(n);
+		}
+		else if (p[0] == 'v' && p + 2 < end && p[1] == 't' && isBlank(p[2])) {
+			glm::vec2 uv;
+			p += 2;
+			ok = scanFloat(p, end, uv.x);
+			const char* afterU = skipBlanks(p, end);
+			if (ok && afterU < end && *afterU != '\n' && *afterU != '#') ok = scanFloat(p, end, uv.y);
+			else uv.y = 0.0f; // v is optional
+			chunk.uvs.push_back(uv);
+		}
+		else if (p[0] == 'f' && p + 1 < end && isBlank(p[1])) {
+			p += 1;
+			ok = scanFace(p, end, chunk);
+		}
+
+		if (!ok) {
+			chunk.valid = false;
+			return;
+		}
+
+		p = skipLine(p, end);
+	}
+}
+
+bool ObjData::hasNormals()const
+{
+	return !corners.empty() && std::all_of(corners.begin(), corners.end(), [](const ObjCorner& c) { return c.normal >= 0; });
+}
+
+bool ObjData::hasUvs()const
+{
+	return !corners.empty() && std::all_of(corners.begin(), corners.end(), [](const ObjCorner& c) { return c.uv >= 0; });
+}
+
+bool parseObj(const char* text, size_t size, ObjData& obj, unsigned int threadCount)
+{
+	threadCount = static_cast<unsigned int>(std::max<size_t>(1, std::min<size_t>(threadCount, size / MIN_BYTES_PER_THREAD)));
+
+	// the chunks start at line starts: each boundary moves forward to the next one
+	std::vector<const char*> boundaries(threadCount + 1);
+	boundaries[0] = text;
+	boundaries[threadCount] = text + size;
+	for (unsigned int t = 1; t < threadCount; ++t) {
+		const char* p = std::max(text + size * t / threadCount, boundaries[t - 1]);
+		while (p < text + size && p > text && p[-1] != '\n') ++p;
+		boundaries[t] = p;
+	}
+
+	std::vector<ChunkData> chunks(threadCount);
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+
+	for (unsigned int t = 1; t < threadCount; ++t) {
+		threads.emplace_back(parseChunk, boundaries[t], boundaries[t + 1], std::ref(chunks[t]));
+	}
+
+	parseChunk(boundaries[0], boundaries[1], chunks[0]);
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	// join: the elements one chunk after the other, the relative indices shifted by what came before
+	size_t positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+	for (const ChunkData& chunk : chunks) {
+		if (!chunk.valid) return false;
+		positionCount += chunk.positions.size();
+		uvCount += chunk.uvs.size();
+		normalCount += chunk.normals.size();
+		cornerCount += chunk.corners.size();
+	}
+
+	obj.positions.clear();
+	obj.uvs.clear();
+	obj.normals.clear();
+	obj.corners.clear();
+	obj.positions.reserve(positionCount);
+	obj.uvs.reserve(uvCount);
+	obj.normals.reserve(normalCount);
+	obj.corners.reserve(cornerCount);
+
+	for (const ChunkData& chunk : chunks) {
+		const int positionOffset = static_cast<int>(obj.positions.size());
+		const int uvOffset = static_cast<int>(obj.uvs.size());
+		const int normalOffset = static_cast<int>(obj.normals.size());
+
+		for (size_t i = 0; i < chunk.corners.size(); ++i) {
+			ObjCorner corner = chunk.corners[i];
+			const unsigned char relative = chunk.relative[i];
+			if (relative & RELATIVE_POSITION) corner.position += positionOffset;
+			if (relative & RELATIVE_UV) corner.uv += uvOffset;
+			if (relative & RELATIVE_NORMAL) corner.normal += normalOffset;
+
+			if (corner.position < 0 || corner.position >= static_cast<int>(positionCount) ||
+				corner.uv < -1 || corner.uv >= static_cast<int>(uvCount) ||
+				corner.normal < -1 || corner.normal >= static_cast<int>(normalCount)) {
+				return false;
+			}
+			// (a relative index reaching before the start of the file lands below -1, or on -1 for a missing one:
+			// both caught above, but for -1 on uv and normal, which only a malformed file writes)
+
+			obj.corners.push_back(corner);
+		}
+
+		obj.positions.insert(obj.positions.end(), chunk.positions.begin(), chunk.positions.end());
+		obj.uvs.insert(obj.uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+		obj.normals.insert(obj.normals.end(), chunk.normals.begin(), chunk.normals.end());
+	}
+
+	return true;
+}
@@ -0,0 +1,43 @@
+#ifndef _OBJ_PARSER_H_
+#define _OBJ_PARSER_H_
+
+/* parseObj:
+ * the geometry of a Wavefront OBJ text (v, vn, vt and f lines; anything else is skipped),
+ * as it is in the file: no axis swap, no flip of the texture coordinates (see CpuMesh::import).
+ *
+ * The text is split in chunks, at line ends, parsed in parallel (by hand: no streams, no strings,
+ * no allocation but the output arrays) and then joined. Faces can have any number of corners
+ * (they are split in triangle fans), the indices can be negative (relative to the end of the list
+ * so far) and any corner can miss its texture coordinates or its normal.
+ *
+ * Nothing here knows about the rest of the engine: it can be run (and timed) on its own.
+ */
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct ObjCorner
+{
+	// 0-based, in ObjData::positions, uvs and normals; -1 if the corner has none
+	int position;
+	int uv;
+	int normal;
+};
+
+struct ObjData
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<ObjCorner> corners; // 3 per triangle
+
+	bool hasNormals()const;
+	bool hasUvs()const;
+};
+
+// false if the text is malformed, or some index is out of range.
+// threadCount: at most (small texts get fewer threads), the calling one included
+bool parseObj(const char* text, size_t size, ObjData& obj, unsigned int threadCount = 1);
+
+#endif
@@ -1,9 +1,9 @@
 #ifndef PHYS_OBJECT_H
 #define PHYS_OBJECT_H
 
+#include <cstdint>
 #include "transform.h"
 #include "collider.h"
-#include "mesh.h"
 
 /* class PhysObject:
  *  a physical entithy if our virtual world.
@@ -12,7 +12,9 @@
  *    - physical properties, like mass, speed, angular speed...
  *    - more components, including:
  *      * a physical estension (a Collider)
- *      * a way it looks (a MeshComponent)
+ *
+ * The way it looks (a MeshComponent) is not here: it is kept by the
+ * rendering side (see scene_rendering.h), so that physics runs without a GPU.
  *
  * TODO: make a hierarchical structure, i.e. make it a node of a SceneGraph.
  */
@@ -20,17 +22,16 @@
 class PhysObject{
 public:
 	Transform t;
+	Transform prevT; // where it was before the last step
 
 	// components
 	Collider coll;
-	MeshComponent meshComponent;
 
 	vec3 vel;
 	quat angVel;
 
 	float mass;
 
-	void render();
 	void doPhysStep();
 
 	float drag;
@@ -40,17 +41,36 @@ public:
 		vel = vec3(0,0,0);
 		angVel = quat(1,0,0,0);
 		t.setIde();
+		prevT = t;
 	}
-
-	void setCameraInside(glm::mat4&)const;
-
-	void setAccumulatedTransform(glm::mat4&)const;
-	glm::mat4 getAccumulatedTransform()const;
 };
 
 bool collides(const PhysObject &a ,
 			  const PhysObject &b );
 
+bool collides( vec3 posA, float radiusA, vec3 posB, float radiusB ); // sphere VS sphere
+
+/* sphere VS sphere, both moving (from, from+move) during a step:
+ * if they touch, timeOfImpact is when (0: at the start of the step, 1: at the end) */
+bool collidesSwept( vec3 fromA, vec3 moveA, float radiusA,
+				   vec3 fromB, vec3 moveB, float radiusB, float &timeOfImpact );
+
+/* many moving spheres, packed as arrays */
+struct SweptSpheres{
+	const float *x, *y, *z; // where they start from
+	const float *moveX, *moveY, *moveZ;
+	const float *radius;
+	SweptSpheres offset( int i ) const {
+		return SweptSpheres{ x+i, y+i, z+i, moveX+i, moveY+i, moveZ+i, radius+i };
+	}
+};
+
+/* one moving sphere VS (up to) 64 of them: bit i of the result is set if the i-th collides.
+ * Uses AVX or SSE when compiled for it; the Scalar version (collidesSwept) is the reference. */
+const int COLLIDES_BATCH_MAX = 64;
+uint64_t collidesBatch( vec3 from, vec3 move, float radius, const SweptSpheres &s, int n );
+uint64_t collidesBatchScalar( vec3 from, vec3 move, float radius, const SweptSpheres &s, int n );
+
 void enforceSeparate(PhysObject &a , PhysObject &b );
 
 
@@ -5,9 +5,13 @@
  */
 
 #include <math.h>
+#include <algorithm>
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#endif
 #include "custom_classes.h"
 
-const float dt = 1.0f/30; // in secs
+static float dt = 1.0f/30; // in secs: see Scene::setStepRate
 
 void PhysObject::doPhysStep(){
 
@@ -15,6 +19,7 @@ void PhysObject::doPhysStep(){
 	vec3 acc = force / mass;
 	vel += acc * dt;*/
 
+	prevT = t;
 	t.pos += vel * dt;
 	t.ori *= glm::slerp( quat(1,0,0,0) , angVel ,  dt*10 );
 
@@ -39,18 +44,112 @@ bool collides(const PhysObject &a ,
 	/*if (a.coll.type == Collider::SPHERE &&
 		b.coll.type == Collider::SPHERE) */
 	{
-		// test sphere VS sphere:
-		return dot(
-					a.t.pos - b.t.pos ,
-					a.t.pos - b.t.pos
-			   )
-			   <
-			   (a.coll.radius + b.coll.radius)*
-			   (a.coll.radius + b.coll.radius);
+		return collides( a.t.pos, a.coll.radius, b.t.pos, b.coll.radius );
 	}
 
 }
 
+bool collides( vec3 posA, float radiusA, vec3 posB, float radiusB ){
+	// test sphere VS sphere:
+	return dot( posA - posB , posA - posB )
+		   <
+		   (radiusA + radiusB)*(radiusA + radiusB);
+}
+
+bool collidesSwept( vec3 fromA, vec3 moveA, float radiusA,
+				   vec3 fromB, vec3 moveB, float radiusB, float &timeOfImpact )
+{
+	// seen from A, B goes from d to d+m (A stays still): when is |d + m*t| = ra+rb?
+	vec3 d = fromB - fromA;
+	vec3 m = moveB - moveA;
+	float rr = radiusA + radiusB;
+
+	float c = dot( d, d ) - rr*rr;
+	if (c < 0) { timeOfImpact = 0; return true; } // touching already
+	float b = dot( d, m );
+	if (b >= 0) return false; // not getting closer
+	float a = dot( m, m );
+	float disc = b*b - a*c;
+	if (disc < 0) return false; // never close enough
+	float t = (-b - std::sqrt( disc )) / a;
+	if (t > 1) return false; // not within this step
+	timeOfImpact = t;
+	return true;
+}
+
+uint64_t collidesBatchScalar( vec3 from, vec3 move, float radius, const SweptSpheres &s, int n )
+{
+	uint64_t hits = 0;
+	float toi;
+	for (int i = 0; i < n; i++) {
+		if (collidesSwept( from, move, radius,
+						   vec3( s.x[i], s.y[i], s.z[i] ), vec3( s.moveX[i], s.moveY[i], s.moveZ[i] ), s.radius[i],
+						   toi )) hits |= uint64_t(1) << i;
+	}
+	return hits;
+}
+
+/* the batch versions do not look for the time of impact, only for the closest approach:
+ * with d,m as in collidesSwept, t* = clamp( -dot(d,m)/dot(m,m), 0, 1 ), and
+ * they collide if |d + m*t*|^2 - (ra+rb)^2 = c + t*(2b + a*t) < 0  (no sqrt, no branches) */
+uint64_t collidesBatch( vec3 from, vec3 move, float radius, const SweptSpheres &s, int n )
+{
+	uint64_t hits = 0;
+	int i = 0;
+
+#if defined(__AVX__)
+	const __m256 fx = _mm256_set1_ps( from.x ), fy = _mm256_set1_ps( from.y ), fz = _mm256_set1_ps( from.z );
+	const __m256 vx = _mm256_set1_ps( move.x ), vy = _mm256_set1_ps( move.y ), vz = _mm256_set1_ps( move.z );
+	const __m256 fr = _mm256_set1_ps( radius );
+	const __m256 tiny8 = _mm256_set1_ps( 1e-12f ), one8 = _mm256_set1_ps( 1.0f );
+	const __m256 zero8 = _mm256_setzero_ps();
+	for (; i + 8 <= n; i += 8) {
+		__m256 dx = _mm256_sub_ps( _mm256_loadu_ps( s.x+i ), fx );
+		__m256 dy = _mm256_sub_ps( _mm256_loadu_ps( s.y+i ), fy );
+		__m256 dz = _mm256_sub_ps( _mm256_loadu_ps( s.z+i ), fz );
+		__m256 mx = _mm256_sub_ps( _mm256_loadu_ps( s.moveX+i ), vx );
+		__m256 my = _mm256_sub_ps( _mm256_loadu_ps( s.moveY+i ), vy );
+		__m256 mz = _mm256_sub_ps( _mm256_loadu_ps( s.moveZ+i ), vz );
+		__m256 rr = _mm256_add_ps( fr, _mm256_loadu_ps( s.radius+i ) );
+		__m256 a = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( mx, mx ), _mm256_mul_ps( my, my ) ), _mm256_mul_ps( mz, mz ) );
+		__m256 b = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, mx ), _mm256_mul_ps( dy, my ) ), _mm256_mul_ps( dz, mz ) );
+		__m256 c = _mm256_sub_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), _mm256_mul_ps( dz, dz ) ),
+								  _mm256_mul_ps( rr, rr ) );
+		__m256 t = _mm256_div_ps( _mm256_sub_ps( zero8, b ), _mm256_max_ps( a, tiny8 ) );
+		t = _mm256_min_ps( _mm256_max_ps( t, zero8 ), one8 );
+		__m256 f = _mm256_add_ps( c, _mm256_mul_ps( t, _mm256_add_ps( _mm256_add_ps( b, b ), _mm256_mul_ps( a, t ) ) ) );
+		hits |= uint64_t( _mm256_movemask_ps( _mm256_cmp_ps( f, zero8, _CMP_LT_OQ ) ) ) << i;
+	}
+#endif
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	const __m128 qfx = _mm_set1_ps( from.x ), qfy = _mm_set1_ps( from.y ), qfz = _mm_set1_ps( from.z );
+	const __m128 qvx = _mm_set1_ps( move.x ), qvy = _mm_set1_ps( move.y ), qvz = _mm_set1_ps( move.z );
+	const __m128 qfr = _mm_set1_ps( radius );
+	const __m128 tiny4 = _mm_set1_ps( 1e-12f ), one4 = _mm_set1_ps( 1.0f ), zero4 = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) {
+		__m128 dx = _mm_sub_ps( _mm_loadu_ps( s.x+i ), qfx );
+		__m128 dy = _mm_sub_ps( _mm_loadu_ps( s.y+i ), qfy );
+		__m128 dz = _mm_sub_ps( _mm_loadu_ps( s.z+i ), qfz );
+		__m128 mx = _mm_sub_ps( _mm_loadu_ps( s.moveX+i ), qvx );
+		__m128 my = _mm_sub_ps( _mm_loadu_ps( s.moveY+i ), qvy );
+		__m128 mz = _mm_sub_ps( _mm_loadu_ps( s.moveZ+i ), qvz );
+		__m128 rr = _mm_add_ps( qfr, _mm_loadu_ps( s.radius+i ) );
+		__m128 a = _mm_add_ps( _mm_add_ps( _mm_mul_ps( mx, mx ), _mm_mul_ps( my, my ) ), _mm_mul_ps( mz, mz ) );
+		__m128 b = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, mx ), _mm_mul_ps( dy, my ) ), _mm_mul_ps( dz, mz ) );
+		__m128 c = _mm_sub_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) ),
+							   _mm_mul_ps( rr, rr ) );
+		__m128 t = _mm_div_ps( _mm_sub_ps( zero4, b ), _mm_max_ps( a, tiny4 ) );
+		t = _mm_min_ps( _mm_max_ps( t, zero4 ), one4 );
+		__m128 f = _mm_add_ps( c, _mm_mul_ps( t, _mm_add_ps( _mm_add_ps( b, b ), _mm_mul_ps( a, t ) ) ) );
+		hits |= uint64_t( _mm_movemask_ps( _mm_cmplt_ps( f, zero4 ) ) ) << i;
+	}
+#endif
+	// the leftovers (all of them, without SIMD)
+	if (i < n) hits |= collidesBatchScalar( from, move, radius, s.offset( i ), n-i ) << i;
+
+	return hits;
+}
+
 void enforceSeparate(PhysObject &a, PhysObject &b){
 	float currDist = length(a.t.pos - b.t.pos);
 	float minDist = a.coll.radius + b.coll.radius;
@@ -64,12 +163,168 @@ void enforceSeparate(PhysObject &a, PhysObject &b){
 
 }
 
-void Bullet::doPhysStep(){
-	if (!alive) return;
-	timeToLive -= dt;
-	if (timeToLive<=0) alive = false;
+/* BulletPool */
+
+void BulletPool::init( int capacity ){
+	count = 0;
+	pos.resize( capacity );
+	vel.resize( capacity );
+	radius.resize( capacity );
+	timeToLive.resize( capacity );
+	owner.resize( capacity );
+}
+
+bool BulletPool::spawn( const BulletState& b, int ownerId ){
+	if (count == capacity()) return false;
+	int i = count++;
+	pos[i] = b.pos;
+	vel[i] = b.vel;
+	radius[i] = b.radius;
+	timeToLive[i] = b.timeToLive;
+	owner[i] = ownerId;
+	return true;
+}
+
+void BulletPool::despawn( int i ){
+	int last = --count;
+	pos[i] = pos[last];
+	vel[i] = vel[last];
+	radius[i] = radius[last];
+	timeToLive[i] = timeToLive[last];
+	owner[i] = owner[last];
+}
+
+void BulletPool::despawnAllOf( int ownerId ){
+	for (int i = 0; i < count; ) {
+		if (owner[i] == ownerId) despawn( i ); // i now holds another bullet: check it too
+		else i++;
+	}
+}
+
+void BulletPool::doPhysStep(){
+	for (int i = 0; i < count; i++) {
+		timeToLive[i] -= dt;
+		pos[i] += vel[i]*dt;
+	}
+	for (int i = 0; i < count; ) {
+		if (timeToLive[i] <= 0) despawn( i );
+		else i++;
+	}
+}
+
+/* BroadphaseGrid */
+
+void BroadphaseGrid::init( float arenaRadius, float size ){
+	side = std::max( 1, (int)std::ceil( 2*arenaRadius / size ) );
+	cellSize = 2*arenaRadius / side;
+	minCoord = -arenaRadius;
+	bulletStart.assign( side*side + 1, 0 );
+	shipStart.assign( side*side + 1, 0 );
+}
+
+int BroadphaseGrid::cellOf( float coord ) const {
+	int c = (int)std::floor( (coord - minCoord) / cellSize );
+	return std::min( std::max( c, 0 ), side-1 );
+}
+
+void BroadphaseGrid::build( const std::vector< vec3 >& shipFrom,
+							const std::vector< vec3 >& shipTo,
+							const std::vector< float >& shipRadius,
+							const BulletPool& bullets, float dt )
+{
+	sortBullets( bullets, dt );
+
+	float maxBulletReach = 0; // radius + step length
+	for (int i = 0; i < bullets.count; i++) {
+		maxBulletReach = std::max( maxBulletReach, bullets.radius[i] + length( bullets.vel[i] )*dt );
+	}
+
+	/* ships: counting sort too, but one ship goes in many cells */
+	int nShips = (int)shipTo.size();
+	shipCells.resize( nShips );
+	std::fill( shipStart.begin(), shipStart.end(), 0 );
+	for (int i = 0; i < nShips; i++) {
+		float r = shipRadius[i] + maxBulletReach;
+		CellRect &rect = shipCells[i];
+		rect.x0 = cellOf( std::min( shipFrom[i].x, shipTo[i].x ) - r );
+		rect.y0 = cellOf( std::min( shipFrom[i].y, shipTo[i].y ) - r );
+		rect.x1 = cellOf( std::max( shipFrom[i].x, shipTo[i].x ) + r );
+		rect.y1 = cellOf( std::max( shipFrom[i].y, shipTo[i].y ) + r );
+		for (int y = rect.y0; y <= rect.y1; y++)
+		for (int x = rect.x0; x <= rect.x1; x++) shipStart[ cellIndex(x,y) + 1 ]++;
+	}
+	for (int c = 0; c < side*side; c++) shipStart[c+1] += shipStart[c];
+
+	fill.assign( shipStart.begin(), shipStart.end() - 1 );
+	shipsInCell.resize( shipStart.back() );
+	for (int i = 0; i < nShips; i++) {
+		const CellRect &rect = shipCells[i];
+		for (int y = rect.y0; y <= rect.y1; y++)
+		for (int x = rect.x0; x <= rect.x1; x++) shipsInCell[ fill[ cellIndex(x,y) ]++ ] = i;
+	}
+
+	findShipPairs();
+}
+
+void BroadphaseGrid::sortBullets( const BulletPool& bullets, float dt ){
+	int n = bullets.count;
+
+	bulletCell.resize( n );
+	std::fill( bulletStart.begin(), bulletStart.end(), 0 );
+	for (int i = 0; i < n; i++) {
+		int c = cellIndex( cellOf( bullets.pos[i].x ), cellOf( bullets.pos[i].y ) );
+		bulletCell[i] = c;
+		bulletStart[c+1]++;
+	}
+	for (int c = 0; c < side*side; c++) bulletStart[c+1] += bulletStart[c];
+
+	fill.assign( bulletStart.begin(), bulletStart.end() - 1 );
+	sortedBullet.resize( n );
+	sortedX.resize( n );
+	sortedY.resize( n );
+	sortedZ.resize( n );
+	sortedMoveX.resize( n );
+	sortedMoveY.resize( n );
+	sortedMoveZ.resize( n );
+	sortedRadius.resize( n );
+	for (int i = 0; i < n; i++) {
+		int j = fill[ bulletCell[i] ]++;
+		vec3 move = bullets.vel[i]*dt; // bullets fly straight: no need to remember where they were
+		vec3 from = bullets.pos[i] - move;
+		sortedBullet[j] = i;
+		sortedX[j] = from.x;
+		sortedY[j] = from.y;
+		sortedZ[j] = from.z;
+		sortedMoveX[j] = move.x;
+		sortedMoveY[j] = move.y;
+		sortedMoveZ[j] = move.z;
+		sortedRadius[j] = bullets.radius[i];
+	}
+}
+
+SweptSpheres BroadphaseGrid::sortedSpheres( int k ) const {
+	return SweptSpheres{ &sortedX[0], &sortedY[0], &sortedZ[0],
+						 &sortedMoveX[0], &sortedMoveY[0], &sortedMoveZ[0],
+						 &sortedRadius[0] }.offset( k );
+}
 
-	t.pos += vel*dt;
+void BroadphaseGrid::findShipPairs(){
+	shipPairs.clear();
+	for (int a = 0; a < (int)shipCells.size(); a++) {
+		const CellRect &ra = shipCells[a];
+		for (int y = ra.y0; y <= ra.y1; y++)
+		for (int x = ra.x0; x <= ra.x1; x++) {
+			int c = cellIndex( x, y );
+			for (int k = shipStart[c]; k < shipStart[c+1]; k++) {
+				int b = shipsInCell[k];
+				if (b <= a) continue;
+				// two ships can share many cells: report them only in the first one
+				if (x != std::max( ra.x0, shipCells[b].x0 )) continue;
+				if (y != std::max( ra.y0, shipCells[b].y0 )) continue;
+				shipPairs.push_back( ShipPair{ a, b } );
+			}
+		}
+	}
 }
 
 void Ship::doPhysStep(){
@@ -94,13 +349,11 @@ void Ship::doPhysStep(){
 		} else timeBeforeFiringAgain -= dt;
 
 		// graphics: make it do a roll according to angular velocity
-		float rollAngle = glm::angle(angVel) *
+		// (the renderer applies it to the MeshComponent of the ship)
+		rollAngle = glm::angle(angVel) *
 				sign(dot(glm::axis(angVel),vec3(0,0,1)))
 				* 1.3f
 				* (length(vel)*0.055f+1.0f);
-		meshComponent.t.ori =
-				glm::angleAxis( rollAngle, vec3(0,-1,0) ) *
-				quat( -sqrt(2.0f)/2.0f,0,0,sqrt(2.0f)/2 )  ;
 	}
 	else {
 		timeDead+=dt;
@@ -112,31 +365,66 @@ void Ship::doPhysStep(){
 
 	if (!scene.isInside( t.pos )) vel *= -0.8;
 	//t.pos = scene.pacmanWarp( t.pos );
-
-	/* BULLETS */
-	for (Bullet& b: bullets) b.doPhysStep();
 }
 
 void Scene::checkAllCollisions(){
-	if (collides(ships[0],ships[1])) {
-		// collision response: ship VS ship
-		std::swap( ships[0].vel, ships[1].vel );
-		enforceSeparate(ships[0],ships[1]);
+	shipFrom.resize( ships.size() );
+	shipTo.resize( ships.size() );
+	shipRadius.resize( ships.size() );
+	for (size_t i = 0; i < ships.size(); i++) {
+		shipFrom[i] = ships[i].prevT.pos;
+		shipTo[i] = ships[i].t.pos;
+		shipRadius[i] = ships[i].coll.radius;
 	}
+	grid.build( shipFrom, shipTo, shipRadius, bullets, dt );
 
-	for (Bullet &b : ships[0].bullets) if (b.alive){
-		if ( collides(b,ships[1]) ) ships[1].die();
+	/* bullets VS ships (before ships are moved apart: the grid knows where they were).
+	 * Swept: bullets are too fast and too small to be tested only where they land
+	 * (a tank bullet goes more than ten times its diameter in a step) */
+	for (Ship &s : ships) {
+		if (!s.alive) continue; // can't die twice
+		const BroadphaseGrid::CellRect &r = grid.cellsOfShip( s.id );
+		vec3 move = s.t.pos - s.prevT.pos;
+		for (int y = r.y0; y <= r.y1; y++)
+		for (int x = r.x0; x <= r.x1; x++) {
+			int c = grid.cellIndex( x, y );
+			for (int k = grid.bulletStart[c]; k < grid.bulletStart[c+1]; k += COLLIDES_BATCH_MAX) {
+				int n = std::min( COLLIDES_BATCH_MAX, grid.bulletStart[c+1] - k );
+				uint64_t hits = collidesBatch( s.prevT.pos, move, s.coll.radius, grid.sortedSpheres( k ), n );
+				if (!hits) continue;
+				for (int j = 0; j < n; j++) {
+					if (!(hits >> j & 1)) continue;
+					if (bullets.owner[ grid.sortedBullet[k+j] ] == s.id) continue; // no friendly fire
+					s.die();
+				}
+			}
+		}
 	}
 
-	for (Bullet &b : ships[1].bullets) if (b.alive) {
-		if ( collides(b,ships[0]) ) ships[0].die();
+	for (const BroadphaseGrid::ShipPair &p : grid.shipPairs) {
+		Ship &a = ships[p.a];
+		Ship &b = ships[p.b];
+		if (collides(a,b)) {
+			// collision response: ship VS ship
+			std::swap( a.vel, b.vel );
+			enforceSeparate(a,b);
+		}
 	}
 }
 
+void Scene::setStepRate( float stepsPerSecond ){
+	dt = 1.0f / stepsPerSecond;
+}
+
+float Scene::stepDuration() const{
+	return dt;
+}
+
 void Scene::doPhysStep(){
 	for (Ship &s : ships){
-		s.doPhysStep(); // also move bullets
+		s.doPhysStep(); // may spawn bullets
 	}
+	bullets.doPhysStep();
 	checkAllCollisions();
 }
 
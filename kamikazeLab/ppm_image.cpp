@@ -0,0 +1,127 @@
+/* ppm_image.cpp
+ * the header of binary PPM images, and the expansion of their texels
+ */
+
+// the SSSE3 kernel is built on every x86 target and picked at run time, as SSSE3 is not in the x86-64 baseline
+// (and MSVC never defines __SSSE3__: /arch:AVX would be needed for it)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PPM_IMAGE_SSSE3
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PPM_IMAGE_SSSE3_TARGET
+#else
+#define PPM_IMAGE_SSSE3_TARGET __attribute__((target("ssse3")))
+#endif
+#endif
+
+#include <cstdint>
+#include "ppm_image.h"
+
+static inline bool isPpmWhitespace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// the blanks, and the comments (from '#' to the end of the line), before a header field
+static const char* skipSeparators(const char* p, const char* end)
+{
+	while (p < end) {
+		if (isPpmWhitespace(*p)) ++p;
+		else if (*p == '#') {
+			while (p < end && *p != '\n') ++p;
+		}
+		else break;
+	}
+	return p;
+}
+
+static bool scanHeaderField(const char*& p, const char* end, int& value)
+{
+	p = skipSeparators(p, end);
+	if (p >= end || static_cast<unsigned char>(*p - '0') >= 10) return false;
+
+	long long v = 0;
+	for (; p < end && static_cast<unsigned char>(*p - '0') < 10; ++p) {
+		v = v * 10 + (*p - '0');
+		if (v > 0x7FFFFFFF) return false;
+	}
+
+	value = static_cast<int>(v);
+	return true;
+}
+
+bool parsePpmHeader(const char* data, size_t size, PpmHeader& header)
+{
+	const char* end = data + size;
+	if (size < 2 || data[0] != 'P' || data[1] != '6') return false;
+
+	const char* p = data + 2;
+	if (p >= end || (!isPpmWhitespace(*p) && *p != '#')) return false;
+	if (!scanHeaderField(p, end, header.width) || !scanHeaderField(p, end, header.height) || !scanHeaderField(p, end, header.maxValue)) return false;
+	if (header.width <= 0 || header.height <= 0 || header.maxValue <= 0 || header.maxValue > 255) return false;
+
+	// exactly one whitespace between the header and the texels (which may well start with a "blank" byte)
+	if (p >= end || !isPpmWhitespace(*p)) return false;
+	++p;
+
+	header.payloadOffset = static_cast<size_t>(p - data);
+	const uint64_t payloadSize = uint64_t(header.width) * uint64_t(header.height) * 3;
+	return payloadSize <= size - header.payloadOffset;
+}
+
+#ifdef PPM_IMAGE_SSSE3
+static bool cpuHasSsse3()
+{
+#if defined(__SSSE3__) || defined(__AVX__)
+	return true;
+#elif defined(_MSC_VER)
+	int registers[4]; // eax, ebx, ecx, edx
+	__cpuid(registers, 1);
+	return (registers[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3") != 0;
+#endif
+}
+
+// returns how many texels it expanded: a multiple of 16, the caller does the rest
+PPM_IMAGE_SSSE3_TARGET static size_t expandRgbToRgbaSsse3(const unsigned char* rgb, unsigned char* rgba, size_t texelCount)
+{
+	size_t i = 0;
+
+	// 48 bytes in (16 texels), 64 out: each quarter of the output is 12 input bytes, spread by the same shuffle
+	const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+	for (; i + 16 <= texelCount; i += 16) {
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3 + 16));
+		const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + i * 3 + 32));
+
+		__m128i* out = reinterpret_cast<__m128i*>(rgba + i * 4);
+		_mm_storeu_si128(out + 0, _mm_or_si128(_mm_shuffle_epi8(a, spread), opaque)); // bytes 0..11
+		_mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), spread), opaque)); // 12..23
+		_mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), spread), opaque)); // 24..35
+		_mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(c, 4), spread), opaque)); // 36..47
+	}
+
+	return i;
+}
+#endif
+
+void expandRgbToRgba(const unsigned char* rgb, unsigned char* rgba, size_t texelCount)
+{
+	size_t i = 0;
+
+#ifdef PPM_IMAGE_SSSE3
+	static const bool hasSsse3 = cpuHasSsse3();
+	if (hasSsse3) i = expandRgbToRgbaSsse3(rgb, rgba, texelCount);
+#endif
+
+	for (; i < texelCount; ++i) {
+		rgba[i * 4 + 0] = rgb[i * 3 + 0];
+		rgba[i * 4 + 1] = rgb[i * 3 + 1];
+		rgba[i * 4 + 2] = rgb[i * 3 + 2];
+		rgba[i * 4 + 3] = 255;
+	}
+}
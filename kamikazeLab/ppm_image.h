@@ -0,0 +1,27 @@
+#ifndef _PPM_IMAGE_H_
+#define _PPM_IMAGE_H_
+
+/* the binary PPM images of the assets (P6, whatever their extension: the .pbm files are P6 too):
+ *  - parsePpmHeader: checks the header, and finds where the texels start
+ *  - expandRgbToRgba: their RGB triples, to the RGBA texels of a texture (alpha 255),
+ *    16 texels at a time with a byte shuffle where SSSE3 is available
+ *
+ * Nothing here knows about the rest of the engine: it can be run (and timed) on its own.
+ */
+
+#include <cstddef>
+
+struct PpmHeader
+{
+	int width = 0;
+	int height = 0;
+	int maxValue = 0; // 1..255 (16 bit channels are refused)
+	size_t payloadOffset = 0; // where the texels start: row by row, top to bottom, 3 bytes each
+};
+
+// false if it is not a P6 image, or the file is too short for the texels its header promises
+bool parsePpmHeader(const char* data, size_t size, PpmHeader& header);
+
+void expandRgbToRgba(const unsigned char* rgb, unsigned char* rgba, size_t texelCount);
+
+#endif
@@ -4,4 +4,23 @@
 //default render path is deferred, uncomment the following line to use the forward path.
 //#define FORWARD_RENDER
 
+//the deferred path builds both ways of lighting with the point lights:
+//CLUSTERED: with the point lights of each cluster, in the same full-screen pass as the directional lights (see light_clusters.h)
+//VOLUMES: with a sphere per point light, all of them in one instanced draw
+//pick one with --point-lights clustered|volumes, switch at run time with L
+enum class DeferredPointLights
+{
+	CLUSTERED,
+	VOLUMES
+};
+
+extern DeferredPointLights g_deferredPointLights;
+
+bool parseDeferredPointLights(const char* name, DeferredPointLights& pointLights); // false if the name is unknown
+
+//the G-buffer is packed: octahedral RG16 normals, RGBA8 sRGB albedo, RGBA8 specular with a log encoded exponent
+//(16 bytes per pixel with the depth, instead of 38: see gbuffer_encoding.h). Comment the following line to keep
+//it in floating point formats instead.
+#define COMPACT_GBUFFER
+
 #endif
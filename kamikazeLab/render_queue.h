@@ -0,0 +1,95 @@
+#ifndef _RENDER_QUEUE_H_
+#define _RENDER_QUEUE_H_
+
+/* RenderQueue:
+ * what is drawn in a frame, by every pass, as a list of items (one per visible object per pass:
+ * each pass culls the bounding spheres of the objects against its own frustum).
+ * Each item has a 64 bit sort key:
+ *
+ *   63..60  pass          (the shadow map cascades of each light, then the opaque items)
+ *   59..52  program
+ *   51..32  material      (a hash of textures and parameters)
+ *   31..16  mesh          (its vertex array)
+ *   15..0   depth         (front to back, among items in the same state)
+ *
+ * so that, once (radix) sorted, items in the same state are next to each other:
+ * a pass only binds what differs from the item before, and draws as one instanced call
+ * the items with the same mesh and looks.
+ *
+ * The world matrices are uploaded once, after sorting, in the order of the items:
+ * instance i of a draw is item i of the queue.
+ */
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "uniform_ring.h"
+#include "frustum.h"
+#include "lights.h"
+
+struct RenderObject;
+
+struct RenderQueue
+{
+	enum Pass
+	{
+		SHADOW_PASS, // of the first cascade of the first directional light: cascade c of light i is SHADOW_PASS + i * SHADOW_CASCADE_COUNT + c
+		OPAQUE_PASS = SHADOW_PASS + DIR_LIGHT_COUNT * SHADOW_CASCADE_COUNT,
+		PASS_COUNT
+	};
+	static_assert(PASS_COUNT <= 16, "the pass must fit in 4 bits of the sort key");
+
+	struct Item
+	{
+		uint64_t key;
+		unsigned int object; // in the RenderObjects given to build
+	};
+
+	// bind calls issued in the last frame (whatever the renderer: see RenderQueue::render)
+	struct Counters
+	{
+		unsigned int items = 0;
+		unsigned int culled = 0; // objects out of the frustum of a pass (counted once per pass)
+		unsigned int draws = 0;
+		unsigned int programBinds = 0;
+		unsigned int vertexArrayBinds = 0;
+		unsigned int textureBinds = 0;
+		unsigned int uniformBlockBinds = 0;
+
+		// what the same frame would have taken drawing each item by itself, binding everything for it
+		// (program, uniform blocks, vertex array and, but for the shadow maps, the 3 textures)
+		unsigned int unsortedBinds = 0;
+
+		unsigned int binds()const { return programBinds + vertexArrayBinds + textureBinds + uniformBlockBinds; }
+	};
+
+	// one item per object per pass, if in the frustum of the pass; sorted, and the world matrices uploaded
+	void build(const RenderObject* renderObjects, unsigned int count, const Frustum (&passFrustums)[PASS_COUNT]);
+
+	// the items of a pass are [passBegin, passEnd)
+	unsigned int passBegin(Pass pass)const { return passStart[pass]; }
+	unsigned int passEnd(Pass pass)const { return passStart[pass + 1]; }
+
+	// draws the items of a pass: the pass-wide state (program, scene blocks...) must already be bound
+	void render(Pass pass);
+
+	std::vector<Item> items;
+	UniformRange worlds; // one glm::mat4 per item
+
+	Counters counters;
+
+private:
+	void sortItems();
+
+	const RenderObject* objects = nullptr;
+	unsigned int passStart[PASS_COUNT + 1] = {};
+
+	std::vector<Item> sortScratch;
+	std::vector<glm::mat4> worldsScratch;
+
+	// the bounding spheres of the objects, in world space (as cullSpheres wants them)
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	std::vector<unsigned char> visible;
+};
+
+#endif
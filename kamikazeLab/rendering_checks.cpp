@@ -0,0 +1,194 @@
+/* rendering_checks.cpp
+ * checks of the parts of the rendering which run on the CPU, against the plain versions
+ * of what they compute. No window, no OpenGL:
+ *
+ *   kamikaze --check-clusters         (LightClusters::bin, threaded and SSE, against a brute force binning)
+ *   kamikaze --check-gbuffer-encoding (the round trip of the packed G-buffer, against its error bounds)
+ *
+ * Each prints what it measured, and returns non zero if anything is off.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "light_clusters.h"
+#include "gbuffer_encoding.h"
+
+using namespace std;
+
+static float randomIn(float lo, float hi)
+{
+	return lo + (hi - lo) * float(rand()) / float(RAND_MAX);
+}
+
+/*		clusters		*/
+
+// the froxel boxes of LightClusters::setProjection, recomputed the same way
+struct ReferenceFroxels
+{
+	ReferenceFroxels(float fovY, float aspectRatio, float nearPlane, float farPlane)
+	{
+		const unsigned int tilesX = LightClusters::TILES_X, tilesY = LightClusters::TILES_Y, slices = LightClusters::SLICES;
+
+		std::vector<float> sliceDepths(slices + 1);
+		for (unsigned int s = 0; s <= slices; ++s) sliceDepths[s] = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(s) / slices);
+		sliceDepths[slices] = farPlane;
+
+		const float tanHalfFovY = std::tan(fovY * 0.5f);
+		const float tanHalfFovX = tanHalfFovY * aspectRatio;
+
+		boxes.resize(LightClusters::CLUSTER_COUNT);
+		for (unsigned int s = 0; s < slices; ++s)
+		for (unsigned int y = 0; y < tilesY; ++y)
+		for (unsigned int x = 0; x < tilesX; ++x) {
+			const float depthNear = sliceDepths[s], depthFar = sliceDepths[s + 1];
+			const float ndcX0 = -1.0f + 2.0f * x / tilesX, ndcX1 = -1.0f + 2.0f * (x + 1) / tilesX;
+			const float ndcY0 = -1.0f + 2.0f * y / tilesY, ndcY1 = -1.0f + 2.0f * (y + 1) / tilesY;
+
+			Box& b = boxes[x + tilesX * (y + tilesY * s)];
+			b.min = glm::vec3(std::min(ndcX0 * depthNear, ndcX0 * depthFar) * tanHalfFovX, std::min(ndcY0 * depthNear, ndcY0 * depthFar) * tanHalfFovY, -depthFar);
+			b.max = glm::vec3(std::max(ndcX1 * depthNear, ndcX1 * depthFar) * tanHalfFovX, std::max(ndcY1 * depthNear, ndcY1 * depthFar) * tanHalfFovY, -depthNear);
+		}
+	}
+
+	// every light against every froxel
+	std::vector<uint32_t> lightsOf(unsigned int cluster, const std::vector<glm::vec4>& lights)const
+	{
+		const Box& b = boxes[cluster];
+		std::vector<uint32_t> touching;
+		for (uint32_t i = 0; i < lights.size(); ++i) {
+			const glm::vec4& l = lights[i];
+			const float dx = std::max(std::max(b.min.x - l.x, l.x - b.max.x), 0.0f);
+			const float dy = std::max(std::max(b.min.y - l.y, l.y - b.max.y), 0.0f);
+			const float dz = std::max(std::max(b.min.z - l.z, l.z - b.max.z), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= l.w * l.w) touching.push_back(i);
+		}
+		return touching;
+	}
+
+	struct Box { glm::vec3 min, max; };
+	std::vector<Box> boxes;
+};
+
+int checkLightClusters()
+{
+	const float fovY = glm::radians(60.0f), aspectRatio = 16.0f / 9.0f, nearPlane = 0.5f, farPlane = 200.0f;
+	const float tanHalfFovY = std::tan(fovY * 0.5f), tanHalfFovX = tanHalfFovY * aspectRatio;
+
+	LightClusters clusters;
+	clusters.setProjection(fovY, aspectRatio, nearPlane, farPlane);
+	const ReferenceFroxels reference(fovY, aspectRatio, nearPlane, farPlane);
+
+	// not multiples of 4 too: the SSE loop pads the lights of each slice
+	const unsigned int lightCounts[] = { 0, 1, 3, 5, 63, 64, 65, 130, 257, 1001 };
+	const unsigned int threadCounts[] = { 1, 4 };
+
+	int result = 0;
+	srand(1);
+	for (unsigned int lightCount : lightCounts)
+	for (unsigned int threadCount : threadCounts) {
+		// in (and around) the frustum; small ones inside a slice, big ones across many of them
+		std::vector<glm::vec4> lights(lightCount);
+		for (glm::vec4& l : lights) {
+			const float depth = nearPlane * std::pow(farPlane / nearPlane, randomIn(-0.05f, 1.05f));
+			const float radius = rand() % 4 == 0 ? depth * randomIn(0.2f, 1.0f) : depth * randomIn(0.001f, 0.05f);
+			l = glm::vec4(randomIn(-1.2f, 1.2f) * depth * tanHalfFovX, randomIn(-1.2f, 1.2f) * depth * tanHalfFovY, -depth, radius);
+		}
+
+		clusters.bin(lights.data(), lightCount, threadCount);
+
+		size_t mismatches = 0, references = 0;
+		for (unsigned int c = 0; c < LightClusters::CLUSTER_COUNT; ++c) {
+			const ClusterRange& range = clusters.ranges[c];
+			std::vector<uint32_t> binned(clusters.lightIndices.begin() + range.offset, clusters.lightIndices.begin() + range.offset + range.count);
+			std::sort(binned.begin(), binned.end());
+
+			const std::vector<uint32_t> expected = reference.lightsOf(c, lights);
+			references += expected.size();
+			if (binned != expected) ++mismatches;
+		}
+
+		// a point inside a light (and in the frustum) is in a cluster which lists the light:
+		// the shaders (see clusterOf) would light it
+		size_t points = 0, missed = 0;
+		for (uint32_t i = 0; i < lightCount; ++i)
+		for (int k = 0; k < 8; ++k) {
+			const glm::vec4& l = lights[i];
+			const glm::vec3 offset = glm::vec3(randomIn(-1.0f, 1.0f), randomIn(-1.0f, 1.0f), randomIn(-1.0f, 1.0f));
+			const glm::vec3 p = glm::vec3(l.x, l.y, l.z) + offset * (0.5f * l.w); // within 0.87 radius: clear of rounding at the borders
+			const float depth = -p.z;
+			if (depth < nearPlane || depth > farPlane) continue;
+			const float ndcX = p.x / (depth * tanHalfFovX), ndcY = p.y / (depth * tanHalfFovY);
+			if (std::abs(ndcX) > 1.0f || std::abs(ndcY) > 1.0f) continue;
+
+			++points;
+			const ClusterRange& range = clusters.ranges[clusters.clusterOf(ndcX, ndcY, depth)];
+			const auto first = clusters.lightIndices.begin() + range.offset;
+			if (std::find(first, first + range.count, i) == first + range.count) ++missed;
+		}
+
+		cout << lightCount << " lights, " << threadCount << " threads: " << clusters.lightIndices.size() << " indices ("
+			 << references << " expected), " << mismatches << " clusters differ, " << missed << " of " << points << " points not lit\n";
+		if (mismatches != 0 || missed != 0 || clusters.lightIndices.size() != references) result = 1;
+	}
+
+	if (result != 0) cout << "MISMATCH\n";
+	return result;
+}
+
+/*		G-buffer encoding		*/
+
+// the worst errors tolerated: a RG16 octahedral normal is off by some hundredths of a degree (the most
+// where the octahedron folds), a log2 exponent in 8 bits by half a step of log2(GBUFFER_MAX_SPECULAR_EXPONENT) / 255
+static constexpr float MAX_NORMAL_ERROR_DEGREES = 0.05f;
+static constexpr float MAX_SPECULAR_EXPONENT_RELATIVE_ERROR = 0.02f;
+
+static glm::vec3 roundTripNormal(const glm::vec3& n)
+{
+	const glm::vec2 encoded = encodeOctahedralNormal(n);
+	return decodeOctahedralNormal(glm::vec2(quantizeUnorm(encoded.x, 16), quantizeUnorm(encoded.y, 16)));
+}
+
+int checkGBufferEncoding()
+{
+	// random directions, and the ones where the octahedron folds: the axes, the diagonals, the equator
+	std::vector<glm::vec3> normals;
+	srand(1);
+	for (int i = 0; i < 200000; ++i) {
+		glm::vec3 n(randomIn(-1.0f, 1.0f), randomIn(-1.0f, 1.0f), randomIn(-1.0f, 1.0f));
+		if (glm::length(n) > 1e-3f) normals.push_back(glm::normalize(n));
+	}
+	for (int x = -1; x <= 1; ++x)
+	for (int y = -1; y <= 1; ++y)
+	for (int z = -1; z <= 1; ++z) {
+		if (x != 0 || y != 0 || z != 0) normals.push_back(glm::normalize(glm::vec3(x, y, z)));
+	}
+	for (int i = 0; i < 360; ++i) {
+		const float a = glm::radians(float(i));
+		normals.push_back(glm::vec3(std::cos(a), std::sin(a), 0.0f));
+		normals.push_back(glm::normalize(glm::vec3(std::cos(a), std::sin(a), -1e-4f)));
+	}
+
+	float maxNormalError = 0.0f;
+	for (const glm::vec3& n : normals) {
+		const float cosine = std::min(std::max(glm::dot(n, roundTripNormal(n)), -1.0f), 1.0f);
+		maxNormalError = std::max(maxNormalError, std::acos(cosine) * 180.0f / glm::pi<float>());
+	}
+
+	float maxExponentError = 0.0f;
+	for (float exponent = 1.0f; exponent <= GBUFFER_MAX_SPECULAR_EXPONENT; exponent *= 1.01f) {
+		const float decoded = decodeSpecularExponent(quantizeUnorm(encodeSpecularExponent(exponent), 8));
+		maxExponentError = std::max(maxExponentError, std::abs(decoded - exponent) / exponent);
+	}
+
+	cout << "normals: " << normals.size() << " round trips, worst " << maxNormalError << " degrees (at most " << MAX_NORMAL_ERROR_DEGREES << ")\n";
+	cout << "specular exponents: worst " << maxExponentError * 100.0f << "% (at most " << MAX_SPECULAR_EXPONENT_RELATIVE_ERROR * 100.0f << "%)\n";
+
+	if (maxNormalError > MAX_NORMAL_ERROR_DEGREES || maxExponentError > MAX_SPECULAR_EXPONENT_RELATIVE_ERROR) {
+		cout << "OUT OF BOUNDS\n";
+		return 1;
+	}
+	return 0;
+}
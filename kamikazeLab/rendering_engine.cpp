@@ -5,7 +5,7 @@
  *
  */
 
-#include<Windows.h>
+#include<Windows.h> // (and its min/max macros: hence the (std::min)/(std::max) below)
 
  // We use OpenGL (with glew) but the rest of the code is fairly independent from this.
  // It should be trivial to switch to, e.g., directX
@@ -15,6 +15,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/random.hpp>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
 #include "transform.h"
 #include "phys_object.h"
 #include "custom_classes.h"
@@ -29,36 +33,313 @@
 #include "SSAO_material.h"
 #include "SSAO_renderer.h"
 #include "SSAO_map.h"
+#include "SSAO_resampling_materials.h"
+#include "SSAO_temporal_material.h"
 #include "edge_preserving_blur_material.h"
 #include "texture_cube.h"
 #include "skybox_material.h"
 #include "skybox_renderer.h"
 #include "render_path.h"
+#include "scene_rendering.h"
+#include "scene_snapshot.h"
+#include "uniform_ring.h"
+#include "render_queue.h"
+#include "gl_state_cache.h"
+#include "gl_diagnostics.h"
+#include "frustum.h"
+#include "clustered_lighting.h"
+#include "gbuffer_encoding.h"
+
+/*		GlDiagnostics		*/
+
+#ifdef NDEBUG
+GlDiagnostics g_glDiagnostics = GlDiagnostics::OFF;
+#else
+GlDiagnostics g_glDiagnostics = GlDiagnostics::CHECK_EVERY_CALL;
+#endif
+
+GlDiagnosticsCounters g_glDiagnosticsCounters;
+
+bool parseGlDiagnostics(const char* name, GlDiagnostics& diagnostics)
+{
+	const std::string n = name;
+	if (n == "off") diagnostics = GlDiagnostics::OFF;
+	else if (n == "callback") diagnostics = GlDiagnostics::DEBUG_CALLBACK;
+	else if (n == "check") diagnostics = GlDiagnostics::CHECK_EVERY_CALL;
+	else return false;
+	return true;
+}
+
+void GlDiagnosticsCounters::reset()
+{
+	checkedCalls = 0;
+	checkSeconds = 0;
+	debugMessages = 0;
+}
+
+static void APIENTRY onOpenGLDebugMessage(GLenum /*source*/, GLenum type, GLuint /*id*/, GLenum severity, GLsizei /*length*/, const GLchar* message, const void* /*userParam*/)
+{
+	if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+	{
+		return;
+	}
+
+	++g_glDiagnosticsCounters.debugMessages;
+
+	OutputDebugString(message);
+	OutputDebugString("\n");
+
+	assert(type != GL_DEBUG_TYPE_ERROR);
+}
+
+#if !defined(NDEBUG) || defined(GL_CALL_CHECKS)
+
+static bool checkEveryCall = false; //set by initRendering, from g_glDiagnostics
+
+static GLenum timedGetError()
+{
+	const auto start = std::chrono::steady_clock::now();
+	const GLenum error = glGetError();
+	g_glDiagnosticsCounters.checkSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return error;
+}
 
 static void clearOpenGLErrors()
 {
-	glGetError();
+	while (timedGetError() != GL_NO_ERROR);
 }
 
 static void checkOpenGLErrors()
 {
+	++g_glDiagnosticsCounters.checkedCalls;
+
 	GLenum error;
-	if ((error = glGetError()) != GL_NO_ERROR)
+	if ((error = timedGetError()) != GL_NO_ERROR)
 	{
+		OutputDebugString(reinterpret_cast<const char*>(glewGetErrorString(error)));
 		assert(false);
 	}
 }
 
-#define OPENGL_CALL(x) clearOpenGLErrors(); (x); checkOpenGLErrors()
+#define OPENGL_CALL(x) do { if (checkEveryCall) { clearOpenGLErrors(); (x); checkOpenGLErrors(); } else { (x); } } while (false)
+
+#else
+
+#define OPENGL_CALL(x) (x)
+
+#endif
+
+/*		GlStateCache		*/
+
+GlStateCache g_glState;
+
+void GlStateCache::invalidate()
+{
+	programId = UNKNOWN;
+	vertexArrayId = UNKNOWN;
+	for (BufferRange& range : uniformBufferRanges)
+	{
+		range = BufferRange{ UNKNOWN, UNKNOWN, UNKNOWN };
+	}
+	for (BufferRange& range : storageBufferRanges)
+	{
+		range = BufferRange{ UNKNOWN, UNKNOWN, UNKNOWN };
+	}
+	activeTextureUnit = UNKNOWN;
+	for (unsigned int unit = 0; unit < TEXTURE_UNIT_COUNT; ++unit)
+	{
+		textures2D[unit] = UNKNOWN;
+		texturesCubeMap[unit] = UNKNOWN;
+	}
+	frameBufferObjectId = UNKNOWN;
+	blendEnabled = UNKNOWN;
+	depthTestEnabled = UNKNOWN;
+	depthFunction = UNKNOWN;
+	blendMode = UNKNOWN;
+	for (unsigned int& factor : blendFactors)
+	{
+		factor = UNKNOWN;
+	}
+}
+
+bool GlStateCache::same(unsigned int& cached, unsigned int value)
+{
+	if (cached == value)
+	{
+		++counters.elided;
+		return true;
+	}
+
+	cached = value;
+	++counters.issued;
+	return false;
+}
+
+void GlStateCache::useProgram(unsigned int _programId)
+{
+	if (!same(programId, _programId))
+	{
+		OPENGL_CALL(glUseProgram(_programId));
+	}
+}
+
+void GlStateCache::bindVertexArray(unsigned int _vertexArrayId)
+{
+	if (!same(vertexArrayId, _vertexArrayId))
+	{
+		OPENGL_CALL(glBindVertexArray(_vertexArrayId));
+	}
+}
+
+void GlStateCache::bindBufferRange(unsigned int target, BufferRange* cachedRanges, unsigned int cachedCount,
+									unsigned int bindingIndex, unsigned int bufferId, unsigned int offset, unsigned int size)
+{
+	if (bindingIndex < cachedCount)
+	{
+		BufferRange& range = cachedRanges[bindingIndex];
+		if (range.bufferId == bufferId && range.offset == offset && range.size == size)
+		{
+			++counters.elided;
+			return;
+		}
+		range = BufferRange{ bufferId, offset, size };
+	}
+
+	++counters.issued;
+	OPENGL_CALL(glBindBufferRange(target, bindingIndex, bufferId, offset, size));
+}
+
+void GlStateCache::bindUniformBufferRange(unsigned int bindingIndex, unsigned int bufferId, unsigned int offset, unsigned int size)
+{
+	bindBufferRange(GL_UNIFORM_BUFFER, uniformBufferRanges, UNIFORM_BINDING_COUNT, bindingIndex, bufferId, offset, size);
+}
+
+void GlStateCache::bindShaderStorageBufferRange(unsigned int bindingIndex, unsigned int bufferId, unsigned int offset, unsigned int size)
+{
+	bindBufferRange(GL_SHADER_STORAGE_BUFFER, storageBufferRanges, STORAGE_BINDING_COUNT, bindingIndex, bufferId, offset, size);
+}
+
+void GlStateCache::activeTexture(unsigned int unit)
+{
+	if (!same(activeTextureUnit, unit))
+	{
+		OPENGL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
+	}
+}
+
+void GlStateCache::bindTexture(unsigned int target, unsigned int textureId)
+{
+	unsigned int* cached = nullptr;
+	if (activeTextureUnit < TEXTURE_UNIT_COUNT)
+	{
+		if (target == GL_TEXTURE_2D) cached = &textures2D[activeTextureUnit];
+		else if (target == GL_TEXTURE_CUBE_MAP) cached = &texturesCubeMap[activeTextureUnit];
+	}
+
+	if (cached == nullptr)
+	{
+		++counters.issued;
+		OPENGL_CALL(glBindTexture(target, textureId));
+	}
+	else if (!same(*cached, textureId))
+	{
+		OPENGL_CALL(glBindTexture(target, textureId));
+	}
+}
+
+void GlStateCache::bindTextureUnit(unsigned int unit, unsigned int target, unsigned int textureId)
+{
+	activeTexture(unit);
+	bindTexture(target, textureId);
+}
+
+void GlStateCache::bindFramebuffer(unsigned int _frameBufferObjectId)
+{
+	if (!same(frameBufferObjectId, _frameBufferObjectId))
+	{
+		OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, _frameBufferObjectId));
+	}
+}
+
+void GlStateCache::setCapability(unsigned int capability, bool enabled)
+{
+	unsigned int* cached = capability == GL_BLEND ? &blendEnabled :
+		capability == GL_DEPTH_TEST ? &depthTestEnabled : nullptr;
+
+	if (cached != nullptr && same(*cached, enabled))
+	{
+		return;
+	}
+	if (cached == nullptr)
+	{
+		++counters.issued;
+	}
+
+	if (enabled)
+	{
+		OPENGL_CALL(glEnable(capability));
+	}
+	else
+	{
+		OPENGL_CALL(glDisable(capability));
+	}
+}
+
+void GlStateCache::enable(unsigned int capability)
+{
+	setCapability(capability, true);
+}
+
+void GlStateCache::disable(unsigned int capability)
+{
+	setCapability(capability, false);
+}
+
+void GlStateCache::depthFunc(unsigned int func)
+{
+	if (!same(depthFunction, func))
+	{
+		OPENGL_CALL(glDepthFunc(func));
+	}
+}
+
+void GlStateCache::blendEquation(unsigned int mode)
+{
+	if (!same(blendMode, mode))
+	{
+		OPENGL_CALL(glBlendEquation(mode));
+	}
+}
+
+void GlStateCache::blendFuncSeparate(unsigned int srcRgb, unsigned int dstRgb, unsigned int srcAlpha, unsigned int dstAlpha)
+{
+	if (blendFactors[0] == srcRgb && blendFactors[1] == dstRgb && blendFactors[2] == srcAlpha && blendFactors[3] == dstAlpha)
+	{
+		++counters.elided;
+		return;
+	}
+
+	blendFactors[0] = srcRgb;
+	blendFactors[1] = dstRgb;
+	blendFactors[2] = srcAlpha;
+	blendFactors[3] = dstAlpha;
+	++counters.issued;
+	OPENGL_CALL(glBlendFuncSeparate(srcRgb, dstRgb, srcAlpha, dstAlpha));
+}
 
 /*		CpuMesh		*/
 
 GpuMesh CpuMesh::uploadToGPU()const
+{
+	return view().uploadToGPU();
+}
+
+GpuMesh CpuMeshView::uploadToGPU()const
 {
 	GpuMesh res;
 
 	OPENGL_CALL(glGenVertexArrays(1, &res.vertexArrayId));
-	OPENGL_CALL(glBindVertexArray(res.vertexArrayId));
+	g_glState.bindVertexArray(res.vertexArrayId);
 
 	//vertices
 
@@ -66,8 +347,8 @@ GpuMesh CpuMesh::uploadToGPU()const
 	
 	OPENGL_CALL(glNamedBufferData(
 		res.geomBufferId, // a buffer containing vertices
-		sizeof(Vertex)*verts.size(), // how many bytes to copy on GPU
-		&(verts[0]), // location in CPU of the data to copy on GPU
+		sizeof(Vertex)*vertexCount, // how many bytes to copy on GPU
+		verts, // location in CPU of the data to copy on GPU
 		GL_STATIC_DRAW // please know that this buffer is readonly!
 	));
 
@@ -92,23 +373,33 @@ GpuMesh CpuMesh::uploadToGPU()const
 	OPENGL_CALL(glEnableVertexAttribArray(2));
 	OPENGL_CALL(glEnableVertexAttribArray(3));
 
+	//per instance: the world matrix, a column per attribute (4 to 7), from binding 1
+	//(enabled by bindInstances: meshes which are never instanced have no buffer there)
+	for (int column = 0; column < 4; ++column)
+	{
+		OPENGL_CALL(glVertexAttribFormat(4 + column, 4, GL_FLOAT, GL_FALSE, column * sizeof(glm::vec4)));
+		OPENGL_CALL(glVertexAttribBinding(4 + column, 1));
+	}
+	OPENGL_CALL(glVertexBindingDivisor(1, 1));
+
 	//elements
 
 	OPENGL_CALL(glCreateBuffers(1, &res.connBufferId));
 
 	OPENGL_CALL(glNamedBufferData(
 		res.connBufferId, // a buffer containing vertex indices
-		sizeof(Tri)*tris.size(),
-		&(tris[0]),
+		sizeof(Tri)*triCount,
+		tris,
 		GL_STATIC_DRAW
 	));
 
-	res.nElements = tris.size() * 3;
+	res.nElements = static_cast<int>(triCount * 3);
+	res.boundingSphere = boundingSphere;
 
 	OPENGL_CALL(glBindBuffer(GL_ARRAY_BUFFER, res.geomBufferId));
 	OPENGL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, res.connBufferId));
 
-	OPENGL_CALL(glBindVertexArray(0));
+	g_glState.bindVertexArray(0);
 
 	OPENGL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
 	OPENGL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
@@ -120,7 +411,7 @@ GpuMesh CpuMesh::uploadToGPU()const
 
 void GpuMesh::bind()const
 {
-	OPENGL_CALL(glBindVertexArray(vertexArrayId));
+	g_glState.bindVertexArray(vertexArrayId);
 }
 
 void GpuMesh::render() const
@@ -128,15 +419,31 @@ void GpuMesh::render() const
 	OPENGL_CALL(glDrawElements(GL_TRIANGLES, nElements, GL_UNSIGNED_INT, 0));
 }
 
+void GpuMesh::bindInstances(const UniformRange& worlds)const
+{
+	OPENGL_CALL(glVertexArrayVertexBuffer(vertexArrayId, 1, worlds.bufferId, worlds.offset, sizeof(glm::mat4)));
+
+	for (int column = 0; column < 4; ++column)
+	{
+		OPENGL_CALL(glEnableVertexArrayAttrib(vertexArrayId, 4 + column));
+	}
+}
+
+void GpuMesh::renderInstanced(unsigned int firstInstance, unsigned int instanceCount) const
+{
+	OPENGL_CALL(glDrawElementsInstancedBaseInstance(GL_TRIANGLES, nElements, GL_UNSIGNED_INT, 0, instanceCount, firstInstance));
+}
+
 void GpuMesh::release()
 {
 	if (vertexArrayId != INVALID_GRAPHICS_RESOURCE_ID)
 	{
-		OPENGL_CALL(glBindVertexArray(vertexArrayId));
+		g_glState.bindVertexArray(vertexArrayId);
 		OPENGL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
 		OPENGL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-		OPENGL_CALL(glBindVertexArray(0));
+		g_glState.bindVertexArray(0);
 		OPENGL_CALL(glDeleteVertexArrays(1, &vertexArrayId));
+		g_glState.invalidate();
 	}
 
 	if (geomBufferId != INVALID_GRAPHICS_RESOURCE_ID)
@@ -161,7 +468,7 @@ GpuTexture CpuTexture::uploadToGPU() const
 	GpuTexture res;
 	OPENGL_CALL(glGenTextures(1, &res.textureId));
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, res.textureId));
+	g_glState.bindTexture(GL_TEXTURE_2D, res.textureId);
 
 	GLint internalFormat = isLinear ? GL_RGB : GL_SRGB;
 
@@ -194,7 +501,7 @@ GpuTexture CpuTexture::uploadToGPU() const
 	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT));
 	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT));
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+	g_glState.bindTexture(GL_TEXTURE_2D, 0);
 
 	return res;
 }
@@ -204,7 +511,7 @@ GpuTexture CpuTexture::uploadToGPU() const
 
 void GpuTexture::bind() const
 {
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, textureId));
+	g_glState.bindTexture(GL_TEXTURE_2D, textureId);
 }
 
 void GpuTexture::release()
@@ -212,6 +519,7 @@ void GpuTexture::release()
 	if (textureId != INVALID_GRAPHICS_RESOURCE_ID)
 	{
 		OPENGL_CALL(glDeleteTextures(1, &textureId));
+		g_glState.invalidate();
 		textureId = INVALID_GRAPHICS_RESOURCE_ID;
 	}
 }
@@ -223,7 +531,7 @@ GpuTextureCube CpuTextureCube::uploadToGPU() const
 	GpuTextureCube res;
 	OPENGL_CALL(glGenTextures(1, &res.textureId));
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, res.textureId));
+	g_glState.bindTexture(GL_TEXTURE_CUBE_MAP, res.textureId);
 
 	GLint internalFormat = isLinear ? GL_RGB : GL_SRGB;
 	
@@ -259,7 +567,7 @@ GpuTextureCube CpuTextureCube::uploadToGPU() const
 	OPENGL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
 	OPENGL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+	g_glState.bindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
 	return res;
 }
@@ -376,7 +684,7 @@ GpuProgram CpuProgram::uploadToGPU() const
 void GpuProgram::bind()const
 {
 	assert(programId != INVALID_GRAPHICS_RESOURCE_ID);
-	OPENGL_CALL(glUseProgram(programId));
+	g_glState.useProgram(programId);
 }
 
 void GpuProgram::release()
@@ -385,6 +693,7 @@ void GpuProgram::release()
 	{
 		//TODO: be sure program.programId is not the currently used program
 		OPENGL_CALL(glDeleteProgram(programId));
+		g_glState.invalidate();
 		programId = INVALID_GRAPHICS_RESOURCE_ID;
 	}
 }
@@ -413,32 +722,20 @@ glm::mat4 Transform::getModelMatrix()const
 	return m;
 }
 
-/*		PhysObject		*/
+/*		RenderObject		*/
 
-void PhysObject::setAccumulatedTransform(glm::mat4& accumulatedTransform)const
+static glm::mat4 accumulateTransforms(const Transform& t, const MeshComponent& meshComponent)
 {
+	glm::mat4 accumulatedTransform;
 	t.setModelMatrix(accumulatedTransform);
 
 	glm::mat4 meshComponentModelMatrix;
 	meshComponent.t.setModelMatrix(meshComponentModelMatrix);
 
 	accumulatedTransform *= meshComponentModelMatrix;
-}
-
-glm::mat4 PhysObject::getAccumulatedTransform()const
-{
-	glm::mat4 accumulatedTransform;
-	setAccumulatedTransform(accumulatedTransform);
 	return accumulatedTransform;
 }
 
-void PhysObject::setCameraInside(glm::mat4& out)const
-{
-	glm::vec3 up{ 0.0f, 0.0f, 1.0f };
-	glm::vec3 cameraPos = t.pos + up*1.2f;
-	out = glm::lookAt(cameraPos, t.pos + t.forward()*4.0f, up);
-}
-
 /*		Camera		*/
 
 void Camera::computeViewFromTransform()
@@ -447,6 +744,14 @@ void Camera::computeViewFromTransform()
 	transform.inverse().setModelMatrix(viewTransform);
 }
 
+void Camera::computeViewInside(const PhysObject& physObject)
+{
+	const Transform& t = physObject.t;
+	glm::vec3 up{ 0.0f, 0.0f, 1.0f };
+	glm::vec3 cameraPos = t.pos + up*1.2f;
+	viewTransform = glm::lookAt(cameraPos, t.pos + t.forward()*4.0f, up);
+}
+
 void Camera::computeInvView()
 {
 	invViewTransform = glm::inverse(viewTransform);
@@ -459,6 +764,7 @@ void Camera::computeInvProj()
 
 void Camera::computeProjectionView()
 {
+	prevProjectionViewTransform = projectionViewTransform;
 	projectionViewTransform = projectionTransform * viewTransform;
 }
 
@@ -474,8 +780,11 @@ void Camera::setProjectionParams(float _fovY, float _aspectRatio, float _nearPla
 
 /*		Scene		*/
 
+//room for the uniform blocks of a frame (the ring enlarges itself if a frame needs more)
+static constexpr unsigned int UNIFORM_RING_FRAME_SIZE = 1024 * 1024;
+
 /* metodo globale che disegna la scena */
-void rendering()
+void rendering(const SceneSnapshot& snapshot, float alpha)
 {
 	OPENGL_CALL(glViewport(0, 0, windowWidth, windowHeight));
 
@@ -483,7 +792,15 @@ void rendering()
 
 	OPENGL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
-	scene.render();
+	g_glState.invalidate();
+	g_glState.counters = GlStateCache::Counters{};
+	g_glDiagnosticsCounters.reset();
+
+	g_uniformRing.beginFrame();
+
+	sceneRendering.render(snapshot, alpha);
+
+	g_uniformRing.endFrame();
 }
 
 /* metodo globale che inizializza il sistema grafico */
@@ -494,14 +811,158 @@ void initRendering()
 	//"OpenGL 4.5 is required"
 	assert(GLEW_VERSION_4_5);
 
-	OPENGL_CALL(glEnable(GL_DEPTH_TEST));
-	OPENGL_CALL(glDepthFunc(GL_LEQUAL));
+#if !defined(NDEBUG) || defined(GL_CALL_CHECKS)
+	checkEveryCall = (g_glDiagnostics == GlDiagnostics::CHECK_EVERY_CALL);
+#else
+	if (g_glDiagnostics == GlDiagnostics::CHECK_EVERY_CALL)
+	{
+		g_glDiagnostics = GlDiagnostics::DEBUG_CALLBACK; //not compiled in
+	}
+#endif
+
+	if (g_glDiagnostics == GlDiagnostics::DEBUG_CALLBACK)
+	{
+		OPENGL_CALL(glEnable(GL_DEBUG_OUTPUT));
+		OPENGL_CALL(glDebugMessageCallback(onOpenGLDebugMessage, nullptr));
+	}
+
+	g_glState.enable(GL_DEPTH_TEST);
+	g_glState.depthFunc(GL_LEQUAL);
 
 	OPENGL_CALL(glEnable(GL_FRAMEBUFFER_SRGB));
+
+	g_uniformRing.init(UNIFORM_RING_FRAME_SIZE);
+}
+
+
+/*		SceneRendering		*/
+
+SceneRendering sceneRendering;
+
+SceneRendering::SceneRendering() = default;
+SceneRendering::~SceneRendering() = default;
+
+static void getMaterialAssets(MeshComponent& meshComponent, const std::string& meshName,
+							   const std::string& diffuseMapName,
+							   const std::string& normalMapName,
+							   const std::string& specularMapName)
+{
+	if (g_meshLibrary.exists(meshName))
+	{
+		meshComponent.mesh = g_meshLibrary.get(meshName);
+	}
+	if (g_textureLibrary.exists(diffuseMapName))
+	{
+		meshComponent.material.diffuseMap = g_textureLibrary.get(diffuseMapName);
+	}
+	if (g_textureLibrary.exists(normalMapName))
+	{
+		meshComponent.material.normalMap = g_textureLibrary.get(normalMapName);
+	}
+	if (g_textureLibrary.exists(specularMapName))
+	{
+		meshComponent.material.specularMap = g_textureLibrary.get(specularMapName);
+	}
 }
 
+static const quat shipLookOrientation = quat(-sqrt(2.0f) / 2.0f, 0, 0, sqrt(2.0f) / 2.0f);
+
+//the point lights of the scenery: one per ship, then the arena's
+static constexpr int SCENERY_POINT_LIGHT_COUNT = 10;
+
+void SceneRendering::initAsNewGame()
+{
+	// the only time the Scene is read: before the simulation thread starts
+	arenaRadius = scene.arenaRadius;
+
+	renderObjects.clear();
+	renderObjects.reserve(scene.ships.size() + scene.bullets.capacity() + 1);
+
+	shipLooks.resize(scene.ships.size());
+
+	for (MeshComponent& shipLook : shipLooks)
+	{
+		getMaterialAssets(shipLook, "ShipMesh", "ShipDiffuseMap", "ShipNormalMap", "ShipSpecularMap");
+
+		shipLook.material.setSpecularExponent(80.0f);
+		shipLook.material.setSpecularColor(glm::vec3{ 1.0f, 1.0f, 1.0f });
+
+		// let set a tranform manually to adapt the ship asset to our needs
+		shipLook.t.setIde();
+		shipLook.t.scale = 0.05f;
+		shipLook.t.ori = shipLookOrientation;
+	}
+
+	bulletLook.reset(new MeshComponent{});
+	getMaterialAssets(*bulletLook, "BulletMesh", "BulletDiffuseMap", "BulletNormalMap", "BulletSpecularMap");
+
+	bulletLook->material.setSpecularExponent(40.0f);
+	bulletLook->material.setSpecularColor(glm::vec3{ 0.2f, 0.2f, 0.2f });
+
+	// let set a tranform manually to adapt the bullet asset to our needs
+	bulletLook->t.scale = 0.5f;
+
+	floorLook.reset(new MeshComponent{});
+	getMaterialAssets(*floorLook, "FloorMesh", "FloorDiffuseMap", "FloorNormalMap", "FloorSpecularMap");
+
+	floorLook->material.setTextCoordScale(glm::vec2{ 4.0f, 4.0f });
+	floorLook->material.setSpecularExponent(28.0f);
+	floorLook->material.setSpecularColor(glm::vec3{ 0.2f, 0.2f, 0.2f });
+
+	floorLook->t.ori = glm::angleAxis(glm::pi<float>()*0.5f, glm::vec3{ 1.0f, 0.0f, 0.0f });
+	floorLook->t.scale = 2.0f*arenaRadius;
+
+	floorTransform.setIde();
+	floorTransform.pos = glm::vec3{ 0.0f, 0.0f, -1.2f };
+
+	camera.setProjectionParams(glm::pi<float>() * 0.45f, static_cast<float>(windowWidth) / windowHeight, 1.0f, 100.0f);
+	camera.computeInvProj();
+	camera.viewTransform = glm::mat4();
+
+	lighting.reset(new SceneLighting{});
+	lighting->ambientLight = glm::vec3(0.1f, 0.1f, 0.1f);
+		
+	lighting->directionalLights[0].color = glm::vec3{ 0.5f, 0.5f, 0.5f };
+	lighting->directionalLights[0].direction = glm::normalize(glm::vec3{ -0.5f, 0.0f, -1.0f });
+	
+	lighting->pointLights.resize(SCENERY_POINT_LIGHT_COUNT);
+
+	constexpr float arenaLightsRadius = 4.0f;
+	lighting->pointLights[2].positionAndRadius = glm::vec4{ -arenaRadius, arenaRadius, 0.0f, arenaLightsRadius};
+	lighting->pointLights[3].positionAndRadius = glm::vec4{ 0.0f, arenaRadius, 0.0f, arenaLightsRadius };
+	lighting->pointLights[4].positionAndRadius = glm::vec4{ arenaRadius, arenaRadius, 0.0f, arenaLightsRadius };
+	lighting->pointLights[5].positionAndRadius = glm::vec4{ -arenaRadius, 0.0f, 0.0f, arenaLightsRadius };
+	lighting->pointLights[6].positionAndRadius = glm::vec4{ arenaRadius, 0.0f, 0.0f, arenaLightsRadius };
+	lighting->pointLights[7].positionAndRadius = glm::vec4{ -arenaRadius, -arenaRadius, 0.0f, arenaLightsRadius };
+	lighting->pointLights[8].positionAndRadius = glm::vec4{ 0.0f, -arenaRadius, 0.0f, arenaLightsRadius };
+	lighting->pointLights[9].positionAndRadius = glm::vec4{ arenaRadius, -arenaRadius, 0.0f, arenaLightsRadius };
+
+	//ships' lights
+	for (int i = 0; i < 2; ++i)
+	{
+		lighting->pointLights[i].color = glm::vec3{ 1.0f, 0.0f, 0.0f };
+		lighting->pointLights[i].attenuation = glm::vec3{ 0.0f, 1.0f, 0.0f }; //linear attenuation
+	}
+
+	//arena's lights
+	for (int i = 2; i < SCENERY_POINT_LIGHT_COUNT; ++i)
+	{
+		lighting->pointLights[i].color = glm::vec3{ 1.0f, 1.0f, 0.0f };
+		lighting->pointLights[i].attenuation = glm::vec3{0.0f, 1.0f, 0.0f}; //linear attenuation
+	}
+	
+#ifdef FORWARD_RENDER
+	forwardRenderer.reset(new ForwardRenderer{});
+#else
+	deferredRenderer.reset(new DeferredRenderer{});
+#endif
+
+	shadowMapRenderer.reset(new ShadowMapRenderer{});
+	skyBoxRenderer.reset(new SkyBoxRenderer{});
+	skyBoxRenderer->skyBoxMaterial.skyBox = g_textureCubeLibrary.get("SkyBox");	
+}
 
-glm::mat4 Scene::cameraOnTwoObjects(const PhysObject& a, const PhysObject& b)
+glm::mat4 SceneRendering::cameraOnTwoObjects(const PhysObject& a, const PhysObject& b)
 {
 	vec3 center = (a.t.pos + b.t.pos)*0.5f;
 	float radius = length(a.t.pos - b.t.pos) / 2.0f + 2.0f;
@@ -510,10 +971,18 @@ glm::mat4 Scene::cameraOnTwoObjects(const PhysObject& a, const PhysObject& b)
 		* glm::translate(glm::vec3{ -center.x, -center.y, -center.z });
 }
 
-void Scene::render()
+void SceneRendering::render(const SceneSnapshot& snapshot, float alpha)
 {
-	glm::vec3 center = (ships[0].t.pos + ships[1].t.pos)*0.5f;
-	float radius = length(ships[0].t.pos - ships[1].t.pos) / 2.0f + 2.0f;
+	const std::vector<ShipSnapshot>& ships = snapshot.ships;
+
+	shipTransforms.resize(ships.size());
+	for (size_t i = 0; i < ships.size(); ++i)
+	{
+		shipTransforms[i] = mix(ships[i].prevT, ships[i].t, alpha);
+	}
+
+	glm::vec3 center = (shipTransforms[0].pos + shipTransforms[1].pos)*0.5f;
+	float radius = length(shipTransforms[0].pos - shipTransforms[1].pos) / 2.0f + 2.0f;
 
 	const float cameraHalfFovY = camera.fovY * 0.5f;
 	float cameraZ = radius / tan(cameraHalfFovY);
@@ -522,54 +991,320 @@ void Scene::render()
 	camera.computeViewFromTransform();
 
 	//TODO
-	//ships[0].setCameraInside(camera.viewTransform);
+	//camera.computeViewInside(ships[0]);
 
 	camera.computeInvView();
 	camera.computeProjectionView();
 
+	for (size_t i = 0; i < ships.size(); ++i)
+	{
+		shipLooks[i].t.ori = glm::angleAxis(ships[i].rollAngle, vec3(0, -1, 0)) * shipLookOrientation;
+	}
+
 	for (int i = 0; i < 2; ++i)
 	{
-		glm::vec4 shipPos = ships[i].getAccumulatedTransform()* glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f };
+		glm::vec4 shipPos = accumulateTransforms(shipTransforms[i], shipLooks[i]) * glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f };
 		lighting->pointLights[i].positionAndRadius = glm::vec4{ shipPos.x, shipPos.y, shipPos.z, 8.0f };
 	}
 
-	findVisiblePhysObjects();	
+	findVisibleObjects(snapshot, alpha);
+
+#ifdef FORWARD_RENDER
+	clusteredLighting.update(camera, lighting->pointLights, ClusteredLighting::WORLD_SPACE);
+#else
+	if (g_deferredPointLights == DeferredPointLights::CLUSTERED)
+	{
+		clusteredLighting.update(camera, lighting->pointLights, ClusteredLighting::VIEW_SPACE);
+	}
+#endif
+
+	shadowMapRenderer->updateLightProjectionViews();
+
+	Frustum passFrustums[RenderQueue::PASS_COUNT];
+	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
+	{
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+		{
+			passFrustums[RenderQueue::SHADOW_PASS + i * SHADOW_CASCADE_COUNT + c] = Frustum::fromProjectionView(shadowMapRenderer->dirLightProjectionViews[i][c]);
+		}
+	}
+	passFrustums[RenderQueue::OPAQUE_PASS] = Frustum::fromProjectionView(camera.projectionViewTransform);
+
+	renderQueue.build(renderObjects.data(), renderObjects.size(), passFrustums);
 
-	shadowMapRenderer->render(physObjects.data(), physObjects.size());
+	shadowMapRenderer->render(renderQueue);
 	
 #ifdef FORWARD_RENDER
-	forwardRenderer->render(physObjects.data(), physObjects.size());
+	forwardRenderer->render(renderQueue);
 #else
-	deferredRenderer->render(physObjects.data(), physObjects.size());
+	deferredRenderer->render(renderQueue);
 #endif
 
 	skyBoxRenderer->render();
 }
 
-void Scene::findVisiblePhysObjects()
+void SceneRendering::findVisibleObjects(const SceneSnapshot& snapshot, float alpha)
 {
-	physObjects.clear();
+	renderObjects.clear();
 
-	for (auto& s : ships)
+	for (size_t i = 0; i < shipTransforms.size(); ++i)
 	{
-		physObjects.push_back(&s);
-		for (auto& b : s.bullets)
-		{
-			if (b.alive)
-			{
-				physObjects.push_back(&b);
-			}
-		}
+		renderObjects.push_back(RenderObject{ accumulateTransforms(shipTransforms[i], shipLooks[i]), &shipLooks[i] });
 	}
 
-	physObjects.push_back(floor.get());
-}
+	const std::vector<glm::vec3>& bulletPos = snapshot.bulletPos;
+	const std::vector<glm::vec3>& bulletVel = snapshot.bulletVel;
 
+	//bullets fly straight: where they were at the last step is just behind them
+	const float timeBehind = (1.0f - alpha) * snapshot.stepDuration;
 
-/*		DeferredRenderer		*/
+	for (size_t i = 0; i < bulletPos.size(); ++i)
+	{
+		//a bullet points where it flies
+		Transform t;
+		t.pos = bulletPos[i] - bulletVel[i] * timeBehind;
+		t.ori = glm::angleAxis(std::atan2(-bulletVel[i].x, bulletVel[i].y), glm::vec3{ 0.0f, 0.0f, 1.0f });
 
-static GpuMesh getFullScreenQuad()
-{
+		renderObjects.push_back(RenderObject{ accumulateTransforms(t, *bulletLook), bulletLook.get() });
+	}
+
+	renderObjects.push_back(RenderObject{ accumulateTransforms(floorTransform, *floorLook), floorLook.get() });
+}
+
+
+/*		RenderQueue		*/
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	//FNV-1a
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t looksKey(const MeshComponent& meshComponent)
+{
+	const auto& material = meshComponent.material;
+
+	const unsigned int textureIds[] = { material.diffuseMap.textureId, material.normalMap.textureId, material.specularMap.textureId };
+
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashBytes(hash, textureIds, sizeof(textureIds));
+	hash = hashBytes(hash, &material.objectFragmentShaderUniformBlock, sizeof(material.objectFragmentShaderUniformBlock));
+	return hash & 0xFFFFF;
+}
+
+static uint64_t makeSortKey(RenderQueue::Pass pass, unsigned int programId, uint64_t looks, unsigned int vertexArrayId, unsigned int depth)
+{
+	return (uint64_t(pass) << 60) |
+		(uint64_t(programId & 0xFF) << 52) |
+		(looks << 32) |
+		(uint64_t(vertexArrayId & 0xFFFF) << 16) |
+		uint64_t(depth & 0xFFFF);
+}
+
+void RenderQueue::build(const RenderObject* renderObjects, unsigned int count, const Frustum (&passFrustums)[PASS_COUNT])
+{
+	objects = renderObjects;
+	counters = Counters{};
+
+	const Camera& camera = sceneRendering.camera;
+
+	sphereX.resize(count);
+	sphereY.resize(count);
+	sphereZ.resize(count);
+	sphereRadius.resize(count);
+	visible.resize(count);
+
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const glm::mat4& world = renderObjects[i].world;
+		const glm::vec4 sphere = renderObjects[i].meshComponent->mesh.boundingSphere;
+
+		const glm::vec4 center = world * glm::vec4{ sphere.x, sphere.y, sphere.z, 1.0f };
+		const float scale = (std::max)(glm::length(glm::vec3(world[0])), (std::max)(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+
+		sphereX[i] = center.x;
+		sphereY[i] = center.y;
+		sphereZ[i] = center.z;
+		sphereRadius[i] = sphere.w * scale;
+	}
+
+	items.clear();
+
+	for (int pass = SHADOW_PASS; pass < PASS_COUNT; ++pass)
+	{
+		cullSpheres(passFrustums[pass], sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data(), count, visible.data());
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			if (!visible[i])
+			{
+				++counters.culled;
+				continue;
+			}
+
+			const MeshComponent& meshComponent = *renderObjects[i].meshComponent;
+			const unsigned int vertexArrayId = meshComponent.mesh.vertexArrayId;
+
+			if (pass != OPAQUE_PASS)
+			{
+				//the shadow maps only need the mesh (their program and blocks are the same for all)
+				items.push_back(Item{ makeSortKey(Pass(pass), ShadowMapMaterial::gpuProgram.programId, 0, vertexArrayId, 0), i });
+				continue;
+			}
+
+			//front to back, for the early depth test
+			const float viewDepth = -(camera.viewTransform * renderObjects[i].world[3]).z;
+			const float depth = glm::clamp(viewDepth / camera.farPlane, 0.0f, 1.0f) * 0xFFFF;
+
+			items.push_back(Item{ makeSortKey(OPAQUE_PASS, meshComponent.material.gpuProgram.programId, looksKey(meshComponent), vertexArrayId, static_cast<unsigned int>(depth)), i });
+		}
+	}
+
+	sortItems();
+
+	unsigned int item = 0;
+	for (int pass = 0; pass <= PASS_COUNT; ++pass)
+	{
+		while (item < items.size() && (items[item].key >> 60) < uint64_t(pass))
+		{
+			++item;
+		}
+		passStart[pass] = item;
+	}
+
+	worldsScratch.resize(items.size());
+	for (size_t i = 0; i < items.size(); ++i)
+	{
+		worldsScratch[i] = renderObjects[items[i].object].world;
+	}
+	worlds = g_uniformRing.push(worldsScratch.data(), worldsScratch.size() * sizeof(glm::mat4));
+
+	counters.items = items.size();
+}
+
+void RenderQueue::sortItems()
+{
+	//LSD radix sort, a byte at a time; bytes which are the same in all the keys (often: pass, program) are skipped
+	sortScratch.resize(items.size());
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		unsigned int counts[256] = {};
+		for (const Item& item : items)
+		{
+			++counts[(item.key >> shift) & 0xFF];
+		}
+
+		if (counts[(items.empty() ? 0 : items[0].key >> shift) & 0xFF] == items.size())
+		{
+			continue;
+		}
+
+		unsigned int start = 0;
+		for (unsigned int& c : counts)
+		{
+			const unsigned int n = c;
+			c = start;
+			start += n;
+		}
+
+		for (const Item& item : items)
+		{
+			sortScratch[counts[(item.key >> shift) & 0xFF]++] = item;
+		}
+
+		items.swap(sortScratch);
+	}
+}
+
+void RenderQueue::render(Pass pass)
+{
+	//what is bound now: only what differs from it is bound again
+	unsigned int boundProgramId = INVALID_GRAPHICS_RESOURCE_ID;
+	unsigned int boundVertexArrayId = INVALID_GRAPHICS_RESOURCE_ID;
+	unsigned int boundTextureIds[3] = { INVALID_GRAPHICS_RESOURCE_ID, INVALID_GRAPHICS_RESOURCE_ID, INVALID_GRAPHICS_RESOURCE_ID };
+	const MeshComponent* boundLooks = nullptr;
+
+	const unsigned int end = passEnd(pass);
+
+	counters.unsortedBinds += (end - passBegin(pass)) * (pass != OPAQUE_PASS ? 3 : 7);
+
+	for (unsigned int first = passBegin(pass); first < end;)
+	{
+		MeshComponent& meshComponent = *objects[items[first].object].meshComponent;
+
+		//the batch: the next items with the same mesh and (but for the shadow maps) the same looks
+		unsigned int last = first + 1;
+		while (last < end)
+		{
+			const MeshComponent& next = *objects[items[last].object].meshComponent;
+			if (next.mesh.vertexArrayId != meshComponent.mesh.vertexArrayId ||
+				(pass == OPAQUE_PASS && &next != &meshComponent && !next.material.looksLike(meshComponent.material)))
+			{
+				break;
+			}
+			++last;
+		}
+
+		if (pass == OPAQUE_PASS)
+		{
+			const auto& material = meshComponent.material;
+
+			if (material.gpuProgram.programId != boundProgramId)
+			{
+				material.gpuProgram.bind();
+				boundProgramId = material.gpuProgram.programId;
+				++counters.programBinds;
+			}
+
+			if (boundLooks == nullptr || (boundLooks != &meshComponent && !material.looksLike(boundLooks->material)))
+			{
+				meshComponent.material.updateUniforms();
+				material.bindObjectUniforms();
+				boundLooks = &meshComponent;
+				++counters.uniformBlockBinds;
+			}
+
+			const unsigned int textureIds[3] = { material.diffuseMap.textureId, material.normalMap.textureId, material.specularMap.textureId };
+			for (unsigned int unit = 0; unit < 3; ++unit)
+			{
+				if (textureIds[unit] != boundTextureIds[unit])
+				{
+					assert(textureIds[unit] != INVALID_GRAPHICS_RESOURCE_ID);
+					g_glState.activeTexture(unit);
+					g_glState.bindTexture(GL_TEXTURE_2D, textureIds[unit]);
+					boundTextureIds[unit] = textureIds[unit];
+					++counters.textureBinds;
+				}
+			}
+		}
+
+		if (meshComponent.mesh.vertexArrayId != boundVertexArrayId)
+		{
+			meshComponent.mesh.bind();
+			meshComponent.mesh.bindInstances(worlds);
+			boundVertexArrayId = meshComponent.mesh.vertexArrayId;
+			++counters.vertexArrayBinds;
+		}
+
+		meshComponent.mesh.renderInstanced(first, last - first);
+		++counters.draws;
+
+		first = last;
+	}
+}
+
+
+
+/*		DeferredRenderer		*/
+
+static GpuMesh getFullScreenQuad()
+{
 	if (!g_meshLibrary.exists("FullScreenQuad"))
 	{
 		CpuMesh fullScreenQuad;
@@ -580,6 +1315,17 @@ static GpuMesh getFullScreenQuad()
 	return g_meshLibrary.get("FullScreenQuad");
 }
 
+DeferredPointLights g_deferredPointLights = DeferredPointLights::CLUSTERED;
+
+bool parseDeferredPointLights(const char* name, DeferredPointLights& pointLights)
+{
+	const std::string n = name;
+	if (n == "clustered") pointLights = DeferredPointLights::CLUSTERED;
+	else if (n == "volumes") pointLights = DeferredPointLights::VOLUMES;
+	else return false;
+	return true;
+}
+
 DeferredRenderer::DeferredRenderer()
 {
 	gbuffer.init(windowWidth, windowHeight);
@@ -590,16 +1336,17 @@ DeferredRenderer::DeferredRenderer()
 		pointLightMesh.buildSphere(1.0f, 20, 20);
 		g_meshLibrary.add("PointLightMesh", pointLightMesh);
 	}
+
+	sphere = g_meshLibrary.get("PointLightMesh");
 	
 	fullScreenQuad = getFullScreenQuad();
-	sphere = g_meshLibrary.get("PointLightMesh");
 
 	ssaoRenderer.reset(new SSAORenderer{});
 }
 
 DeferredRenderer::~DeferredRenderer() = default;
 
-void DeferredRenderer::render(PhysObject** physObjects, unsigned int count)const
+void DeferredRenderer::render(RenderQueue& renderQueue)const
 {
 	DeferredMaterial::updateSceneData();
 
@@ -607,10 +1354,7 @@ void DeferredRenderer::render(PhysObject** physObjects, unsigned int count)const
 
 	gbuffer.bind();
 
-	for (unsigned int i = 0; i < count; ++i)
-	{
-		renderPhysObject(*physObjects[i]);
-	}
+	renderQueue.render(RenderQueue::OPAQUE_PASS);
 
 	gbuffer.unbind();
 
@@ -618,55 +1362,58 @@ void DeferredRenderer::render(PhysObject** physObjects, unsigned int count)const
 
 	OPENGL_CALL(glViewport(0, 0, windowWidth, windowHeight));
 
-	OPENGL_CALL(glDisable(GL_DEPTH_TEST));
+	g_glState.disable(GL_DEPTH_TEST);
 
 	DirLightDeferredShadingMaterial::updateSceneData();
 	DirLightDeferredShadingMaterial::bind();
 
+	//the point lights too, unless they have their own volumes
 	fullScreenQuad.bind();
 	fullScreenQuad.render();
 
-	PointLightDeferredShadingMaterial::updateSceneData();
-	PointLightDeferredShadingMaterial::bind();
+	if (g_deferredPointLights == DeferredPointLights::VOLUMES)
+	{
+		PointLightDeferredShadingMaterial::updateSceneData();
+		const unsigned int pointLightCount = PointLightDeferredShadingMaterial::updateLightData();
 
-	sphere.bind();
+		if (pointLightCount > 0)
+		{
+			PointLightDeferredShadingMaterial::bind();
 
-	OPENGL_CALL(glEnable(GL_BLEND));
-	OPENGL_CALL(glBlendEquation(GL_FUNC_ADD));
-	OPENGL_CALL(glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ZERO)); //sum rgb, replace alpha
+			sphere.bind();
 
-	for (int i = 0; i < POINT_LIGHT_COUNT; ++i)
-	{
-		PointLightDeferredShadingMaterial::updateLightData(i);
-		sphere.render();
+			g_glState.enable(GL_BLEND);
+			g_glState.blendEquation(GL_FUNC_ADD);
+			g_glState.blendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ZERO); //sum rgb, replace alpha
+
+			//one sphere per visible light, all at once
+			sphere.renderInstanced(0, pointLightCount);
+
+			g_glState.disable(GL_BLEND);
+		}
 	}
 
-	OPENGL_CALL(glDisable(GL_BLEND));
-	OPENGL_CALL(glEnable(GL_DEPTH_TEST));
+	g_glState.enable(GL_DEPTH_TEST);
 }
 
-static void renderPhysObject(PhysObject& physObject)
-{
-	glm::mat4 modelMatrix = physObject.getAccumulatedTransform();
 
-	physObject.meshComponent.material.setWorldTransform(modelMatrix);
 
-	physObject.meshComponent.material.updateUniforms();
 
-	physObject.meshComponent.material.bindInstance();
 
-	physObject.meshComponent.mesh.bind();
-	physObject.meshComponent.mesh.render();
-}
+/*		GBuffer		*/
 
-void DeferredRenderer::renderPhysObject(PhysObject& physObject)const
+//for the programs writing or reading the G-buffer: the encoding of its layout (see positionReconstruction.glsl)
+static void addGBufferShaderSource(CpuProgram& program)
 {
-	::renderPhysObject(physObject);
-}
-
-
+	ShaderSource defines;
+	defines.shaderSource = "#define GBUFFER_MAX_SPECULAR_EXPONENT " + std::to_string(GBUFFER_MAX_SPECULAR_EXPONENT) + "\n";
+#ifdef COMPACT_GBUFFER
+	defines.shaderSource += "#define COMPACT_GBUFFER\n";
+#endif
 
-/*		GBuffer		*/
+	program.addFragmentShaderInclude(defines);
+	program.addFragmentShaderInclude(g_shadersPath + "positionReconstruction.glsl");
+}
 
 static void initGBufferComponentParameters()
 {
@@ -679,7 +1426,7 @@ static void initGBufferComponentParameters()
 void GBuffer::init(unsigned int width, unsigned int height)
 {
 	OPENGL_CALL(glGenFramebuffers(1, &frameBufferObjectId));
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, frameBufferObjectId));
+	g_glState.bindFramebuffer(frameBufferObjectId);
 
 	unsigned int texturesIds[] = { INVALID_GRAPHICS_RESOURCE_ID,
 		INVALID_GRAPHICS_RESOURCE_ID,
@@ -708,7 +1455,7 @@ void GBuffer::init(unsigned int width, unsigned int height)
 
 	resize(width, height);
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, 0));//TODO: fetch current texture object id and rebind it here
+	g_glState.bindTexture(GL_TEXTURE_2D, 0);//TODO: fetch current texture object id and rebind it here
 
 	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture.textureId, 0));
 	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, normalTexture.textureId, 0));
@@ -720,7 +1467,7 @@ void GBuffer::init(unsigned int width, unsigned int height)
 	GLenum colorBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
 	OPENGL_CALL(glDrawBuffers(4, colorBuffers));
 
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0)); //TODO: fetch current frame buffer object id and rebind it here
+	g_glState.bindFramebuffer(0); //TODO: fetch current frame buffer object id and rebind it here
 }
 
 void GBuffer::resize(unsigned int _width, unsigned int _height)
@@ -738,6 +1485,16 @@ void GBuffer::resize(unsigned int _width, unsigned int _height)
 	depthTexture.bind();
 	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, _width, _height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr));
 
+#ifdef COMPACT_GBUFFER
+	normalTexture.bind();
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, _width, _height, 0, GL_RG, GL_UNSIGNED_SHORT, nullptr));
+
+	diffuseTexture.bind();
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, _width, _height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+
+	specularAndExponentTexture.bind();
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _width, _height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+#else
 	normalTexture.bind();
 	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, _width, _height, 0, GL_RGBA, GL_FLOAT, nullptr));
 
@@ -746,8 +1503,9 @@ void GBuffer::resize(unsigned int _width, unsigned int _height)
 
 	specularAndExponentTexture.bind();
 	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, _width, _height, 0, GL_RGBA, GL_FLOAT, nullptr));
+#endif
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, 0)); //TODO: fetch current texture id and rebind it here
+	g_glState.bindTexture(GL_TEXTURE_2D, 0); //TODO: fetch current texture id and rebind it here
 
 	width = _width;
 	height = _height;
@@ -755,7 +1513,7 @@ void GBuffer::resize(unsigned int _width, unsigned int _height)
 
 void GBuffer::bind()const
 {
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, frameBufferObjectId));
+	g_glState.bindFramebuffer(frameBufferObjectId);
 
 	OPENGL_CALL(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
 	OPENGL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
@@ -765,7 +1523,7 @@ void GBuffer::bind()const
 
 void GBuffer::unbind()const
 {
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	g_glState.bindFramebuffer(0);
 }
 
 void GBuffer::release()
@@ -773,6 +1531,7 @@ void GBuffer::release()
 	if (frameBufferObjectId != INVALID_GRAPHICS_RESOURCE_ID)
 	{
 		OPENGL_CALL(glDeleteFramebuffers(1, &frameBufferObjectId));
+		g_glState.invalidate();
 		frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
 	}
 
@@ -787,7 +1546,7 @@ void GBuffer::release()
 
 /*		ForwardRenderer		*/
 
-void ForwardRenderer::render(PhysObject** physObjects, unsigned int count)const
+void ForwardRenderer::render(RenderQueue& renderQueue)const
 {
 	ForwardMaterial::updateSceneData();
 
@@ -795,67 +1554,398 @@ void ForwardRenderer::render(PhysObject** physObjects, unsigned int count)const
 
 	OPENGL_CALL(glViewport(0, 0, windowWidth, windowHeight));
 
-	for (unsigned int i = 0; i < count; ++i)
+	renderQueue.render(RenderQueue::OPAQUE_PASS);
+}
+
+
+
+
+/*		ShadowMapRenderer		*/
+
+ShadowMapRenderer::ShadowMapRenderer()
+{
+	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
+	{
+		dirLightShadowMaps[i].init(SHADOW_CASCADE_RESOLUTION * SHADOW_CASCADE_COUNT, SHADOW_CASCADE_RESOLUTION);
+		dirLightShadowMaps[i].bias = -0.005f;
+	}	
+}
+
+void ShadowMapRenderer::updateLightProjectionViews()
+{
+	const Camera& camera = sceneRendering.camera;
+	const float arenaRadius = sceneRendering.arenaRadius;
+
+	//only the depths where the arena is receive shadows: the rest of the view range is left out
+	const float arenaDepth = -(camera.viewTransform * glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f }).z;
+	float nearDepth = (std::max)(camera.nearPlane, arenaDepth - arenaRadius);
+	float farDepth = (std::min)(camera.farPlane, arenaDepth + arenaRadius);
+	if (farDepth <= nearDepth)
+	{
+		nearDepth = camera.nearPlane;
+		farDepth = camera.farPlane;
+	}
+
+	float splitDepths[SHADOW_CASCADE_COUNT + 1];
+	splitDepths[0] = nearDepth;
+	for (int c = 1; c <= SHADOW_CASCADE_COUNT; ++c)
+	{
+		const float t = static_cast<float>(c) / SHADOW_CASCADE_COUNT;
+		const float logarithmicSplit = nearDepth * std::pow(farDepth / nearDepth, t);
+		const float uniformSplit = nearDepth + (farDepth - nearDepth) * t;
+		splitDepths[c] = glm::mix(uniformSplit, logarithmicSplit, SHADOW_CASCADE_SPLIT_LAMBDA);
+	}
+	splitDepths[SHADOW_CASCADE_COUNT] = farDepth;
+
+	cascadeFarDepths = glm::vec4{ 0.0f, 0.0f, 0.0f, 0.0f };
+
+	//the bounding sphere of a slice of the frustum: on its axis, where the near and far corners are as far.
+	//It does not change as the camera turns, so neither does the size of the cascade
+	const float tanHalfFovY = std::tan(camera.fovY * 0.5f);
+	const float tanHalfFovX = tanHalfFovY * camera.aspectRatio;
+	const float squaredCornerSlope = tanHalfFovX * tanHalfFovX + tanHalfFovY * tanHalfFovY;
+
+	glm::vec3 cascadeCenters[SHADOW_CASCADE_COUNT];
+	float cascadeRadii[SHADOW_CASCADE_COUNT];
+
+	for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
 	{
-		renderPhysObject(*physObjects[i]);
+		const float sliceNear = splitDepths[c];
+		const float sliceFar = splitDepths[c + 1];
+
+		const float centerDepth = (std::min)((sliceNear + sliceFar) * 0.5f * (1.0f + squaredCornerSlope), sliceFar);
+		const float radius = std::sqrt((sliceFar - centerDepth) * (sliceFar - centerDepth) + sliceFar * sliceFar * squaredCornerSlope);
+
+		const glm::vec4 center = camera.invViewTransform * glm::vec4{ 0.0f, 0.0f, -centerDepth, 1.0f };
+		cascadeCenters[c] = glm::vec3{ center.x, center.y, center.z };
+		//a bit larger, and rounded: the filters read around the texels, and the radius must not flicker
+		cascadeRadii[c] = std::ceil(radius * 1.05f * 16.0f) / 16.0f;
+
+		//a slice wider than the arena: the arena is enough (what a single map used to cover)
+		if (cascadeRadii[c] > arenaRadius * 1.2f)
+		{
+			cascadeCenters[c] = glm::vec3{ 0.0f, 0.0f, 0.0f };
+			cascadeRadii[c] = arenaRadius * 1.2f;
+		}
+
+		cascadeFarDepths[c] = sliceFar;
+	}
+
+	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
+	{
+		glm::vec3 pseudoDirLightPos = -sceneRendering.lighting->directionalLights[i].direction*arenaRadius;
+		const glm::mat4 lightView = glm::lookAtRH(pseudoDirLightPos, glm::vec3{ 0.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+		{
+			const float radius = cascadeRadii[c];
+
+			//the center moves by whole texels: the texels stay where they are in the world, and the edges of the shadows with them
+			const float texelSize = 2.0f * radius / SHADOW_CASCADE_RESOLUTION;
+			glm::vec4 lightSpaceCenter = lightView * glm::vec4{ cascadeCenters[c], 1.0f };
+			lightSpaceCenter.x = std::floor(lightSpaceCenter.x / texelSize) * texelSize;
+			lightSpaceCenter.y = std::floor(lightSpaceCenter.y / texelSize) * texelSize;
+
+			//along the light, the whole arena: the casters out of the slice still cast into it
+			dirLightProjectionViews[i][c] = glm::ortho(lightSpaceCenter.x - radius, lightSpaceCenter.x + radius,
+				lightSpaceCenter.y - radius, lightSpaceCenter.y + radius, 0.01f, 2 * arenaRadius);
+			dirLightProjectionViews[i][c] *= lightView;
+		}
 	}
 }
 
-void ForwardRenderer::renderPhysObject(PhysObject& physObject)const
+void ShadowMapRenderer::render(RenderQueue& renderQueue)
 {
-	::renderPhysObject(physObject);
+	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
+	{
+		dirLightShadowMaps[i].bindAsDepthBuffer();
+
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+		{
+			OPENGL_CALL(glViewport(c * SHADOW_CASCADE_RESOLUTION, 0, SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_RESOLUTION));
+
+			shadowMapMaterial.setLightProjectionView(dirLightProjectionViews[i][c]);
+			shadowMapMaterial.updateLightUniforms();
+			shadowMapMaterial.bind();
+
+			//only what the volume of the cascade holds (see RenderQueue::build)
+			renderQueue.render(RenderQueue::Pass(RenderQueue::SHADOW_PASS + i * SHADOW_CASCADE_COUNT + c));
+		}
+
+		dirLightShadowMaps[i].unbind();
+	}
 }
 
 
 
 
-/*		ShadowMapRenderer		*/
 
-ShadowMapRenderer::ShadowMapRenderer()
+
+/*		ClusteredLighting		*/
+
+//the simulation has a thread of its own: the binning takes (up to 4 of) the others
+static unsigned int clusterBinningThreadCount()
 {
-	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 2 ? (std::min)(hardwareThreads - 1, 4u) : 1u;
+}
+
+//an empty range can't be bound: there is always something
+static UniformRange pushStorage(const void* data, unsigned int size)
+{
+	static const unsigned int nothing = 0;
+	return size > 0 ? g_uniformRing.push(data, size) : g_uniformRing.push(&nothing, sizeof(nothing));
+}
+
+void ClusteredLighting::update(const Camera& camera, const std::vector<PointLight>& pointLights, LightSpace lightSpace)
+{
+	clusters.setProjection(camera.fovY, camera.aspectRatio, camera.nearPlane, camera.farPlane);
+
+	const size_t lightCount = pointLights.size();
+
+	viewSpaceSpheres.resize(lightCount);
+	viewSpaceLights.resize(lightCount);
+	for (size_t i = 0; i < lightCount; ++i)
+	{
+		const glm::vec4& positionAndRadius = pointLights[i].positionAndRadius;
+		glm::vec4 viewSpacePosition = camera.viewTransform * glm::vec4(positionAndRadius.x, positionAndRadius.y, positionAndRadius.z, 1.0f);
+		viewSpaceSpheres[i] = glm::vec4(viewSpacePosition.x, viewSpacePosition.y, viewSpacePosition.z, positionAndRadius.w);
+
+		viewSpaceLights[i] = pointLights[i];
+		viewSpaceLights[i].positionAndRadius = viewSpaceSpheres[i];
+	}
+
+	clusters.bin(viewSpaceSpheres.data(), static_cast<unsigned int>(lightCount), clusterBinningThreadCount());
+
+	UniformBlock uniformBlock;
+	uniformBlock.u_clusterGridSize = glm::uvec4{ LightClusters::TILES_X, LightClusters::TILES_Y, LightClusters::SLICES, 0 };
+	uniformBlock.u_clusterTileSizeAndDepthMapping = glm::vec4{
+		static_cast<float>(windowWidth) / LightClusters::TILES_X,
+		static_cast<float>(windowHeight) / LightClusters::TILES_Y,
+		clusters.depthScale,
+		clusters.depthBias };
+
+	const std::vector<PointLight>& lights = lightSpace == VIEW_SPACE ? viewSpaceLights : pointLights;
+
+	uniformRange = g_uniformRing.push(uniformBlock);
+	lightsRange = pushStorage(lights.data(), static_cast<unsigned int>(lights.size() * sizeof(PointLight)));
+	clusterRangesRange = pushStorage(clusters.ranges.data(), static_cast<unsigned int>(clusters.ranges.size() * sizeof(ClusterRange)));
+	lightIndicesRange = pushStorage(clusters.lightIndices.data(), static_cast<unsigned int>(clusters.lightIndices.size() * sizeof(uint32_t)));
+}
+
+void ClusteredLighting::bind()const
+{
+	//here we assume the binding indices of clusteredLighting.glsl
+	uniformRange.bind(4);
+	lightsRange.bindAsStorage(0);
+	clusterRangesRange.bindAsStorage(1);
+	lightIndicesRange.bindAsStorage(2);
+}
+
+
+
+/*		UniformRing		*/
+
+UniformRing g_uniformRing;
+
+void UniformRange::bind(unsigned int bindingIndex)const
+{
+	g_glState.bindUniformBufferRange(bindingIndex, bufferId, offset, size);
+}
+
+void UniformRange::bindAsStorage(unsigned int bindingIndex)const
+{
+	g_glState.bindShaderStorageBufferRange(bindingIndex, bufferId, offset, size);
+}
+
+void UniformRing::init(unsigned int bytesPerFrame)
+{
+	//every range must be fit to be bound both as a uniform block and as a storage block
+	GLint uniformOffsetAlignment = 0;
+	GLint storageOffsetAlignment = 0;
+	OPENGL_CALL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformOffsetAlignment));
+	OPENGL_CALL(glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageOffsetAlignment));
+	alignment = static_cast<unsigned int>((std::max)(uniformOffsetAlignment, storageOffsetAlignment));
+
+	frameIndex = 0;
+	if (!create(bytesPerFrame))
+	{
+		assert(false);
+	}
+}
+
+bool UniformRing::create(unsigned int bytesPerFrame)
+{
+	const unsigned int newFrameSize = (bytesPerFrame + alignment - 1) / alignment * alignment;
+
+	GLuint newBufferId = 0;
+	OPENGL_CALL(glCreateBuffers(1, &newBufferId));
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	OPENGL_CALL(glNamedBufferStorage(newBufferId, GLsizeiptr(newFrameSize) * FRAMES_IN_FLIGHT, nullptr, flags));
+	unsigned char* newMappedData = nullptr;
+	OPENGL_CALL((newMappedData = static_cast<unsigned char*>(glMapNamedBufferRange(newBufferId, 0, GLsizeiptr(newFrameSize) * FRAMES_IN_FLIGHT, flags))));
+	if (newMappedData == nullptr)
+	{
+		OPENGL_CALL(glDeleteBuffers(1, &newBufferId));
+		return false;
+	}
+
+	bufferId = newBufferId;
+	mappedData = newMappedData;
+	frameSize = newFrameSize;
+	frameOffset = 0;
+	return true;
+}
+
+void UniformRing::release()
+{
+	deleteRetiredBuffers(true);
+
+	for (GLsync& fence : fences)
+	{
+		if (fence != nullptr)
+		{
+			OPENGL_CALL(glDeleteSync(fence));
+			fence = nullptr;
+		}
+	}
+
+	if (bufferId != INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		OPENGL_CALL(glUnmapNamedBuffer(bufferId));
+		OPENGL_CALL(glDeleteBuffers(1, &bufferId));
+		g_glState.invalidate();
+		bufferId = INVALID_GRAPHICS_RESOURCE_ID;
+	}
+
+	mappedData = nullptr;
+}
+
+void UniformRing::deleteRetiredBuffers(bool wait)
+{
+	auto isDone = [wait](RetiredBuffer& retired)
+	{
+		if (retired.fence == nullptr)
+		{
+			if (!wait) return false; //its frame is still being recorded
+			OPENGL_CALL(glFinish());
+			return true;
+		}
+
+		GLenum waitResult = GL_TIMEOUT_EXPIRED;
+		do
+		{
+			OPENGL_CALL((waitResult = glClientWaitSync(retired.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000 : 0)));
+		} while (wait && waitResult == GL_TIMEOUT_EXPIRED);
+		return waitResult != GL_TIMEOUT_EXPIRED;
+	};
+
+	bool deletedAny = false;
+	for (size_t i = 0; i < retiredBuffers.size(); )
+	{
+		RetiredBuffer& retired = retiredBuffers[i];
+		if (!isDone(retired))
+		{
+			++i;
+			continue;
+		}
+
+		if (retired.fence != nullptr) OPENGL_CALL(glDeleteSync(retired.fence));
+		if (retired.isMapped) OPENGL_CALL(glUnmapNamedBuffer(retired.bufferId));
+		OPENGL_CALL(glDeleteBuffers(1, &retired.bufferId));
+		deletedAny = true;
+
+		retiredBuffers[i] = retiredBuffers.back();
+		retiredBuffers.pop_back();
+	}
+
+	if (deletedAny)
 	{
-		dirLightShadowMaps[i].init(2048, 2048);
-		dirLightShadowMaps[i].bias = -0.005f;
-	}	
+		g_glState.invalidate(); //a deleted buffer may still be in the cache of the bindings, under a name GL will reuse
+	}
 }
 
-void ShadowMapRenderer::render(PhysObject** physObjects, unsigned int count)
+void UniformRing::beginFrame()
 {
-	const float arenaRadius = scene.arenaRadius;
+	deleteRetiredBuffers(false);
 
-	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
+	GLsync& fence = fences[frameIndex];
+	if (fence != nullptr)
 	{
-		dirLightShadowMaps[i].bindAsDepthBuffer();
+		//usually already signaled: the GPU is FRAMES_IN_FLIGHT-1 frames behind, at most
+		GLenum waitResult = GL_TIMEOUT_EXPIRED;
+		while (waitResult == GL_TIMEOUT_EXPIRED)
+		{
+			OPENGL_CALL((waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000)));
+		}
+		assert(waitResult != GL_WAIT_FAILED);
 
-		glm::vec3 pseudoDirLightPos = -scene.lighting->directionalLights[i].direction*arenaRadius;
+		OPENGL_CALL(glDeleteSync(fence));
+		fence = nullptr;
+	}
 
-		dirLightProjectionViews[i] = glm::ortho(-arenaRadius*1.2f, arenaRadius*1.2f, -arenaRadius*1.2f, arenaRadius*1.2f, 0.01f, 2 * arenaRadius);
-		dirLightProjectionViews[i] *= glm::lookAtRH(pseudoDirLightPos, glm::vec3{ 0.0f, 0.0f, 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f });
+	frameOffset = 0;
+}
 
-		shadowMapMaterial.setLightProjectionView(dirLightProjectionViews[i]);
-		shadowMapMaterial.updateLightUniforms();
+void UniformRing::endFrame()
+{
+	OPENGL_CALL((fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)));
 
-		for (unsigned int i = 0; i < count; ++i)
+	//the buffers retired during this frame are free once the GPU is past it
+	for (RetiredBuffer& retired : retiredBuffers)
+	{
+		if (retired.fence == nullptr)
 		{
-			renderPhysObject(*physObjects[i]);
+			OPENGL_CALL((retired.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)));
 		}
-
-		dirLightShadowMaps[i].unbind();
 	}
+
+	frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
 }
 
-void ShadowMapRenderer::renderPhysObject(PhysObject& physObject)
+UniformRange UniformRing::push(const void* data, unsigned int size)
 {
-	shadowMapMaterial.setWorldTransform(physObject.getAccumulatedTransform());
-	shadowMapMaterial.updateObjectUniforms();
-	shadowMapMaterial.bindInstance();
+	if (size > frameSize - frameOffset)
+	{
+		return pushOverflowing(data, size);
+	}
+
+	UniformRange range;
+	range.bufferId = bufferId;
+	range.offset = frameIndex * frameSize + frameOffset;
+	range.size = size;
+
+	std::memcpy(mappedData + range.offset, data, size);
 
-	physObject.meshComponent.mesh.bind();
-	physObject.meshComponent.mesh.render();
+	frameOffset += (size + alignment - 1) / alignment * alignment; //(at most frameSize: both are aligned)
+
+	return range;
 }
 
+UniformRange UniformRing::pushOverflowing(const void* data, unsigned int size)
+{
+	//the ranges of this frame (and of the frames in flight) keep pointing in the old buffer: it is only retired.
+	//The new one has no frame in flight: its region of this frame is free from the start
+	const unsigned int oldBufferId = bufferId;
+	const unsigned int newFrameSize = (std::max)(frameSize * 2, size);
+
+	if (newFrameSize <= MAX_FRAME_SIZE && create(newFrameSize))
+	{
+		retiredBuffers.push_back(RetiredBuffer{ oldBufferId, true, nullptr });
+		return push(data, size);
+	}
+
+	//no bigger ring: this block alone in a buffer of its own, the ring as it was
+	UniformRange range;
+	OPENGL_CALL(glCreateBuffers(1, &range.bufferId));
+	OPENGL_CALL(glNamedBufferStorage(range.bufferId, size, data, 0));
+	range.offset = 0;
+	range.size = size;
 
+	retiredBuffers.push_back(RetiredBuffer{ range.bufferId, false, nullptr });
+	return range;
+}
 
 
 
@@ -898,8 +1988,8 @@ static void bindTextureIfValid(GpuTexture gpuTexture, unsigned int textureUnit)
 {
 	if (gpuTexture.textureId != INVALID_GRAPHICS_RESOURCE_ID) //TODO: introduce a "isValid" method, please
 	{
-		OPENGL_CALL(glActiveTexture(GL_TEXTURE0 + textureUnit));
-		OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, gpuTexture.textureId));
+		g_glState.activeTexture(textureUnit);
+		g_glState.bindTexture(GL_TEXTURE_2D, gpuTexture.textureId);
 	}
 	else
 	{
@@ -908,7 +1998,7 @@ static void bindTextureIfValid(GpuTexture gpuTexture, unsigned int textureUnit)
 }
 
 GpuProgram DeferredMaterial::gpuProgram{};
-unsigned int DeferredMaterial::sceneVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+UniformRange DeferredMaterial::sceneVertexShaderUniformRange{};
 DeferredMaterial::SceneVertexShaderUniformBlock DeferredMaterial::sceneVertexShaderUniformBlock{};
 
 DeferredMaterial::DeferredMaterial()
@@ -920,20 +2010,13 @@ DeferredMaterial::DeferredMaterial()
 			CpuProgram program;
 			program.import(g_shadersPath + "gBufferBuildVertexShader.glsl", g_shadersPath + "gBufferBuildFragmentShader.glsl");
 			program.addFragmentShaderInclude(g_shadersPath + "normalMapping.glsl");
+			addGBufferShaderSource(program);
 			g_programLibrary.add("GBufferBuildProgram", program);
 		}
 
 		gpuProgram = g_programLibrary.get("GBufferBuildProgram");
 	}
 
-	if (sceneVertexShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
-	{
-		sceneVertexShaderUniformBufferId = createUniformBuffer<SceneVertexShaderUniformBlock>();
-	}
-
-	objectVertexShaderUniformBufferId = createUniformBuffer<ObjectVertexShaderUniformBlock>();
-	objectFragmentShaderUniformBufferId = createUniformBuffer<ObjectFragmentShaderUniformBlock>();
-
 	//TODO: add defaults
 	objectFragmentShaderUniformBlock.u_textCoordScaleAndTranslate = glm::vec4{ 1.0f, 1.0f, 0.0f, 0.0f };
 }
@@ -943,31 +2026,25 @@ void DeferredMaterial::bind()
 	gpuProgram.bind();
 
 	//here we assume the binding index for the uniform blocks
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, sceneVertexShaderUniformBufferId, 0, sizeof(SceneVertexShaderUniformBlock)));
+	sceneVertexShaderUniformRange.bind(0);
 }
 
-void DeferredMaterial::bindInstance()const
+void DeferredMaterial::bindObjectUniforms()const
 {
-	gpuProgram.bind();
-
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 1, objectVertexShaderUniformBufferId, 0, sizeof(ObjectVertexShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 2, objectFragmentShaderUniformBufferId, 0, sizeof(ObjectFragmentShaderUniformBlock)));
-
-	bindTextureIfValid(diffuseMap, 0);
-	bindTextureIfValid(normalMap, 1);
-	bindTextureIfValid(specularMap, 2);
+	objectFragmentShaderUniformRange.bind(2);
 }
 
-void DeferredMaterial::updateUniforms()
+bool DeferredMaterial::looksLike(const DeferredMaterial& other)const
 {
-	//TODO: add dirty flags and checks	
-	updateUniformBlock(objectVertexShaderUniformBlock, objectVertexShaderUniformBufferId);
-	updateUniformBlock(objectFragmentShaderUniformBlock, objectFragmentShaderUniformBufferId);
+	return diffuseMap.textureId == other.diffuseMap.textureId &&
+		normalMap.textureId == other.normalMap.textureId &&
+		specularMap.textureId == other.specularMap.textureId &&
+		std::memcmp(&objectFragmentShaderUniformBlock, &other.objectFragmentShaderUniformBlock, sizeof(ObjectFragmentShaderUniformBlock)) == 0;
 }
 
-void DeferredMaterial::setWorldTransform(const glm::mat4& world)
+void DeferredMaterial::updateUniforms()
 {
-	objectVertexShaderUniformBlock.u_viewWorld = scene.camera.viewTransform * world;
+	objectFragmentShaderUniformRange = g_uniformRing.push(objectFragmentShaderUniformBlock);
 }
 
 void DeferredMaterial::setSpecularColor(const glm::vec3& specularColor)
@@ -995,9 +2072,10 @@ void DeferredMaterial::setTextCoordTranslate(const glm::vec2& textCoordTranslate
 
 void DeferredMaterial::updateSceneData()
 {
-	sceneVertexShaderUniformBlock.u_projection = scene.camera.projectionTransform;
+	sceneVertexShaderUniformBlock.u_projection = sceneRendering.camera.projectionTransform;
+	sceneVertexShaderUniformBlock.u_view = sceneRendering.camera.viewTransform;
 
-	updateUniformBlock(sceneVertexShaderUniformBlock, sceneVertexShaderUniformBufferId);
+	sceneVertexShaderUniformRange = g_uniformRing.push(sceneVertexShaderUniformBlock);
 }
 
 
@@ -1009,7 +2087,7 @@ static void addLightingShaderSource(CpuProgram& program)
 {
 	ShaderSource defines;
 	defines.shaderSource = "#define DIR_LIGHT_COUNT " + std::to_string(DIR_LIGHT_COUNT) +"\n";
-	defines.shaderSource += "#define POINT_LIGHT_COUNT " + std::to_string(POINT_LIGHT_COUNT) + "\n";
+	defines.shaderSource += "#define SHADOW_CASCADE_COUNT " + std::to_string(SHADOW_CASCADE_COUNT) + "\n";
 #ifdef SHADOW_PCF
 	defines.shaderSource += "#define SHADOW_PCF\n";
 #elif defined(SHADOW_LERP)
@@ -1018,6 +2096,7 @@ static void addLightingShaderSource(CpuProgram& program)
 	
 	program.addVertexShaderInclude(defines);
 	program.addFragmentShaderInclude(defines);
+	program.addFragmentShaderInclude(g_shadersPath + "pointLight.glsl");
 	program.addFragmentShaderInclude(g_shadersPath + "lighting.glsl");
 
 }
@@ -1025,8 +2104,8 @@ static void addLightingShaderSource(CpuProgram& program)
 
 GpuProgram DirLightDeferredShadingMaterial::gpuProgram{};
 
-unsigned int DirLightDeferredShadingMaterial::sceneVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
-unsigned int DirLightDeferredShadingMaterial::sceneFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+UniformRange DirLightDeferredShadingMaterial::sceneVertexShaderUniformRange{};
+UniformRange DirLightDeferredShadingMaterial::sceneFragmentShaderUniformRange{};
 
 DirLightDeferredShadingMaterial::SceneVertexShaderUniformBlock DirLightDeferredShadingMaterial::sceneVertexShaderUniformBlock{};
 DirLightDeferredShadingMaterial::SceneFragmentShaderUniformBlock DirLightDeferredShadingMaterial::sceneFragmentShaderUniformBlock{};
@@ -1048,20 +2127,19 @@ DirLightDeferredShadingMaterial::DirLightDeferredShadingMaterial()
 		{
 			CpuProgram program;
 			program.import(g_shadersPath + "dirLightShadingVertexShader.glsl", g_shadersPath + "dirLightShadingFragmentShader.glsl");
-			program.addFragmentShaderInclude(g_shadersPath + "positionReconstruction.glsl");
+			addGBufferShaderSource(program);
 			//program.addFragmentShaderInclude(g_shadersPath + "lighting.glsl");
 			addLightingShaderSource(program);
+			//always built in, u_clusteredPointLights turns it off when the point lights have their own volumes
+			ShaderSource clusteredDefine;
+			clusteredDefine.shaderSource = "#define CLUSTERED_POINT_LIGHTS\n";
+			program.addFragmentShaderInclude(clusteredDefine, false);
+			program.addFragmentShaderInclude(g_shadersPath + "clusteredLighting.glsl");
 			g_programLibrary.add("DirLightDeferredShadingProgram", program);
 		}
 
 		gpuProgram = g_programLibrary.get("DirLightDeferredShadingProgram");
 	}
-
-	if (sceneVertexShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
-	{
-		sceneVertexShaderUniformBufferId = createUniformBuffer<SceneVertexShaderUniformBlock>();
-		sceneFragmentShaderUniformBufferId = createUniformBuffer<SceneFragmentShaderUniformBlock>();
-	}
 }
 
 void DirLightDeferredShadingMaterial::bind()
@@ -1069,8 +2147,8 @@ void DirLightDeferredShadingMaterial::bind()
 	gpuProgram.bind();
 
 	//here we assume the binding index for the uniform blocks
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, sceneVertexShaderUniformBufferId, 0, sizeof(SceneVertexShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 1, sceneFragmentShaderUniformBufferId, 0, sizeof(SceneFragmentShaderUniformBlock)));
+	sceneVertexShaderUniformRange.bind(0);
+	sceneFragmentShaderUniformRange.bind(1);
 
 	bindTextureIfValid(depthBuffer, 0);
 	bindTextureIfValid(normalBuffer, 1);
@@ -1083,44 +2161,55 @@ void DirLightDeferredShadingMaterial::bind()
 	}
 
 	bindTextureIfValid(ssaoMap, 4 + DIR_LIGHT_COUNT);
+
+	if (g_deferredPointLights == DeferredPointLights::CLUSTERED)
+	{
+		sceneRendering.clusteredLighting.bind();
+	}
 }
 
 void DirLightDeferredShadingMaterial::updateSceneData()
 {
-	sceneVertexShaderUniformBlock.u_invProjection = scene.camera.invProjectionTransform;
-	sceneFragmentShaderUniformBlock.u_ambientLight = scene.lighting->ambientLight;
-	sceneFragmentShaderUniformBlock.u_frustumNear = scene.camera.nearPlane;
-	sceneFragmentShaderUniformBlock.u_frustumFar = scene.camera.farPlane;
+	sceneVertexShaderUniformBlock.u_invProjection = sceneRendering.camera.invProjectionTransform;
+	sceneFragmentShaderUniformBlock.u_ambientLight = sceneRendering.lighting->ambientLight;
+	sceneFragmentShaderUniformBlock.u_clusteredPointLights = g_deferredPointLights == DeferredPointLights::CLUSTERED ? 1 : 0;
+	sceneFragmentShaderUniformBlock.u_frustumNear = sceneRendering.camera.nearPlane;
+	sceneFragmentShaderUniformBlock.u_frustumFar = sceneRendering.camera.farPlane;
 
-	glm::mat4 invViewTransform = scene.camera.invViewTransform;
+	glm::mat4 invViewTransform = sceneRendering.camera.invViewTransform;
 
 	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
 	{
-		sceneFragmentShaderUniformBlock.u_directionalLights[i] = scene.lighting->directionalLights[i];
+		sceneFragmentShaderUniformBlock.u_directionalLights[i] = sceneRendering.lighting->directionalLights[i];
 
 		glm::vec3& lightDir = sceneFragmentShaderUniformBlock.u_directionalLights[i].direction;
-		glm::vec4 viewSpaceLightDir = scene.camera.viewTransform * glm::vec4(lightDir, 0.0f);
+		glm::vec4 viewSpaceLightDir = sceneRendering.camera.viewTransform * glm::vec4(lightDir, 0.0f);
 		lightDir = glm::normalize(glm::vec3{ viewSpaceLightDir.x, viewSpaceLightDir.y, viewSpaceLightDir.z });
 
 		glm::vec4& shadowMapSizeAndBias = sceneFragmentShaderUniformBlock.u_dirShadowMapSizeAndBias[i];
-		shadowMapSizeAndBias.x = static_cast<float>(scene.shadowMapRenderer->dirLightShadowMaps[i].width);
-		shadowMapSizeAndBias.y = static_cast<float>(scene.shadowMapRenderer->dirLightShadowMaps[i].height);
-		shadowMapSizeAndBias.z = scene.shadowMapRenderer->dirLightShadowMaps[i].bias;
+		shadowMapSizeAndBias.x = static_cast<float>(sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].width);
+		shadowMapSizeAndBias.y = static_cast<float>(sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].height);
+		shadowMapSizeAndBias.z = sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].bias;
 
-		dirShadowMaps[i] = scene.shadowMapRenderer->dirLightShadowMaps[i].depthTexture;
+		dirShadowMaps[i] = sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].depthTexture;
 
-		sceneFragmentShaderUniformBlock.u_dirShadowTransforms[i] = scene.shadowMapRenderer->dirLightProjectionViews[i] * invViewTransform;
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+		{
+			sceneFragmentShaderUniformBlock.u_dirShadowTransforms[i * SHADOW_CASCADE_COUNT + c] = sceneRendering.shadowMapRenderer->dirLightProjectionViews[i][c] * invViewTransform;
+		}
 	}
 
-	depthBuffer = scene.deferredRenderer->gbuffer.depthTexture;
-	normalBuffer = scene.deferredRenderer->gbuffer.normalTexture;
-	diffuseBuffer = scene.deferredRenderer->gbuffer.diffuseTexture;
-	specularAndExponentBuffer = scene.deferredRenderer->gbuffer.specularAndExponentTexture;
+	sceneFragmentShaderUniformBlock.u_shadowCascadeFarDepths = sceneRendering.shadowMapRenderer->cascadeFarDepths;
 
-	ssaoMap = scene.deferredRenderer->ssaoRenderer->ssaoMap.ssaoTexture;
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
+	normalBuffer = sceneRendering.deferredRenderer->gbuffer.normalTexture;
+	diffuseBuffer = sceneRendering.deferredRenderer->gbuffer.diffuseTexture;
+	specularAndExponentBuffer = sceneRendering.deferredRenderer->gbuffer.specularAndExponentTexture;
 
-	updateUniformBlock(sceneFragmentShaderUniformBlock, sceneFragmentShaderUniformBufferId);
-	updateUniformBlock(sceneVertexShaderUniformBlock, sceneVertexShaderUniformBufferId);
+	ssaoMap = sceneRendering.deferredRenderer->ssaoRenderer->ssaoMap.ssaoTexture;
+
+	sceneFragmentShaderUniformRange = g_uniformRing.push(sceneFragmentShaderUniformBlock);
+	sceneVertexShaderUniformRange = g_uniformRing.push(sceneVertexShaderUniformBlock);
 }
 
 
@@ -1132,14 +2221,22 @@ GpuProgram PointLightDeferredShadingMaterial::gpuProgram{};
 PointLightDeferredShadingMaterial::SceneVertexShaderUniformBlock PointLightDeferredShadingMaterial::sceneVertexShaderUniformBlock{};
 PointLightDeferredShadingMaterial::SceneFragmentShaderUniformBlock PointLightDeferredShadingMaterial::sceneFragmentShaderUniformBlock{};
 
-unsigned int PointLightDeferredShadingMaterial::sceneVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
-unsigned int PointLightDeferredShadingMaterial::sceneFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+UniformRange PointLightDeferredShadingMaterial::sceneVertexShaderUniformRange{};
+UniformRange PointLightDeferredShadingMaterial::sceneFragmentShaderUniformRange{};
+UniformRange PointLightDeferredShadingMaterial::pointLightsRange{};
 
 GpuTexture PointLightDeferredShadingMaterial::depthBuffer{};
 GpuTexture PointLightDeferredShadingMaterial::normalBuffer{};
 GpuTexture PointLightDeferredShadingMaterial::diffuseBuffer{};
 GpuTexture PointLightDeferredShadingMaterial::specularAndExponentBuffer{};
 
+std::vector<float> PointLightDeferredShadingMaterial::sphereX;
+std::vector<float> PointLightDeferredShadingMaterial::sphereY;
+std::vector<float> PointLightDeferredShadingMaterial::sphereZ;
+std::vector<float> PointLightDeferredShadingMaterial::sphereRadius;
+std::vector<unsigned char> PointLightDeferredShadingMaterial::visible;
+std::vector<PointLight> PointLightDeferredShadingMaterial::visibleLights;
+
 PointLightDeferredShadingMaterial::PointLightDeferredShadingMaterial()
 {
 	if (gpuProgram.programId == INVALID_GRAPHICS_RESOURCE_ID)
@@ -1148,29 +2245,27 @@ PointLightDeferredShadingMaterial::PointLightDeferredShadingMaterial()
 		{
 			CpuProgram program;
 			program.import(g_shadersPath + "pointLightShadingVertexShader.glsl", g_shadersPath + "pointLightShadingFragmentShader.glsl");
-			program.addFragmentShaderInclude(g_shadersPath + "positionReconstruction.glsl");
+			addGBufferShaderSource(program);
 			//program.addFragmentShaderInclude(g_shadersPath + "lighting.glsl");
 			addLightingShaderSource(program);
+			program.addVertexShaderInclude(g_shadersPath + "pointLight.glsl");
+			program.addVertexShaderInclude(g_shadersPath + "pointLightVolumes.glsl");
+			program.addFragmentShaderInclude(g_shadersPath + "pointLightVolumes.glsl");
 			g_programLibrary.add("PointLightDeferredShadingProgram", program);
 		}
 
 		gpuProgram = g_programLibrary.get("PointLightDeferredShadingProgram");
 	}
-
-	if (sceneVertexShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
-	{
-		sceneVertexShaderUniformBufferId = createUniformBuffer<SceneVertexShaderUniformBlock>();
-		sceneFragmentShaderUniformBufferId = createUniformBuffer<SceneFragmentShaderUniformBlock>();
-	}
 }
 
 void PointLightDeferredShadingMaterial::bind()
 {
 	gpuProgram.bind();
 
-	//here we assume the binding index for the uniform blocks
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, sceneVertexShaderUniformBufferId, 0, sizeof(SceneVertexShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 1, sceneFragmentShaderUniformBufferId, 0, sizeof(SceneFragmentShaderUniformBlock)));
+	//here we assume the binding index for the uniform and storage blocks
+	sceneVertexShaderUniformRange.bind(0);
+	sceneFragmentShaderUniformRange.bind(1);
+	pointLightsRange.bindAsStorage(0);
 
 	bindTextureIfValid(depthBuffer, 0);
 	bindTextureIfValid(normalBuffer, 1);
@@ -1178,41 +2273,61 @@ void PointLightDeferredShadingMaterial::bind()
 	bindTextureIfValid(specularAndExponentBuffer, 3);
 }
 
-void PointLightDeferredShadingMaterial::updateLightData(unsigned int pointLightIndex)
+unsigned int PointLightDeferredShadingMaterial::updateLightData()
 {
-	PointLight& pointLight = scene.lighting->pointLights[pointLightIndex];
+	const std::vector<PointLight>& pointLights = sceneRendering.lighting->pointLights;
+	const unsigned int count = static_cast<unsigned int>(pointLights.size());
 
-	glm::vec3 pointLightPos = glm::vec3{ pointLight.positionAndRadius.x, pointLight.positionAndRadius.y, pointLight.positionAndRadius.z };
-	float pointLightRadius = pointLight.positionAndRadius.w;
+	sphereX.resize(count);
+	sphereY.resize(count);
+	sphereZ.resize(count);
+	sphereRadius.resize(count);
+	visible.resize(count);
 
-	glm::mat4 lightWorldMatrix = glm::scale(glm::vec3{ pointLightRadius, pointLightRadius, pointLightRadius });
-	lightWorldMatrix = glm::translate(pointLightPos) * lightWorldMatrix;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		sphereX[i] = pointLights[i].positionAndRadius.x;
+		sphereY[i] = pointLights[i].positionAndRadius.y;
+		sphereZ[i] = pointLights[i].positionAndRadius.z;
+		sphereRadius[i] = pointLights[i].positionAndRadius.w;
+	}
 
-	sceneVertexShaderUniformBlock.u_viewWorld = scene.camera.viewTransform *lightWorldMatrix;
+	const Frustum viewFrustum = Frustum::fromProjectionView(sceneRendering.camera.projectionViewTransform);
+	cullSpheres(viewFrustum, sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data(), count, visible.data());
 
-	sceneFragmentShaderUniformBlock.u_pointLight = pointLight;
-	glm::vec4 viewSpaceLightPos = scene.camera.viewTransform * glm::vec4(pointLightPos, 1.0f);
+	visibleLights.clear();
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (visible[i])
+		{
+			PointLight viewSpaceLight = pointLights[i];
+			const glm::vec4 viewSpacePosition = sceneRendering.camera.viewTransform * glm::vec4(sphereX[i], sphereY[i], sphereZ[i], 1.0f);
+			viewSpaceLight.positionAndRadius = glm::vec4(viewSpacePosition.x, viewSpacePosition.y, viewSpacePosition.z, sphereRadius[i]);
+			visibleLights.push_back(viewSpaceLight);
+		}
+	}
 
-	sceneFragmentShaderUniformBlock.u_pointLight.positionAndRadius = viewSpaceLightPos;
-	sceneFragmentShaderUniformBlock.u_pointLight.positionAndRadius.w = pointLight.positionAndRadius.w;
+	if (!visibleLights.empty())
+	{
+		pointLightsRange = g_uniformRing.push(visibleLights.data(), static_cast<unsigned int>(visibleLights.size() * sizeof(PointLight)));
+	}
 
-	updateUniformBlock(sceneVertexShaderUniformBlock, sceneVertexShaderUniformBufferId);
-	updateUniformBlock(sceneFragmentShaderUniformBlock, sceneFragmentShaderUniformBufferId);
+	return static_cast<unsigned int>(visibleLights.size());
 }
 
 void PointLightDeferredShadingMaterial::updateSceneData()
 {
-	sceneVertexShaderUniformBlock.u_projection = scene.camera.projectionTransform;
-	sceneFragmentShaderUniformBlock.u_frustumNear = scene.camera.nearPlane;
-	sceneFragmentShaderUniformBlock.u_frustumFar = scene.camera.farPlane;
+	sceneVertexShaderUniformBlock.u_projection = sceneRendering.camera.projectionTransform;
+	sceneFragmentShaderUniformBlock.u_frustumNear = sceneRendering.camera.nearPlane;
+	sceneFragmentShaderUniformBlock.u_frustumFar = sceneRendering.camera.farPlane;
 
-	depthBuffer = scene.deferredRenderer->gbuffer.depthTexture;
-	normalBuffer = scene.deferredRenderer->gbuffer.normalTexture;
-	diffuseBuffer = scene.deferredRenderer->gbuffer.diffuseTexture;
-	specularAndExponentBuffer = scene.deferredRenderer->gbuffer.specularAndExponentTexture;
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
+	normalBuffer = sceneRendering.deferredRenderer->gbuffer.normalTexture;
+	diffuseBuffer = sceneRendering.deferredRenderer->gbuffer.diffuseTexture;
+	specularAndExponentBuffer = sceneRendering.deferredRenderer->gbuffer.specularAndExponentTexture;
 
-	//here, we should update the uniform buffers but we don't since the scene and the per light data has been
-	//kept together. this has been possible because the scene data is small.
+	sceneVertexShaderUniformRange = g_uniformRing.push(sceneVertexShaderUniformBlock);
+	sceneFragmentShaderUniformRange = g_uniformRing.push(sceneFragmentShaderUniformBlock);
 }
 
 
@@ -1220,8 +2335,8 @@ void PointLightDeferredShadingMaterial::updateSceneData()
 
 GpuProgram ForwardMaterial::gpuProgram{};
 
-unsigned int ForwardMaterial::sceneVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
-unsigned int ForwardMaterial::sceneFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+UniformRange ForwardMaterial::sceneVertexShaderUniformRange{};
+UniformRange ForwardMaterial::sceneFragmentShaderUniformRange{};
 
 ForwardMaterial::SceneVertexShaderUniformBlock ForwardMaterial::sceneVertexShaderUniformBlock{};
 ForwardMaterial::SceneFragmentShaderUniformBlock ForwardMaterial::sceneFragmentShaderUniformBlock{};
@@ -1238,6 +2353,7 @@ ForwardMaterial::ForwardMaterial()
 			program.import(g_shadersPath + "forwardVertexShader.glsl", g_shadersPath + "forwardFragmentShader.glsl");
 			//program.addFragmentShaderInclude(g_shadersPath + "lighting.glsl");
 			addLightingShaderSource(program);
+			program.addFragmentShaderInclude(g_shadersPath + "clusteredLighting.glsl");
 			program.addFragmentShaderInclude(g_shadersPath + "normalMapping.glsl");
 			g_programLibrary.add("ShipProgram", program);
 		}
@@ -1245,15 +2361,6 @@ ForwardMaterial::ForwardMaterial()
 		gpuProgram = g_programLibrary.get("ShipProgram");
 	}
 
-	if (sceneVertexShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
-	{
-		sceneVertexShaderUniformBufferId = createUniformBuffer<SceneVertexShaderUniformBlock>();
-		sceneFragmentShaderUniformBufferId = createUniformBuffer<SceneFragmentShaderUniformBlock>();
-	}
-
-	objectVertexShaderUniformBufferId = createUniformBuffer<ObjectVertexShaderUniformBlock>();
-	objectFragmentShaderUniformBufferId = createUniformBuffer<ObjectFragmentShaderUniformBlock>();
-
 	//TODO: add defaults
 	objectFragmentShaderUniformBlock.u_textCoordScaleAndTranslate = glm::vec4{ 1.0f, 1.0f, 0.0f, 0.0f };
 }
@@ -1263,46 +2370,37 @@ void ForwardMaterial::bind()
 	gpuProgram.bind();
 
 	//here we assume the binding index for the uniform blocks
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, sceneVertexShaderUniformBufferId, 0, sizeof(SceneVertexShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 2, sceneFragmentShaderUniformBufferId, 0, sizeof(SceneFragmentShaderUniformBlock)));
+	sceneVertexShaderUniformRange.bind(0);
+	sceneFragmentShaderUniformRange.bind(2);
 
 	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
 	{
 		if (dirShadowMaps[i].textureId != INVALID_GRAPHICS_RESOURCE_ID)
 		{
-			OPENGL_CALL(glActiveTexture(GL_TEXTURE4 + i));
-			OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, dirShadowMaps[i].textureId));
+			g_glState.activeTexture(4 + i);
+			g_glState.bindTexture(GL_TEXTURE_2D, dirShadowMaps[i].textureId);
 		}
 	}
+
+	sceneRendering.clusteredLighting.bind();
 }
 
-void ForwardMaterial::bindInstance()const
+void ForwardMaterial::bindObjectUniforms()const
 {
-	gpuProgram.bind();
-
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 1, objectVertexShaderUniformBufferId, 0, sizeof(ObjectVertexShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 3, objectFragmentShaderUniformBufferId, 0, sizeof(ObjectFragmentShaderUniformBlock)));
-
-	//here we assume that diffuseMap's binding index is 0
-	bindTextureIfValid(diffuseMap, 0);
-
-	//here we assume that normalMap's binding index is 1
-	bindTextureIfValid(normalMap, 1);
+	objectFragmentShaderUniformRange.bind(3);
+}
 
-	//same here with 2
-	bindTextureIfValid(specularMap, 2);
+bool ForwardMaterial::looksLike(const ForwardMaterial& other)const
+{
+	return diffuseMap.textureId == other.diffuseMap.textureId &&
+		normalMap.textureId == other.normalMap.textureId &&
+		specularMap.textureId == other.specularMap.textureId &&
+		std::memcmp(&objectFragmentShaderUniformBlock, &other.objectFragmentShaderUniformBlock, sizeof(ObjectFragmentShaderUniformBlock)) == 0;
 }
 
 void ForwardMaterial::updateUniforms()
 {	
-	//TODO: add dirty flags and checks	
-	updateUniformBlock(objectVertexShaderUniformBlock, objectVertexShaderUniformBufferId);
-	updateUniformBlock(objectFragmentShaderUniformBlock, objectFragmentShaderUniformBufferId);
-}
-
-void ForwardMaterial::setWorldTransform(const glm::mat4& world)
-{
-	objectVertexShaderUniformBlock.u_world = world;
+	objectFragmentShaderUniformRange = g_uniformRing.push(objectFragmentShaderUniformBlock);
 }
 
 void ForwardMaterial::setSpecularColor(const glm::vec3& specularColor)
@@ -1330,32 +2428,32 @@ void ForwardMaterial::setTextCoordTranslate(const glm::vec2& textCoordTranslate)
 
 void ForwardMaterial::updateSceneData()
 {
-	sceneVertexShaderUniformBlock.u_projView = scene.camera.projectionViewTransform;
+	sceneVertexShaderUniformBlock.u_projView = sceneRendering.camera.projectionViewTransform;
 
-	sceneFragmentShaderUniformBlock.u_eyePosition = scene.camera.transform.pos;
-	sceneFragmentShaderUniformBlock.u_ambientLight = scene.lighting->ambientLight;
+	sceneFragmentShaderUniformBlock.u_eyePosition = sceneRendering.camera.transform.pos;
+	sceneFragmentShaderUniformBlock.u_ambientLight = sceneRendering.lighting->ambientLight;
+
+	sceneFragmentShaderUniformBlock.u_shadowCascadeFarDepths = sceneRendering.shadowMapRenderer->cascadeFarDepths;
 
 	for (int i = 0; i < DIR_LIGHT_COUNT; ++i)
 	{
-		sceneVertexShaderUniformBlock.u_dirShadowTransforms[i] = scene.shadowMapRenderer->dirLightProjectionViews[i];
+		for (int c = 0; c < SHADOW_CASCADE_COUNT; ++c)
+		{
+			sceneFragmentShaderUniformBlock.u_dirShadowTransforms[i * SHADOW_CASCADE_COUNT + c] = sceneRendering.shadowMapRenderer->dirLightProjectionViews[i][c];
+		}
 
-		sceneFragmentShaderUniformBlock.u_directionalLights[i] = scene.lighting->directionalLights[i];
+		sceneFragmentShaderUniformBlock.u_directionalLights[i] = sceneRendering.lighting->directionalLights[i];
 
 		glm::vec4& shadowMapSizeAndBias = sceneFragmentShaderUniformBlock.u_dirShadowMapSizeAndBias[i];
-		shadowMapSizeAndBias.x = static_cast<float>(scene.shadowMapRenderer->dirLightShadowMaps[i].width);
-		shadowMapSizeAndBias.y = static_cast<float>(scene.shadowMapRenderer->dirLightShadowMaps[i].height);
-		shadowMapSizeAndBias.z = scene.shadowMapRenderer->dirLightShadowMaps[i].bias;
-
-		dirShadowMaps[i] = scene.shadowMapRenderer->dirLightShadowMaps[i].depthTexture;
-	}
+		shadowMapSizeAndBias.x = static_cast<float>(sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].width);
+		shadowMapSizeAndBias.y = static_cast<float>(sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].height);
+		shadowMapSizeAndBias.z = sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].bias;
 
-	for (int i = 0; i < POINT_LIGHT_COUNT; ++i)
-	{
-		sceneFragmentShaderUniformBlock.u_pointLights[i] = scene.lighting->pointLights[i];
+		dirShadowMaps[i] = sceneRendering.shadowMapRenderer->dirLightShadowMaps[i].depthTexture;
 	}
 
-	updateUniformBlock(sceneFragmentShaderUniformBlock, sceneFragmentShaderUniformBufferId);
-	updateUniformBlock(sceneVertexShaderUniformBlock, sceneVertexShaderUniformBufferId);
+	sceneFragmentShaderUniformRange = g_uniformRing.push(sceneFragmentShaderUniformBlock);
+	sceneVertexShaderUniformRange = g_uniformRing.push(sceneVertexShaderUniformBlock);
 }
 
 
@@ -1364,7 +2462,7 @@ void ForwardMaterial::updateSceneData()
 void ShadowMap::init(unsigned int width, unsigned int height)
 {
 	OPENGL_CALL(glGenFramebuffers(1, &frameBufferObjectId));
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, frameBufferObjectId));
+	g_glState.bindFramebuffer(frameBufferObjectId);
 
 	OPENGL_CALL(glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture.textureId));
 
@@ -1377,7 +2475,7 @@ void ShadowMap::init(unsigned int width, unsigned int height)
 
 	resize(width, height);
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, 0));//TODO: fetch current texture object id and rebind it here
+	g_glState.bindTexture(GL_TEXTURE_2D, 0);//TODO: fetch current texture object id and rebind it here
 
 	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture.textureId, 0));
 
@@ -1385,7 +2483,7 @@ void ShadowMap::init(unsigned int width, unsigned int height)
 
 	OPENGL_CALL(glDrawBuffer(GL_NONE));
 
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0)); //TODO: fetch current frame buffer object id and rebind it here
+	g_glState.bindFramebuffer(0); //TODO: fetch current frame buffer object id and rebind it here
 }
 
 void ShadowMap::resize(unsigned int _width, unsigned int _height)
@@ -1398,7 +2496,7 @@ void ShadowMap::resize(unsigned int _width, unsigned int _height)
 	assert(depthTexture.textureId != INVALID_GRAPHICS_RESOURCE_ID);
 	depthTexture.bind();
 	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, _width, _height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr));
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, 0)); //TODO: fetch current texture id and rebind it here
+	g_glState.bindTexture(GL_TEXTURE_2D, 0); //TODO: fetch current texture id and rebind it here
 
 	width = _width;
 	height = _height;
@@ -1406,7 +2504,7 @@ void ShadowMap::resize(unsigned int _width, unsigned int _height)
 
 void ShadowMap::bindAsDepthBuffer()const
 {
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, frameBufferObjectId));
+	g_glState.bindFramebuffer(frameBufferObjectId);
 
 	OPENGL_CALL(glClear(GL_DEPTH_BUFFER_BIT));
 
@@ -1420,7 +2518,7 @@ void ShadowMap::bindAsSampler()const
 
 void ShadowMap::unbind()const
 {
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	g_glState.bindFramebuffer(0);
 }
 
 void ShadowMap::release()
@@ -1428,6 +2526,7 @@ void ShadowMap::release()
 	if (frameBufferObjectId != INVALID_GRAPHICS_RESOURCE_ID)
 	{
 		OPENGL_CALL(glDeleteFramebuffers(1, &frameBufferObjectId));
+		g_glState.invalidate();
 		frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
 	}
 
@@ -1451,34 +2550,19 @@ ShadowMapMaterial::ShadowMapMaterial()
 
 		gpuProgram = g_programLibrary.get("ShadowMapProgram");
 	}
-
-	lightVertexShaderUniformBufferId = createUniformBuffer<LightVertexShaderUniformBlock>();
-	objectVertexShaderUniformBufferId = createUniformBuffer<ObjectVertexShaderUniformBlock>();
-}
-
-void ShadowMapMaterial::setWorldTransform(const glm::mat4& world)
-{
-	objectVertexShaderUniformBlock.u_world = world;
 }
 
-void ShadowMapMaterial::bindInstance()const
+void ShadowMapMaterial::bind()const
 {
 	gpuProgram.bind();
 
 	//here we assume the binding index for the uniform blocks
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, lightVertexShaderUniformBufferId, 0, sizeof(LightVertexShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 1, objectVertexShaderUniformBufferId, 0, sizeof(ObjectVertexShaderUniformBlock)));
-}
-
-void ShadowMapMaterial::updateObjectUniforms()
-{
-	//TODO: add dirty flags and checks	
-	updateUniformBlock(objectVertexShaderUniformBlock, objectVertexShaderUniformBufferId);
+	lightVertexShaderUniformRange.bind(0);
 }
 
 void ShadowMapMaterial::updateLightUniforms()
 {	
-	updateUniformBlock(lightVertexShaderUniformBlock, lightVertexShaderUniformBufferId);
+	lightVertexShaderUniformRange = g_uniformRing.push(lightVertexShaderUniformBlock);
 }
 
 void ShadowMapMaterial::setLightProjectionView(const glm::mat4& lightProjectionView)
@@ -1498,14 +2582,16 @@ SSAOMaterial::SceneVertexShaderUniformBlock SSAOMaterial::sceneVertexShaderUnifo
 SSAOMaterial::SceneFragmentShaderUniformBlock SSAOMaterial::sceneFragmentShaderUniformBlock{};
 SSAOMaterial::ConstantFragmentShaderUniformBlock SSAOMaterial::constantFragmentShaderUniformBlock{};
 
-unsigned int SSAOMaterial::sceneVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
-unsigned int SSAOMaterial::sceneFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+UniformRange SSAOMaterial::sceneVertexShaderUniformRange{};
+UniformRange SSAOMaterial::sceneFragmentShaderUniformRange{};
 unsigned int SSAOMaterial::constantFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
 
 GpuTexture SSAOMaterial::depthBuffer{};
 GpuTexture SSAOMaterial::normalBuffer{};
 GpuTexture SSAOMaterial::randomDirectionsTexture{};
 
+unsigned int SSAOMaterial::frameIndex = 0;
+
 SSAOMaterial::SSAOMaterial()
 {
 	if (gpuProgram.programId == INVALID_GRAPHICS_RESOURCE_ID)
@@ -1514,10 +2600,15 @@ SSAOMaterial::SSAOMaterial()
 		{
 			CpuProgram program;
 			program.import(g_shadersPath + "ssaoVertexShader.glsl", g_shadersPath + "ssaoFragmentShader.glsl");
-			program.addFragmentShaderInclude(g_shadersPath + "positionReconstruction.glsl");
+			addGBufferShaderSource(program);
 
 			ShaderSource defines;
-			defines.shaderSource = "#define SAMPLES_COUNT " + std::to_string(SSAO_SAMPLES_COUNT) + "\n";
+			defines.shaderSource = "#define KERNEL_SIZE " + std::to_string(SSAO_SAMPLES_COUNT) + "\n";
+#ifdef SSAO_TEMPORAL
+			defines.shaderSource += "#define SAMPLES_COUNT " + std::to_string(SSAO_TEMPORAL_SAMPLES_COUNT) + "\n";
+#else
+			defines.shaderSource += "#define SAMPLES_COUNT " + std::to_string(SSAO_SAMPLES_COUNT) + "\n";
+#endif
 			defines.shaderSource += "#define OCCLUSION_RADIUS " + std::to_string(SSAO_OCCLUSION_RADIUS) + "\n";
 			defines.shaderSource += "#define EPSILON " + std::to_string(SSAO_EPSILON) + "\n";
 			defines.shaderSource += "#define MIN_DISTANCE " + std::to_string(SSAO_MIN_DISTANCE) + "\n";
@@ -1531,180 +2622,354 @@ SSAOMaterial::SSAOMaterial()
 		gpuProgram = g_programLibrary.get("SSAOProgram");
 	}
 		
-	if (sceneVertexShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
+	if (constantFragmentShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
 	{
-		sceneVertexShaderUniformBufferId = createUniformBuffer<SceneVertexShaderUniformBlock>();
-		sceneFragmentShaderUniformBufferId = createUniformBuffer<SceneFragmentShaderUniformBlock>();
 		constantFragmentShaderUniformBufferId = createUniformBuffer<ConstantFragmentShaderUniformBlock>();
 		
 		sceneFragmentShaderUniformBlock.u_randomDirectionTiling = glm::vec2{ 2.0f, 2.0f };
 
-		//uniformly distributed vectors: corners and face centers of the [-1, 1]^3 cube
-		glm::vec4* sampleOffsets = constantFragmentShaderUniformBlock.u_sampleOffsets;
+		//uniformly distributed vectors: corners and face centers of the [-1, 1]^3 cube
+		glm::vec4* sampleOffsets = constantFragmentShaderUniformBlock.u_sampleOffsets;
+
+		//corners
+		sampleOffsets[0] = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+		sampleOffsets[1] = glm::vec4(-1.0f, -1.0f, -1.0f, 0.0f);
+
+		sampleOffsets[2] = glm::vec4(-1.0f, 1.0f, 1.0f, 0.0f);
+		sampleOffsets[3] = glm::vec4(1.0f, -1.0f, -1.0f, 0.0f);
+
+		sampleOffsets[4] = glm::vec4(1.0f, 1.0f, -1.0f, 0.0f);
+		sampleOffsets[5] = glm::vec4(-1.0f, -1.0f, 1.0f, 0.0f);
+
+		sampleOffsets[6] = glm::vec4(-1.0f, 1.0f, -1.0f, 0.0f);
+		sampleOffsets[7] = glm::vec4(1.0f, -1.0f, 1.0f, 0.0f);
+
+		//face centers
+		sampleOffsets[8] = glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f);
+		sampleOffsets[9] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+
+		sampleOffsets[10] = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+		sampleOffsets[11] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+
+		sampleOffsets[12] = glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+		sampleOffsets[13] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+
+		for (int i = 0; i < SSAO_SAMPLES_COUNT; ++i)
+		{	
+			sampleOffsets[i] = glm::linearRand<float>(0.25, 1.0f) * glm::normalize(sampleOffsets[i]);
+		}
+
+		updateUniformBlock(constantFragmentShaderUniformBlock, constantFragmentShaderUniformBufferId);		
+	}
+
+	if (randomDirectionsTexture.textureId == INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		if (!g_textureLibrary.exists("RandomDirectionsTexture"))
+		{
+			CpuTexture randomDirTexture;
+			randomDirTexture.createRandom(RANDOM_DIRECTION_TEXTURE_SIZE);
+			randomDirTexture.isLinear = true;
+			g_textureLibrary.add("RandomDirectionsTexture", randomDirTexture);
+		}
+
+		randomDirectionsTexture = g_textureLibrary.get("RandomDirectionsTexture");
+	}
+}
+
+void SSAOMaterial::bind()
+{
+	gpuProgram.bind();
+
+	//here we assume the binding index for the uniform blocks
+	sceneVertexShaderUniformRange.bind(0);
+	sceneFragmentShaderUniformRange.bind(1);
+	g_glState.bindUniformBufferRange(2, constantFragmentShaderUniformBufferId, 0, sizeof(ConstantFragmentShaderUniformBlock));
+
+	bindTextureIfValid(depthBuffer, 0);
+	bindTextureIfValid(normalBuffer, 1);
+	bindTextureIfValid(randomDirectionsTexture, 2);	
+}
+
+void SSAOMaterial::updateSceneData()
+{
+	sceneVertexShaderUniformBlock.u_invProjection = sceneRendering.camera.invProjectionTransform;
+	sceneFragmentShaderUniformBlock.u_projection = sceneRendering.camera.projectionTransform;
+	sceneFragmentShaderUniformBlock.u_frustumNear = sceneRendering.camera.nearPlane;
+	sceneFragmentShaderUniformBlock.u_frustumFar = sceneRendering.camera.farPlane;
+
+#ifdef SSAO_TEMPORAL
+	//the next run of samples, and a new rotation for each pixel: the offsets follow the R2 sequence,
+	//so that the rotations of consecutive frames are far apart
+	sceneFragmentShaderUniformBlock.u_firstSampleIndex = (frameIndex * SSAO_TEMPORAL_SAMPLES_COUNT) % SSAO_SAMPLES_COUNT;
+	sceneFragmentShaderUniformBlock.u_randomDirectionOffset = glm::fract(static_cast<float>(frameIndex % 4096) * glm::vec2(0.7548776662f, 0.5698402910f));
+	++frameIndex;
+#endif
+	
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
+
+	//we should not use the normal-mapped normal buffer, but for this particular use case
+	//it's not worth using another buffer and therefore more bandwidth
+	normalBuffer = sceneRendering.deferredRenderer->gbuffer.normalTexture;
+
+	sceneVertexShaderUniformRange = g_uniformRing.push(sceneVertexShaderUniformBlock);
+	sceneFragmentShaderUniformRange = g_uniformRing.push(sceneFragmentShaderUniformBlock);
+}
+
+/*		SSAOMap		*/
+
+void SSAOMap::init(unsigned int width, unsigned int height)
+{
+	OPENGL_CALL(glGenFramebuffers(1, &frameBufferObjectId));
+	g_glState.bindFramebuffer(frameBufferObjectId);
+	
+	OPENGL_CALL(glCreateTextures(GL_TEXTURE_2D, 1, &ssaoTexture.textureId));
+
+	ssaoTexture.bind();
+
+	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+		
+	resize(width, height);
+
+	g_glState.bindTexture(GL_TEXTURE_2D, 0);//TODO: fetch current texture object id and rebind it here
+
+	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, ssaoTexture.textureId, 0));
+
+	OPENGL_CALL(glCreateRenderbuffers(1, &renderBufferObjectId));
+	OPENGL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, renderBufferObjectId));
+	OPENGL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+	
+	OPENGL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderBufferObjectId));
+
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+
+	GLenum colorBuffers[] = { GL_COLOR_ATTACHMENT0 };
+	OPENGL_CALL(glDrawBuffers(1, colorBuffers));
+
+	OPENGL_CALL(glClearColor(1.0f, 0.0f, 0.0f, 0.0f));
+	OPENGL_CALL(glClear(GL_COLOR_BUFFER_BIT));
+		
+	g_glState.bindFramebuffer(0); //TODO: fetch current frame buffer object id and rebind it here
+}
+
+void SSAOMap::resize(unsigned int _width, unsigned int _height)
+{
+	if (_width == width && _height == height)
+	{
+		return;
+	}
+
+	assert(ssaoTexture.textureId != INVALID_GRAPHICS_RESOURCE_ID);
+
+	ssaoTexture.bind();
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, _width, _height, 0, GL_RGB, GL_FLOAT, nullptr));
+
+	g_glState.bindTexture(GL_TEXTURE_2D, 0); //TODO: fetch current texture id and rebind it here
+
+	width = _width;
+	height = _height;
+}
+
+void SSAOMap::bind()const
+{
+	g_glState.bindFramebuffer(frameBufferObjectId);
+
+	OPENGL_CALL(glClearColor(1.0f, 0.0f, 0.0f, 0.0f));
+	OPENGL_CALL(glClear(GL_COLOR_BUFFER_BIT));
+
+	OPENGL_CALL(glViewport(0, 0, width, height));
+}
+
+void SSAOMap::unbind()const
+{
+	g_glState.bindFramebuffer(0);
+}
+
+void SSAOMap::release()
+{	
+	if (frameBufferObjectId != INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		OPENGL_CALL(glDeleteFramebuffers(1, &frameBufferObjectId));
+		g_glState.invalidate();
+		frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;		
+	}
+
+	if (renderBufferObjectId != INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		OPENGL_CALL(glDeleteRenderbuffers(1, &renderBufferObjectId));
+		renderBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
+	}
+
+	ssaoTexture.release();
+}
+
+
+/*		SSAODepthNormalMap		*/
+
+void SSAODepthNormalMap::init(unsigned int width, unsigned int height)
+{
+	OPENGL_CALL(glGenFramebuffers(1, &frameBufferObjectId));
+	g_glState.bindFramebuffer(frameBufferObjectId);
+
+	unsigned int texturesIds[] = { INVALID_GRAPHICS_RESOURCE_ID, INVALID_GRAPHICS_RESOURCE_ID };
+
+	OPENGL_CALL(glCreateTextures(GL_TEXTURE_2D, 2, texturesIds));
+
+	depthTexture.textureId = texturesIds[0];
+	normalTexture.textureId = texturesIds[1];
+
+	depthTexture.bind();
+	initGBufferComponentParameters();
+
+	normalTexture.bind();
+	initGBufferComponentParameters();
+
+	resize(width, height);
 
-		//corners
-		sampleOffsets[0] = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
-		sampleOffsets[1] = glm::vec4(-1.0f, -1.0f, -1.0f, 0.0f);
+	g_glState.bindTexture(GL_TEXTURE_2D, 0);//TODO: fetch current texture object id and rebind it here
 
-		sampleOffsets[2] = glm::vec4(-1.0f, 1.0f, 1.0f, 0.0f);
-		sampleOffsets[3] = glm::vec4(1.0f, -1.0f, -1.0f, 0.0f);
+	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, depthTexture.textureId, 0));
+	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, normalTexture.textureId, 0));
 
-		sampleOffsets[4] = glm::vec4(1.0f, 1.0f, -1.0f, 0.0f);
-		sampleOffsets[5] = glm::vec4(-1.0f, -1.0f, 1.0f, 0.0f);
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
 
-		sampleOffsets[6] = glm::vec4(-1.0f, 1.0f, -1.0f, 0.0f);
-		sampleOffsets[7] = glm::vec4(1.0f, -1.0f, 1.0f, 0.0f);
+	GLenum colorBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	OPENGL_CALL(glDrawBuffers(2, colorBuffers));
 
-		//face centers
-		sampleOffsets[8] = glm::vec4(-1.0f, 0.0f, 0.0f, 0.0f);
-		sampleOffsets[9] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+	g_glState.bindFramebuffer(0); //TODO: fetch current frame buffer object id and rebind it here
+}
 
-		sampleOffsets[10] = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-		sampleOffsets[11] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+void SSAODepthNormalMap::resize(unsigned int _width, unsigned int _height)
+{
+	if (_width == width && _height == height)
+	{
+		return;
+	}
 
-		sampleOffsets[12] = glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
-		sampleOffsets[13] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+	assert(depthTexture.textureId != INVALID_GRAPHICS_RESOURCE_ID);
+	assert(normalTexture.textureId != INVALID_GRAPHICS_RESOURCE_ID);
 
-		for (int i = 0; i < SSAO_SAMPLES_COUNT; ++i)
-		{	
-			sampleOffsets[i] = glm::linearRand<float>(0.25, 1.0f) * glm::normalize(sampleOffsets[i]);
-		}
+	//the depth is a color here (it is written by a fragment shader), with the precision of the G-buffer one
+	depthTexture.bind();
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, _width, _height, 0, GL_RED, GL_FLOAT, nullptr));
 
-		updateUniformBlock(constantFragmentShaderUniformBlock, constantFragmentShaderUniformBufferId);		
-	}
+	normalTexture.bind();
+#ifdef COMPACT_GBUFFER
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, _width, _height, 0, GL_RG, GL_UNSIGNED_SHORT, nullptr));
+#else
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, _width, _height, 0, GL_RGBA, GL_FLOAT, nullptr));
+#endif
 
-	if (randomDirectionsTexture.textureId == INVALID_GRAPHICS_RESOURCE_ID)
-	{
-		if (!g_textureLibrary.exists("RandomDirectionsTexture"))
-		{
-			CpuTexture randomDirTexture;
-			randomDirTexture.createRandom(kRandomDirectionTextureSize);
-			randomDirTexture.isLinear = true;
-			g_textureLibrary.add("RandomDirectionsTexture", randomDirTexture);
-		}
+	g_glState.bindTexture(GL_TEXTURE_2D, 0); //TODO: fetch current texture id and rebind it here
 
-		randomDirectionsTexture = g_textureLibrary.get("RandomDirectionsTexture");
-	}
+	width = _width;
+	height = _height;
 }
 
-void SSAOMaterial::bind()
+void SSAODepthNormalMap::bind()const
 {
-	gpuProgram.bind();
-
-	//here we assume the binding index for the uniform blocks
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, sceneVertexShaderUniformBufferId, 0, sizeof(SceneVertexShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 1, sceneFragmentShaderUniformBufferId, 0, sizeof(SceneFragmentShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 2, constantFragmentShaderUniformBufferId, 0, sizeof(ConstantFragmentShaderUniformBlock)));
+	g_glState.bindFramebuffer(frameBufferObjectId);
 
-	bindTextureIfValid(depthBuffer, 0);
-	bindTextureIfValid(normalBuffer, 1);
-	bindTextureIfValid(randomDirectionsTexture, 2);	
+	OPENGL_CALL(glViewport(0, 0, width, height));
 }
 
-void SSAOMaterial::updateSceneData()
+void SSAODepthNormalMap::unbind()const
 {
-	sceneVertexShaderUniformBlock.u_invProjection = scene.camera.invProjectionTransform;
-	sceneFragmentShaderUniformBlock.u_projection = scene.camera.projectionTransform;
-	sceneFragmentShaderUniformBlock.u_frustumNear = scene.camera.nearPlane;
-	sceneFragmentShaderUniformBlock.u_frustumFar = scene.camera.farPlane;
-	
-	depthBuffer = scene.deferredRenderer->gbuffer.depthTexture;
+	g_glState.bindFramebuffer(0);
+}
 
-	//we should not use the normal-mapped normal buffer, but for this particular use case
-	//it's not worth using another buffer and therefore more bandwidth
-	normalBuffer = scene.deferredRenderer->gbuffer.normalTexture;
+void SSAODepthNormalMap::release()
+{
+	if (frameBufferObjectId != INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		OPENGL_CALL(glDeleteFramebuffers(1, &frameBufferObjectId));
+		g_glState.invalidate();
+		frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
+	}
 
-	updateUniformBlock(sceneVertexShaderUniformBlock, sceneVertexShaderUniformBufferId);
-	updateUniformBlock(sceneFragmentShaderUniformBlock, sceneFragmentShaderUniformBufferId);		
+	depthTexture.release();
+	normalTexture.release();
 }
 
-/*		SSAOMap		*/
 
-void SSAOMap::init(unsigned int width, unsigned int height)
+/*		SSAOHistoryMap		*/
+
+void SSAOHistoryMap::init(unsigned int width, unsigned int height)
 {
 	OPENGL_CALL(glGenFramebuffers(1, &frameBufferObjectId));
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, frameBufferObjectId));
-	
-	OPENGL_CALL(glCreateTextures(GL_TEXTURE_2D, 1, &ssaoTexture.textureId));
+	g_glState.bindFramebuffer(frameBufferObjectId);
 
-	ssaoTexture.bind();
+	OPENGL_CALL(glCreateTextures(GL_TEXTURE_2D, 1, &historyTexture.textureId));
 
-	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
-	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	historyTexture.bind();
+
+	//reprojected lookups fall between the texels
+	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
 	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
 	OPENGL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-		
-	resize(width, height);
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, 0));//TODO: fetch current texture object id and rebind it here
+	resize(width, height);
 
-	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, ssaoTexture.textureId, 0));
+	g_glState.bindTexture(GL_TEXTURE_2D, 0);//TODO: fetch current texture object id and rebind it here
 
-	OPENGL_CALL(glCreateRenderbuffers(1, &renderBufferObjectId));
-	OPENGL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, renderBufferObjectId));
-	OPENGL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
-	
-	OPENGL_CALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderBufferObjectId));
+	OPENGL_CALL(glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, historyTexture.textureId, 0));
 
 	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
 
 	GLenum colorBuffers[] = { GL_COLOR_ATTACHMENT0 };
 	OPENGL_CALL(glDrawBuffers(1, colorBuffers));
 
+	//no occlusion, at a depth nothing lies at: the first frame finds no history to keep
 	OPENGL_CALL(glClearColor(1.0f, 0.0f, 0.0f, 0.0f));
 	OPENGL_CALL(glClear(GL_COLOR_BUFFER_BIT));
-		
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0)); //TODO: fetch current frame buffer object id and rebind it here
+
+	g_glState.bindFramebuffer(0); //TODO: fetch current frame buffer object id and rebind it here
 }
 
-void SSAOMap::resize(unsigned int _width, unsigned int _height)
+void SSAOHistoryMap::resize(unsigned int _width, unsigned int _height)
 {
 	if (_width == width && _height == height)
 	{
 		return;
 	}
 
-	assert(ssaoTexture.textureId != INVALID_GRAPHICS_RESOURCE_ID);
+	assert(historyTexture.textureId != INVALID_GRAPHICS_RESOURCE_ID);
 
-	ssaoTexture.bind();
-	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, _width, _height, 0, GL_RGB, GL_FLOAT, nullptr));
+	historyTexture.bind();
+	OPENGL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, _width, _height, 0, GL_RG, GL_FLOAT, nullptr));
 
-	OPENGL_CALL(glBindTexture(GL_TEXTURE_2D, 0)); //TODO: fetch current texture id and rebind it here
+	g_glState.bindTexture(GL_TEXTURE_2D, 0); //TODO: fetch current texture id and rebind it here
 
 	width = _width;
 	height = _height;
 }
 
-void SSAOMap::bind()const
+void SSAOHistoryMap::bind()const
 {
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, frameBufferObjectId));
-
-	OPENGL_CALL(glClearColor(1.0f, 0.0f, 0.0f, 0.0f));
-	OPENGL_CALL(glClear(GL_COLOR_BUFFER_BIT));
+	//every texel is written: no need to clear
+	g_glState.bindFramebuffer(frameBufferObjectId);
 
 	OPENGL_CALL(glViewport(0, 0, width, height));
 }
 
-void SSAOMap::unbind()const
+void SSAOHistoryMap::unbind()const
 {
-	OPENGL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	g_glState.bindFramebuffer(0);
 }
 
-void SSAOMap::release()
-{	
+void SSAOHistoryMap::release()
+{
 	if (frameBufferObjectId != INVALID_GRAPHICS_RESOURCE_ID)
 	{
 		OPENGL_CALL(glDeleteFramebuffers(1, &frameBufferObjectId));
-		frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;		
-	}
-
-	if (renderBufferObjectId != INVALID_GRAPHICS_RESOURCE_ID)
-	{
-		OPENGL_CALL(glDeleteRenderbuffers(1, &renderBufferObjectId));
-		renderBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
+		g_glState.invalidate();
+		frameBufferObjectId = INVALID_GRAPHICS_RESOURCE_ID;
 	}
 
-	ssaoTexture.release();
+	historyTexture.release();
 }
 
 
@@ -1713,51 +2978,135 @@ void SSAOMap::release()
 SSAORenderer::SSAORenderer()
 {
 	ssaoMap.init(windowWidth, windowHeight);
+
+#ifdef SSAO_HALF_RESOLUTION
+	const unsigned int halfWidth = (std::max)(windowWidth / 2, 1u);
+	const unsigned int halfHeight = (std::max)(windowHeight / 2, 1u);
+
+	halfResolutionDepthNormalMap.init(halfWidth, halfHeight);
+	halfResolutionSsaoMap.init(halfWidth, halfHeight);
+	halfResolutionBlurIntermediateBuffer.init(halfWidth, halfHeight);
+#else
 	blurIntermediateBuffer.init(windowWidth, windowHeight);
+#endif
+
+#ifdef SSAO_TEMPORAL
+#ifdef SSAO_HALF_RESOLUTION
+	historyMaps[0].init(halfWidth, halfHeight);
+	historyMaps[1].init(halfWidth, halfHeight);
+#else
+	historyMaps[0].init(windowWidth, windowHeight);
+	historyMaps[1].init(windowWidth, windowHeight);
+#endif
+#endif
 
 	fullScreenQuad = getFullScreenQuad();
 }
 
-void SSAORenderer::render()const
+void SSAORenderer::render()
 {
-	OPENGL_CALL(glDisable(GL_DEPTH_TEST));
+	g_glState.disable(GL_DEPTH_TEST);
 
-	SSAOMaterial::updateSceneData();
-	SSAOMaterial::bind();
+#ifdef SSAO_HALF_RESOLUTION
+	DepthNormalDownsampleMaterial::updateSceneData();
+	DepthNormalDownsampleMaterial::bind();
+
+	halfResolutionDepthNormalMap.bind();
+
+	fullScreenQuad.bind();
+	fullScreenQuad.render();
+
+	halfResolutionDepthNormalMap.unbind();
+
+	renderBlurredOcclusion(halfResolutionDepthNormalMap.depthTexture, halfResolutionDepthNormalMap.normalTexture,
+		halfResolutionSsaoMap, halfResolutionBlurIntermediateBuffer);
+
+	BilateralUpsampleMaterial::setLowResolutionSize(glm::vec2(halfResolutionSsaoMap.width, halfResolutionSsaoMap.height));
+	BilateralUpsampleMaterial::updateSceneData();
+
+	BilateralUpsampleMaterial::lowResolutionDepthBuffer = halfResolutionDepthNormalMap.depthTexture;
+	BilateralUpsampleMaterial::lowResolutionNormalBuffer = halfResolutionDepthNormalMap.normalTexture;
+	BilateralUpsampleMaterial::lowResolutionColorMap = halfResolutionSsaoMap.ssaoTexture;
+
+	BilateralUpsampleMaterial::bind();
 
 	ssaoMap.bind();
 
 	fullScreenQuad.bind();
 	fullScreenQuad.render();
-	
+
 	ssaoMap.unbind();
-		
-	EdgePreservingBlurMaterial::setTexelSize(glm::vec2(1.0f/ windowWidth, 1.0f/ windowHeight));
+#else
+	const GBuffer& gbuffer = sceneRendering.deferredRenderer->gbuffer;
+	renderBlurredOcclusion(gbuffer.depthTexture, gbuffer.normalTexture, ssaoMap, blurIntermediateBuffer);
+#endif
+
+	g_glState.enable(GL_DEPTH_TEST);
+}
+
+void SSAORenderer::renderBlurredOcclusion(const GpuTexture& depth, const GpuTexture& normal, const SSAOMap& target, const SSAOMap& intermediate)
+{
+	SSAOMaterial::updateSceneData();
+	SSAOMaterial::depthBuffer = depth;
+	SSAOMaterial::normalBuffer = normal;
+	SSAOMaterial::bind();
+
+	target.bind();
+
+	fullScreenQuad.bind();
+	fullScreenQuad.render();
+
+	target.unbind();
+
+	EdgePreservingBlurMaterial::setTexelSize(glm::vec2(1.0f / target.width, 1.0f / target.height));
 	EdgePreservingBlurMaterial::updateSceneData();
-	
-	EdgePreservingBlurMaterial::colorMap = ssaoMap.ssaoTexture;
+	EdgePreservingBlurMaterial::depthBuffer = depth;
+	EdgePreservingBlurMaterial::normalBuffer = normal;
+
+#ifdef SSAO_TEMPORAL
+	//this frame's samples, blended with the history; the history keeps the unblurred occlusion,
+	//so that the blur does not pile up frame after frame
+	const SSAOHistoryMap& previousHistory = historyMaps[currentHistoryIndex];
+	currentHistoryIndex = 1 - currentHistoryIndex;
+	const SSAOHistoryMap& currentHistory = historyMaps[currentHistoryIndex];
+
+	SSAOTemporalResolveMaterial::updateSceneData();
+	SSAOTemporalResolveMaterial::depthBuffer = depth;
+	SSAOTemporalResolveMaterial::occlusionMap = target.ssaoTexture;
+	SSAOTemporalResolveMaterial::historyMap = previousHistory.historyTexture;
+	SSAOTemporalResolveMaterial::bind();
+
+	currentHistory.bind();
+
+	fullScreenQuad.bind();
+	fullScreenQuad.render();
+
+	currentHistory.unbind();
+
+	EdgePreservingBlurMaterial::colorMap = currentHistory.historyTexture;
+#else
+	EdgePreservingBlurMaterial::colorMap = target.ssaoTexture;
+#endif
 
 	EdgePreservingBlurMaterial::bindHorizontal();
 
-	blurIntermediateBuffer.bind();
+	intermediate.bind();
 
 	fullScreenQuad.bind();
 	fullScreenQuad.render();
 
-	blurIntermediateBuffer.unbind();
+	intermediate.unbind();
 
-	EdgePreservingBlurMaterial::colorMap = blurIntermediateBuffer.ssaoTexture;
+	EdgePreservingBlurMaterial::colorMap = intermediate.ssaoTexture;
 
 	EdgePreservingBlurMaterial::bindVertical();
 
-	ssaoMap.bind();
+	target.bind();
 
 	fullScreenQuad.bind();
 	fullScreenQuad.render();
 
-	ssaoMap.unbind();
-	
-	OPENGL_CALL(glEnable(GL_DEPTH_TEST));
+	target.unbind();
 }
 
 
@@ -1768,7 +3117,7 @@ GpuProgram EdgePreservingBlurMaterial::verticalGpuProgram{};
 EdgePreservingBlurMaterial::SceneFragmentShaderUniformBlock EdgePreservingBlurMaterial::sceneFragmentShaderUniformBlock{};
 EdgePreservingBlurMaterial::ConstantFragmentShaderUniformBlock EdgePreservingBlurMaterial::constantFragmentShaderUniformBlock{};
 
-unsigned int EdgePreservingBlurMaterial::sceneFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+UniformRange EdgePreservingBlurMaterial::sceneFragmentShaderUniformRange{};
 unsigned int EdgePreservingBlurMaterial::constantFragmentShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
 
 GpuTexture EdgePreservingBlurMaterial::depthBuffer{};
@@ -1827,7 +3176,7 @@ EdgePreservingBlurMaterial::EdgePreservingBlurMaterial()
 			CpuProgram program;
 			program.import(g_shadersPath + "blurVertexShader.glsl", g_shadersPath + "edgePreservingBlurFragmentShader.glsl");
 			
-			program.addFragmentShaderInclude(g_shadersPath + "positionReconstruction.glsl");
+			addGBufferShaderSource(program);
 			program.addFragmentShaderInclude(defines);
 			program.addFragmentShaderInclude(constantFragmentShaderUniformBlockDecl);
 			program.addFragmentShaderInclude(unpackedWeightsDecl);
@@ -1849,7 +3198,7 @@ EdgePreservingBlurMaterial::EdgePreservingBlurMaterial()
 			CpuProgram program;
 			program.import(g_shadersPath + "blurVertexShader.glsl", g_shadersPath + "edgePreservingBlurFragmentShader.glsl");
 
-			program.addFragmentShaderInclude(g_shadersPath + "positionReconstruction.glsl");
+			addGBufferShaderSource(program);
 			program.addFragmentShaderInclude(defines);
 			program.addFragmentShaderInclude(constantFragmentShaderUniformBlockDecl);
 			program.addFragmentShaderInclude(unpackedWeightsDecl);
@@ -1860,9 +3209,8 @@ EdgePreservingBlurMaterial::EdgePreservingBlurMaterial()
 		verticalGpuProgram = g_programLibrary.get("EdgePreservingVerticalBlurProgram");
 	}
 
-	if (sceneFragmentShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
+	if (constantFragmentShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
 	{
-		sceneFragmentShaderUniformBufferId = createUniformBuffer<SceneFragmentShaderUniformBlock>();
 		constantFragmentShaderUniformBufferId = createUniformBuffer<ConstantFragmentShaderUniformBlock>();
 
 		std::vector<float> blurWeights = computeGaussianWeights(1.0f, BLUR_KERNEL_RADIUS);
@@ -1886,8 +3234,8 @@ void EdgePreservingBlurMaterial::bindVertical()
 
 void EdgePreservingBlurMaterial::bind()
 {
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, sceneFragmentShaderUniformBufferId, 0, sizeof(SceneFragmentShaderUniformBlock)));
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 1, constantFragmentShaderUniformBufferId, 0, sizeof(ConstantFragmentShaderUniformBlock)));
+	sceneFragmentShaderUniformRange.bind(0);
+	g_glState.bindUniformBufferRange(1, constantFragmentShaderUniformBufferId, 0, sizeof(ConstantFragmentShaderUniformBlock));
 
 	bindTextureIfValid(depthBuffer, 0);
 	bindTextureIfValid(normalBuffer, 1);
@@ -1901,13 +3249,174 @@ void EdgePreservingBlurMaterial::setTexelSize(glm::vec2 texelSize)
 
 void EdgePreservingBlurMaterial::updateSceneData()
 {	
-	sceneFragmentShaderUniformBlock.u_frustumNear = scene.camera.nearPlane;
-	sceneFragmentShaderUniformBlock.u_frustumFar = scene.camera.farPlane;
+	sceneFragmentShaderUniformBlock.u_frustumNear = sceneRendering.camera.nearPlane;
+	sceneFragmentShaderUniformBlock.u_frustumFar = sceneRendering.camera.farPlane;
+
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
+	normalBuffer = sceneRendering.deferredRenderer->gbuffer.normalTexture;
+
+	sceneFragmentShaderUniformRange = g_uniformRing.push(sceneFragmentShaderUniformBlock);
+}
+
+
+/*		SSAOTemporalResolveMaterial		*/
+
+GpuProgram SSAOTemporalResolveMaterial::gpuProgram{};
+SSAOTemporalResolveMaterial::SceneVertexShaderUniformBlock SSAOTemporalResolveMaterial::sceneVertexShaderUniformBlock{};
+SSAOTemporalResolveMaterial::SceneFragmentShaderUniformBlock SSAOTemporalResolveMaterial::sceneFragmentShaderUniformBlock{};
+
+UniformRange SSAOTemporalResolveMaterial::sceneVertexShaderUniformRange{};
+UniformRange SSAOTemporalResolveMaterial::sceneFragmentShaderUniformRange{};
+
+GpuTexture SSAOTemporalResolveMaterial::depthBuffer{};
+GpuTexture SSAOTemporalResolveMaterial::occlusionMap{};
+GpuTexture SSAOTemporalResolveMaterial::historyMap{};
+
+SSAOTemporalResolveMaterial::SSAOTemporalResolveMaterial()
+{
+	if (gpuProgram.programId == INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		if (!g_programLibrary.exists("SSAOTemporalResolveProgram"))
+		{
+			CpuProgram program;
+			program.import(g_shadersPath + "ssaoVertexShader.glsl", g_shadersPath + "ssaoTemporalResolveFragmentShader.glsl");
+			addGBufferShaderSource(program);
+
+			g_programLibrary.add("SSAOTemporalResolveProgram", program);
+		}
+
+		gpuProgram = g_programLibrary.get("SSAOTemporalResolveProgram");
+	}
+
+	sceneFragmentShaderUniformBlock.u_historyWeight = SSAO_TEMPORAL_HISTORY_WEIGHT;
+	sceneFragmentShaderUniformBlock.u_depthTolerance = SSAO_TEMPORAL_DEPTH_TOLERANCE;
+}
+
+void SSAOTemporalResolveMaterial::bind()
+{
+	gpuProgram.bind();
+
+	sceneVertexShaderUniformRange.bind(0);
+	sceneFragmentShaderUniformRange.bind(1);
+
+	bindTextureIfValid(depthBuffer, 0);
+	bindTextureIfValid(occlusionMap, 1);
+	bindTextureIfValid(historyMap, 2);
+}
+
+void SSAOTemporalResolveMaterial::updateSceneData()
+{
+	const Camera& camera = sceneRendering.camera;
+
+	sceneVertexShaderUniformBlock.u_invProjection = camera.invProjectionTransform;
+
+	//back to the world with this frame's view, then through the previous view-projection
+	sceneFragmentShaderUniformBlock.u_reprojection = camera.prevProjectionViewTransform * camera.invViewTransform;
+	sceneFragmentShaderUniformBlock.u_frustumNear = camera.nearPlane;
+	sceneFragmentShaderUniformBlock.u_frustumFar = camera.farPlane;
+
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
+
+	sceneVertexShaderUniformRange = g_uniformRing.push(sceneVertexShaderUniformBlock);
+	sceneFragmentShaderUniformRange = g_uniformRing.push(sceneFragmentShaderUniformBlock);
+}
+
+
+/*		DepthNormalDownsampleMaterial		*/
+
+GpuProgram DepthNormalDownsampleMaterial::gpuProgram{};
+
+GpuTexture DepthNormalDownsampleMaterial::depthBuffer{};
+GpuTexture DepthNormalDownsampleMaterial::normalBuffer{};
+
+DepthNormalDownsampleMaterial::DepthNormalDownsampleMaterial()
+{
+	if (gpuProgram.programId == INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		if (!g_programLibrary.exists("DepthNormalDownsampleProgram"))
+		{
+			CpuProgram program;
+			program.import(g_shadersPath + "blurVertexShader.glsl", g_shadersPath + "depthNormalDownsampleFragmentShader.glsl");
+
+			g_programLibrary.add("DepthNormalDownsampleProgram", program);
+		}
+
+		gpuProgram = g_programLibrary.get("DepthNormalDownsampleProgram");
+	}
+}
+
+void DepthNormalDownsampleMaterial::bind()
+{
+	gpuProgram.bind();
+
+	bindTextureIfValid(depthBuffer, 0);
+	bindTextureIfValid(normalBuffer, 1);
+}
+
+void DepthNormalDownsampleMaterial::updateSceneData()
+{
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
+	normalBuffer = sceneRendering.deferredRenderer->gbuffer.normalTexture;
+}
 
-	depthBuffer = scene.deferredRenderer->gbuffer.depthTexture;
-	normalBuffer = scene.deferredRenderer->gbuffer.normalTexture;
 
-	updateUniformBlock(sceneFragmentShaderUniformBlock, sceneFragmentShaderUniformBufferId);
+/*		BilateralUpsampleMaterial		*/
+
+GpuProgram BilateralUpsampleMaterial::gpuProgram{};
+BilateralUpsampleMaterial::SceneFragmentShaderUniformBlock BilateralUpsampleMaterial::sceneFragmentShaderUniformBlock{};
+
+UniformRange BilateralUpsampleMaterial::sceneFragmentShaderUniformRange{};
+
+GpuTexture BilateralUpsampleMaterial::depthBuffer{};
+GpuTexture BilateralUpsampleMaterial::normalBuffer{};
+GpuTexture BilateralUpsampleMaterial::lowResolutionDepthBuffer{};
+GpuTexture BilateralUpsampleMaterial::lowResolutionNormalBuffer{};
+GpuTexture BilateralUpsampleMaterial::lowResolutionColorMap{};
+
+BilateralUpsampleMaterial::BilateralUpsampleMaterial()
+{
+	if (gpuProgram.programId == INVALID_GRAPHICS_RESOURCE_ID)
+	{
+		if (!g_programLibrary.exists("BilateralUpsampleProgram"))
+		{
+			CpuProgram program;
+			program.import(g_shadersPath + "blurVertexShader.glsl", g_shadersPath + "bilateralUpsampleFragmentShader.glsl");
+			addGBufferShaderSource(program);
+
+			g_programLibrary.add("BilateralUpsampleProgram", program);
+		}
+
+		gpuProgram = g_programLibrary.get("BilateralUpsampleProgram");
+	}
+}
+
+void BilateralUpsampleMaterial::bind()
+{
+	gpuProgram.bind();
+
+	sceneFragmentShaderUniformRange.bind(0);
+
+	bindTextureIfValid(depthBuffer, 0);
+	bindTextureIfValid(normalBuffer, 1);
+	bindTextureIfValid(lowResolutionDepthBuffer, 2);
+	bindTextureIfValid(lowResolutionNormalBuffer, 3);
+	bindTextureIfValid(lowResolutionColorMap, 4);
+}
+
+void BilateralUpsampleMaterial::setLowResolutionSize(glm::vec2 lowResolutionSize)
+{
+	sceneFragmentShaderUniformBlock.u_lowResolutionSize = lowResolutionSize;
+}
+
+void BilateralUpsampleMaterial::updateSceneData()
+{
+	sceneFragmentShaderUniformBlock.u_frustumNear = sceneRendering.camera.nearPlane;
+	sceneFragmentShaderUniformBlock.u_frustumFar = sceneRendering.camera.farPlane;
+
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
+	normalBuffer = sceneRendering.deferredRenderer->gbuffer.normalTexture;
+
+	sceneFragmentShaderUniformRange = g_uniformRing.push(sceneFragmentShaderUniformBlock);
 }
 
 
@@ -1915,7 +3424,7 @@ void EdgePreservingBlurMaterial::updateSceneData()
 
 GpuProgram SkyBoxMaterial::gpuProgram{};
 SkyBoxMaterial::SceneVertexShaderUniformBlock SkyBoxMaterial::sceneVertexShaderUniformBlock{};
-unsigned int SkyBoxMaterial::sceneVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+UniformRange SkyBoxMaterial::sceneVertexShaderUniformRange{};
 #ifndef FORWARD_RENDER
 GpuTexture SkyBoxMaterial::depthBuffer{};
 #endif
@@ -1947,17 +3456,12 @@ SkyBoxMaterial::SkyBoxMaterial()
 
 		gpuProgram = g_programLibrary.get("SkyBoxProgram");
 	}
-
-	if (sceneVertexShaderUniformBufferId == INVALID_GRAPHICS_RESOURCE_ID)
-	{
-		sceneVertexShaderUniformBufferId = createUniformBuffer<SceneVertexShaderUniformBlock>();
-	}
 }
 
 void SkyBoxMaterial::bind()
 {
 	gpuProgram.bind();
-	OPENGL_CALL(glBindBufferRange(GL_UNIFORM_BUFFER, 0, sceneVertexShaderUniformBufferId, 0, sizeof(SceneVertexShaderUniformBlock)));
+	sceneVertexShaderUniformRange.bind(0);
 
 #ifndef FORWARD_RENDER
 	bindTextureIfValid(depthBuffer, 1);
@@ -1970,21 +3474,21 @@ void SkyBoxMaterial::bindInstance()const
 
 	if (skyBox.textureId != INVALID_GRAPHICS_RESOURCE_ID)
 	{
-		OPENGL_CALL(glActiveTexture(GL_TEXTURE0));
-		OPENGL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, skyBox.textureId));
+		g_glState.activeTexture(0);
+		g_glState.bindTexture(GL_TEXTURE_CUBE_MAP, skyBox.textureId);
 	}
 }
 
 void SkyBoxMaterial::updateSceneData()
 {
-	sceneVertexShaderUniformBlock.u_invProjection = scene.camera.invProjectionTransform;
-	sceneVertexShaderUniformBlock.u_invView = scene.camera.invViewTransform;
+	sceneVertexShaderUniformBlock.u_invProjection = sceneRendering.camera.invProjectionTransform;
+	sceneVertexShaderUniformBlock.u_invView = sceneRendering.camera.invViewTransform;
 
 #ifndef FORWARD_RENDER
-	depthBuffer = scene.deferredRenderer->gbuffer.depthTexture;
+	depthBuffer = sceneRendering.deferredRenderer->gbuffer.depthTexture;
 #endif
 
-	updateUniformBlock(sceneVertexShaderUniformBlock, sceneVertexShaderUniformBufferId);
+	sceneVertexShaderUniformRange = g_uniformRing.push(sceneVertexShaderUniformBlock);
 }
 
 /*		SkyBoxRenderer		*/
@@ -2004,13 +3508,13 @@ void SkyBoxRenderer::render()const
 	skyBoxMaterial.bindInstance();
 
 #ifndef FORWARD_RENDER
-	glDisable(GL_DEPTH_TEST);
+	g_glState.disable(GL_DEPTH_TEST);
 #endif
 
 	fullScreenQuad.bind();
 	fullScreenQuad.render();
 
 #ifndef FORWARD_RENDER
-	glEnable(GL_DEPTH_TEST);
+	g_glState.enable(GL_DEPTH_TEST);
 #endif
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#ifndef _SCENE_RENDERING_H_
+#define _SCENE_RENDERING_H_
+
+/* scene_rendering.h:
+ *
+ * everything needed to draw the Scene (which, see custom_classes.h,
+ * only knows about the simulation):
+ *  - Camera,
+ *  - RenderObject (something to draw, and where),
+ *  - SceneRendering (camera, lights, renderers, and the looks of
+ *    the ships, of the bullets and of the floor)
+ *
+ * What is drawn comes from a SceneSnapshot, not from the Scene:
+ * the simulation runs on its own thread (see main.cpp).
+ *
+ */
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "transform.h"
+#include "mesh.h"
+#include "render_queue.h"
+#include "clustered_lighting.h"
+
+class PhysObject;
+
+struct Camera
+{
+	mat4 viewTransform;
+	mat4 projectionTransform;
+	mat4 projectionViewTransform;
+	mat4 prevProjectionViewTransform; // the one of the previous frame, to reproject what was drawn then
+	mat4 invViewTransform;
+	mat4 invProjectionTransform;
+	Transform transform;
+	float nearPlane;
+	float farPlane;
+	float fovY;
+	float aspectRatio;
+
+	void computeViewFromTransform();
+	void computeViewInside(const PhysObject& physObject);
+	void computeInvView();
+	void computeInvProj();
+	void computeProjectionView();
+	void setProjectionParams(float fovY, float aspectRatio, float near, float far);
+};
+
+/* what the renderers draw: a MeshComponent, placed in the world */
+struct RenderObject
+{
+	glm::mat4 world; // the transform of the object, accumulated with the local one of its MeshComponent
+	MeshComponent* meshComponent;
+};
+
+struct SceneSnapshot;
+struct SceneLighting;
+struct DeferredRenderer;
+struct ForwardRenderer;
+struct ShadowMapRenderer;
+struct SkyBoxRenderer;
+
+struct SceneRendering
+{
+	SceneRendering();
+	~SceneRendering();
+
+	void initAsNewGame();
+	// alpha: how far we are from the snapshot step to the next one, in [0,1]:
+	// what is drawn is interpolated between the last two steps
+	void render(const SceneSnapshot& snapshot, float alpha);
+
+	Camera camera;
+	float arenaRadius;
+
+	std::unique_ptr<SceneLighting> lighting;
+
+	std::unique_ptr<DeferredRenderer> deferredRenderer;
+	std::unique_ptr<ForwardRenderer> forwardRenderer;
+	std::unique_ptr<ShadowMapRenderer> shadowMapRenderer;
+	std::unique_ptr<SkyBoxRenderer> skyBoxRenderer;
+
+	// the looks
+	std::vector<MeshComponent> shipLooks; // one for each ship of the scene
+	std::unique_ptr<MeshComponent> bulletLook; // shared by all the bullets
+	std::unique_ptr<MeshComponent> floorLook;
+	Transform floorTransform;
+
+	// what every pass draws, sorted by state (see render_queue.h)
+	RenderQueue renderQueue;
+
+	// the point lights, binned into the clusters of the camera (see light_clusters.h)
+	ClusteredLighting clusteredLighting;
+
+private:
+	glm::mat4 cameraOnTwoObjects(const PhysObject& a, const PhysObject& b);
+	void findVisibleObjects(const SceneSnapshot& snapshot, float alpha);
+	std::vector<RenderObject> renderObjects;
+	std::vector<Transform> shipTransforms; // interpolated: where the ships are shown
+};
+
+extern SceneRendering sceneRendering; // like scene: there is one, and everyone can use it
+
+#endif
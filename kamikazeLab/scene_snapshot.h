@@ -0,0 +1,35 @@
+#ifndef SCENE_SNAPSHOT_H
+#define SCENE_SNAPSHOT_H
+
+/* SceneSnapshot:
+ *  a copy of what is needed to draw the Scene, as it was after a physics step.
+ *
+ *  The simulation thread makes one per step and hands it to the rendering
+ *  thread (see triple_buffer.h), which never looks at the Scene itself:
+ *  so neither has to wait for the other.
+ *  (the point lights of the ships follow the ship transforms: no need to copy them)
+ */
+
+#include <vector>
+#include <chrono>
+#include "transform.h"
+
+struct ShipSnapshot{
+	Transform prevT; // before the step
+	Transform t;     // after it
+	float rollAngle;
+	bool alive;
+};
+
+struct SceneSnapshot{
+	std::chrono::steady_clock::time_point stepTime; // when the step was made
+	float stepDuration; // secs
+
+	std::vector< ShipSnapshot > ships;
+
+	// the alive bullets, after the step
+	std::vector< vec3 > bulletPos;
+	std::vector< vec3 > bulletVel;
+};
+
+#endif // SCENE_SNAPSHOT_H
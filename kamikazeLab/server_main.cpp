@@ -0,0 +1,123 @@
+/* server_main.cpp
+ * the "core" of the headless game server.
+ *
+ * No window, no OpenGL, no SDL: only the simulation (physics, AI, game logic)
+ * is linked, and it is stepped as fast as the CPU allows, instead of
+ * waiting for a timer like the client does (see main.cpp).
+ *
+ * usage: kamikaze_server [number of physics steps] [number of ships]
+ *        kamikaze_server --bench-narrowphase
+ *        (times collidesBatch against the one-pair-at-a-time version, collidesSwept)
+ */
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "custom_classes.h"
+#include "aimind.h"
+
+using namespace std;
+
+static int benchNarrowphase()
+{
+	const int n = 1 << 16; // bullets
+	const int nShips = 64;
+	const int reps = 20;
+
+	std::vector<float> x( n ), y( n ), z( n ), mx( n ), my( n ), mz( n ), r( n );
+	for (int i = 0; i < n; i++) {
+		vec3 p = scene.randomPosInArena() * float(rand() % 1000) / 1000.0f;
+		vec3 m = scene.randomPosInArena() * (35.0f / 30 / scene.arenaRadius); // a bullet step
+		x[i] = p.x; y[i] = p.y; z[i] = p.z;
+		mx[i] = m.x; my[i] = m.y; mz[i] = m.z;
+		r[i] = 0.03f;
+	}
+	const SweptSpheres spheres{ &x[0], &y[0], &z[0], &mx[0], &my[0], &mz[0], &r[0] };
+
+	std::vector<vec3> shipPos( nShips );
+	for (vec3 &p : shipPos) p = scene.randomPosInArena() * float(rand() % 1000) / 1000.0f;
+	const vec3 shipMove( 1.0f, 0.0f, 0.0f );
+
+	auto run = [&]( decltype(&collidesBatch) kernel, long long &nHits ) {
+		nHits = 0;
+		auto start = chrono::steady_clock::now();
+		for (int k = 0; k < reps; k++)
+		for (const vec3 &p : shipPos)
+		for (int i = 0; i < n; i += COLLIDES_BATCH_MAX) {
+			uint64_t hits = kernel( p, shipMove, 4.0f, spheres.offset( i ), std::min( COLLIDES_BATCH_MAX, n - i ) );
+			for (; hits; hits &= hits - 1) nHits++;
+		}
+		return chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+	};
+
+	long long hitsScalar, hitsBatch;
+	double tScalar = run( collidesBatchScalar, hitsScalar );
+	double tBatch = run( collidesBatch, hitsBatch );
+	double nTests = double( n ) * nShips * reps;
+
+	cout << "scalar: " << tScalar * 1e9 / nTests << " ns per test\n";
+	cout << "batch:  " << tBatch * 1e9 / nTests << " ns per test ("
+		 << (tBatch > 0 ? tScalar / tBatch : 0.0) << "x)\n";
+	cout << hitsBatch << " hits\n";
+	if (hitsScalar != hitsBatch) {
+		cout << "MISMATCH: " << hitsScalar << " VS " << hitsBatch << " hits\n";
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	long long nSteps = 30 * 60 * 10; // ten minutes of game at 30 steps per second
+	if (argc > 1 && string( argv[1] ) == "--bench-narrowphase") {
+		scene.initAsNewGame();
+		return benchNarrowphase();
+	}
+
+	int nShips = 2;
+	if (argc > 1) nSteps = atoll(argv[1]);
+	if (argc > 2) nShips = atoi(argv[2]);
+	if (nShips < 2) nShips = 2;
+
+	scene.initAsNewGame( nShips );
+
+	// every ship is driven by an AI, which hunts the next ship
+	std::vector<AiMind> ais( scene.ships.size() );
+	for (size_t i = 0; i < ais.size(); i++) {
+		ais[i].me = &(scene.ships[i]);
+		ais[i].target = &(scene.ships[(i + 1) % scene.ships.size()]);
+		ais[i].setHumanLike();
+	}
+
+	std::vector<int> deaths( scene.ships.size(), 0 );
+	std::vector<bool> wasAlive( scene.ships.size() );
+
+	auto start = chrono::steady_clock::now();
+
+	for (long long step = 0; step < nSteps; step++) {
+		for (size_t i = 0; i < ais.size(); i++) {
+			ais[i].rethink( scene.ships[i].controller );
+		}
+
+		for (size_t i = 0; i < scene.ships.size(); i++) wasAlive[i] = scene.ships[i].alive;
+
+		scene.doPhysStep();
+
+		for (size_t i = 0; i < scene.ships.size(); i++) {
+			if (wasAlive[i] && !scene.ships[i].alive) deaths[i]++;
+		}
+	}
+
+	double secs = chrono::duration<double>( chrono::steady_clock::now() - start ).count();
+
+	cout << nSteps << " steps in " << secs << " s ("
+		 << (secs > 0 ? nSteps / secs : 0.0) << " steps per second)\n";
+	for (size_t i = 0; i < deaths.size(); i++) {
+		cout << "ship " << i << ": died " << deaths[i] << " times\n";
+	}
+
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include "shader.h"
 #include "texture.h"
 #include "graphics_resource.h"
+#include "uniform_ring.h"
 
 struct ShadowMap
 {
@@ -34,17 +35,10 @@ struct ShadowMapMaterial
 		glm::mat4 u_projView;
 	};
 
-	struct ObjectVertexShaderUniformBlock
-	{
-		glm::mat4 u_world;
-	};
-
 	ShadowMapMaterial();
 
-	void setWorldTransform(const glm::mat4& world);
-	void bindInstance()const;
+	void bind()const;
 
-	void updateObjectUniforms();
 	void updateLightUniforms();
 	void setLightProjectionView(const glm::mat4& lightProjectionView);
 	const glm::mat4& getLightProjectionView()const;
@@ -52,10 +46,8 @@ struct ShadowMapMaterial
 	static GpuProgram gpuProgram;
 
 	LightVertexShaderUniformBlock lightVertexShaderUniformBlock;
-	ObjectVertexShaderUniformBlock objectVertexShaderUniformBlock;
 
-	unsigned int lightVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
-	unsigned int objectVertexShaderUniformBufferId = INVALID_GRAPHICS_RESOURCE_ID;
+	UniformRange lightVertexShaderUniformRange;
 };
 
 #endif
\ No newline at end of file
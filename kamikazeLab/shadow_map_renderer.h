@@ -3,20 +3,30 @@
 
 #include "shadow_map.h"
 #include "lights.h"
-#include "phys_object.h"
 
+struct RenderQueue;
+
+/* ShadowMapRenderer:
+ * cascaded shadow maps. The depths of the camera where the arena is are split in SHADOW_CASCADE_COUNT
+ * slices (see SHADOW_CASCADE_SPLIT_LAMBDA); each cascade is an orthographic projection around the bounding
+ * sphere of its slice, moved by whole texels only (so that the shadows do not crawl when the camera moves),
+ * and draws only the casters in its own volume.
+ * The cascades of a light share its shadow map, side by side: cascade c is the c-th SHADOW_CASCADE_RESOLUTION
+ * wide column of it.
+ */
 struct ShadowMapRenderer
 {
 	ShadowMapRenderer();
 
-	void render(PhysObject** physObjects, unsigned int count);
+	// fits the cascades to the camera: before the render queue is built (it culls against them)
+	void updateLightProjectionViews();
+	void render(RenderQueue& renderQueue);
 
 	ShadowMap dirLightShadowMaps[DIR_LIGHT_COUNT];
-	glm::mat4 dirLightProjectionViews[DIR_LIGHT_COUNT];
+	glm::mat4 dirLightProjectionViews[DIR_LIGHT_COUNT][SHADOW_CASCADE_COUNT]; // world -> ndc of the cascade
+	glm::vec4 cascadeFarDepths; // the view depth (along -z) where each cascade ends; the unused ones are 0
 
 private:
-	void renderPhysObject(PhysObject& physObject);
-
 	ShadowMapMaterial shadowMapMaterial;
 };
 
@@ -5,6 +5,7 @@
 #include "shader.h"
 #include "texture_cube.h"
 #include "render_path.h"
+#include "uniform_ring.h"
 
 //#define SKYBOX_SWAP_SKYBOX_YZ
 
@@ -27,7 +28,7 @@ struct SkyBoxMaterial
 
 	static SceneVertexShaderUniformBlock sceneVertexShaderUniformBlock;
 
-	static unsigned int sceneVertexShaderUniformBufferId;
+	static UniformRange sceneVertexShaderUniformRange;
 
 	GpuTextureCube skyBox;
 
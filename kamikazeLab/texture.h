@@ -22,9 +22,11 @@ typedef unsigned char byte;
 struct Texel{
 	byte r,g,b,a;
 };
+static_assert(sizeof(Texel) == 4, "Texel: uploaded as GL_RGBA, GL_UNSIGNED_BYTE");
 
 struct CpuTexture{
-	bool import(std::string filename);
+	bool import(std::string filename); // binary PPM (P6): mapped, expanded to RGBA (see ppm_image.h)
+	bool importWithStreams(std::string filename); // the former PPM importer: only the baseline of --bench-import
 
 	int sizeX, sizeY;
 	std::vector<Texel> data;
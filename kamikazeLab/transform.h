@@ -41,7 +41,7 @@ struct Transform{
 
 	/*TODO: very good exercises:
 	 * methods for:
-	 * cumulate, invert, transform points/vectors, interpolate (mix) */
+	 * cumulate, invert, transform points/vectors */
 
 	Transform inverse() const {
 		Transform res;
@@ -53,4 +53,13 @@ struct Transform{
 
 };
 
+// interpolate: k=0 gives a, k=1 gives b
+inline Transform mix( const Transform& a, const Transform& b, float k ){
+	Transform res;
+	res.pos = glm::mix( a.pos, b.pos, k );
+	res.ori = glm::slerp( a.ori, b.ori, k );
+	res.scale = glm::mix( a.scale, b.scale, k );
+	return res;
+}
+
 #endif // TRANSFORM_H
@@ -0,0 +1,44 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+/* TripleBuffer<T>:
+ *  hands over the latest T from one writer thread to one reader thread,
+ *  without locks and without ever waiting (wait-free, on both sides).
+ *
+ *  Three slots: the writer fills its "back" one and publishes it, the reader
+ *  reads its "front" one; the third one, in the middle, is what they swap with.
+ *  If the writer is faster, the reader just skips the stale ones;
+ *  if the reader is faster, it keeps reading the same one.
+ *
+ *  The slots are reused: a T holding vectors stops allocating once warmed up.
+ */
+
+#include <atomic>
+
+template <typename T>
+struct TripleBuffer{
+
+	/* writer side */
+	T& writeBuffer(){ return slots[back]; }
+	void publish(){
+		back = middle.exchange( back | FRESH, std::memory_order_acq_rel ) & INDEX;
+	}
+
+	/* reader side */
+	bool update(){ // true if a fresher one came since the last update
+		if (!(middle.load( std::memory_order_relaxed ) & FRESH)) return false;
+		front = middle.exchange( front, std::memory_order_acq_rel ) & INDEX;
+		return true;
+	}
+	const T& readBuffer() const { return slots[front]; }
+
+private:
+	enum { INDEX = 3, FRESH = 4 }; // middle: index of the slot, plus a bit if not read yet
+
+	T slots[3];
+	int back = 0;  // only touched by the writer
+	int front = 1; // only touched by the reader
+	std::atomic<int> middle{ 2 };
+};
+
+#endif // TRIPLE_BUFFER_H
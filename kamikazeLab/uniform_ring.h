@@ -0,0 +1,83 @@
+#ifndef _UNIFORM_RING_H_
+#define _UNIFORM_RING_H_
+
+#include <vector>
+#include "graphics_resource.h"
+
+/* where a uniform block has been written for this frame */
+struct UniformRange
+{
+	unsigned int bufferId = INVALID_GRAPHICS_RESOURCE_ID;
+	unsigned int offset = 0;
+	unsigned int size = 0;
+
+	//binds the range to the given uniform block binding index
+	void bind(unsigned int bindingIndex)const;
+	//or to the given shader storage block binding index (for arrays of unknown size: see ClusteredLighting)
+	void bindAsStorage(unsigned int bindingIndex)const;
+};
+
+/* UniformRing:
+ * a single buffer, persistently mapped and coherent, which all the uniform blocks
+ * changing every frame are written into (instead of one buffer each, mapped and
+ * unmapped at every update). The storage blocks read by the shaders go there too.
+ * The buffer is split in FRAMES_IN_FLIGHT regions: a frame writes its blocks one
+ * after the other in its own region, while the GPU may still be reading the regions
+ * of the previous frames. A fence per region tells when it can be written again.
+ *
+ * A block which does not fit in what is left of the region enlarges the ring there and then:
+ * a new buffer, big enough, takes over, while the old one is only retired (still mapped, its ranges
+ * still valid for the draws of this frame) until the GPU is done with it. If no bigger buffer
+ * can be had, the block gets a buffer of its own, retired the same way.
+ */
+struct UniformRing
+{
+	static constexpr unsigned int FRAMES_IN_FLIGHT = 3;
+	//the ring grows up to this, per frame (the offsets of all the regions stay in 32 bits)
+	static constexpr unsigned int MAX_FRAME_SIZE = 256 * 1024 * 1024;
+
+	void init(unsigned int bytesPerFrame);
+	void release();
+
+	//waits for the GPU to be done with the region of this frame
+	void beginFrame();
+	//fences the region of this frame
+	void endFrame();
+
+	template<typename UniformBlockType>
+	UniformRange push(const UniformBlockType& uniformBlock)
+	{
+		return push(&uniformBlock, sizeof(UniformBlockType));
+	}
+
+	UniformRange push(const void* data, unsigned int size);
+
+	unsigned int bufferId = INVALID_GRAPHICS_RESOURCE_ID;
+
+private:
+	//false (and the ring untouched) if the buffer could not be had
+	bool create(unsigned int bytesPerFrame);
+	//a block which does not fit in the region: a bigger ring, or a buffer of its own
+	UniformRange pushOverflowing(const void* data, unsigned int size);
+	//deletes the retired buffers the GPU is done with (wait: all of them, waiting if needed)
+	void deleteRetiredBuffers(bool wait);
+
+	struct RetiredBuffer
+	{
+		unsigned int bufferId;
+		bool isMapped;
+		struct __GLsync* fence; //of the frame which last used it: null until that frame ends
+	};
+
+	unsigned char* mappedData = nullptr;
+	unsigned int frameSize = 0;
+	unsigned int alignment = 256;
+	unsigned int frameIndex = 0;
+	unsigned int frameOffset = 0; //where the next block goes, in the region of this frame
+	struct __GLsync* fences[FRAMES_IN_FLIGHT] = {};
+	std::vector<RetiredBuffer> retiredBuffers;
+};
+
+extern UniformRing g_uniformRing;
+
+#endif